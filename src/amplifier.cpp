@@ -20,40 +20,85 @@
 #include "amplifier.h"
 #include <assert.h>
 
-CAmplifier::CAmplifier (CSynthModule *pInput, CSynthModule *pModulator, CSynthModule *pEnvelope)
+template <typename TSample>
+const TAmplifierParameters CAmplifierT<TSample>::s_DefaultParameters =
+{
+	0.0f
+#ifdef FIXED_POINT_DSP
+	, 0
+#endif
+};
+
+template <typename TSample>
+CAmplifierT<TSample>::CAmplifierT (CSynthModuleT<TSample> *pInput,
+				   CSynthModuleT<TSample> *pModulator,
+				   CSynthModuleT<TSample> *pEnvelope)
 :	m_pInput (pInput),
 	m_pModulator (pModulator),
 	m_pEnvelope (pEnvelope),
-	m_fModulationVolume (0.0),
-	m_fOutputLevel (0.0)
+	m_pParameters (&s_DefaultParameters),
+	m_OutputLevel (0)
 {
 }
 
-CAmplifier::~CAmplifier (void)
+template <typename TSample>
+CAmplifierT<TSample>::~CAmplifierT (void)
 {
 	m_pInput = 0;
 	m_pModulator = 0;
 	m_pEnvelope = 0;
+	m_pParameters = 0;
 }
 
-void CAmplifier::SetModulationVolume (float fVolume)
+template <typename TSample>
+void CAmplifierT<TSample>::SetParameters (const TAmplifierParameters *pParameters)
 {
-	assert (0.0 <= fVolume && fVolume <= 1.0);
-	m_fModulationVolume = fVolume;
+	assert (pParameters != 0);
+	assert (0.0f <= pParameters->fModulationVolume && pParameters->fModulationVolume <= 1.0f);
+	m_pParameters = pParameters;
 }
 
-void CAmplifier::NextSample (void)
+template <>
+void CAmplifierT<float>::NextSample (void)
 {
 	assert (m_pInput != 0);
 	assert (m_pModulator != 0);
 	assert (m_pEnvelope != 0);
+	assert (m_pParameters != 0);
 
-	m_fOutputLevel  = m_pInput->GetOutputLevel ();
-	m_fOutputLevel *= 1.0 + m_pModulator->GetOutputLevel ()*m_fModulationVolume;
-	m_fOutputLevel *= m_pEnvelope->GetOutputLevel ();
+	m_OutputLevel  = m_pInput->GetOutputLevel ();
+	m_OutputLevel *= 1.0f + m_pModulator->GetOutputLevel ()*m_pParameters->fModulationVolume;
+	m_OutputLevel *= m_pEnvelope->GetOutputLevel ();
 }
 
-float CAmplifier::GetOutputLevel (void) const
+#ifdef FIXED_POINT_DSP
+
+template <>
+void CAmplifierT<TQ15>::NextSample (void)
 {
-	return m_fOutputLevel;
+	assert (m_pInput != 0);
+	assert (m_pModulator != 0);
+	assert (m_pEnvelope != 0);
+	assert (m_pParameters != 0);
+
+	// [0.0, 2.0]
+	TQ15 nGain = Q15_ONE + Q15Multiply (m_pModulator->GetOutputLevel (),
+					    m_pParameters->nModulationVolume);
+	nGain = Q15Multiply (nGain, m_pEnvelope->GetOutputLevel ());
+
+	// the input can be up to 4.0, so that the product needs 64 bits
+	m_OutputLevel = Q15SaturateWide ((s32) (((s64) m_pInput->GetOutputLevel () * nGain) >> 15));
+}
+
+#endif
+
+template <typename TSample>
+TSample CAmplifierT<TSample>::GetOutputLevel (void) const
+{
+	return m_OutputLevel;
 }
+
+template class CAmplifierT<float>;
+#ifdef FIXED_POINT_DSP
+template class CAmplifierT<TQ15>;
+#endif
@@ -22,25 +22,45 @@
 
 #include "synthmodule.h"
 
-class CAmplifier : public CSynthModule
+struct TAmplifierParameters
+{
+	float	fModulationVolume;		// [0.0, 1.0]
+#ifdef FIXED_POINT_DSP
+	TQ15	nModulationVolume;		// derived from fModulationVolume
+#endif
+};
+
+template <typename TSample>
+class CAmplifierT : public CSynthModuleT<TSample>
 {
 public:
-	CAmplifier (CSynthModule *pInput, CSynthModule *pModulator, CSynthModule *pEnvelope);
-	~CAmplifier (void);
+	CAmplifierT (CSynthModuleT<TSample> *pInput, CSynthModuleT<TSample> *pModulator,
+		     CSynthModuleT<TSample> *pEnvelope);
+	~CAmplifierT (void);
 
-	void SetModulationVolume (float fVolume);	// [0.0, 1.0]
+	// the parameters are referenced, not copied
+	void SetParameters (const TAmplifierParameters *pParameters);
 
 	void NextSample (void);
-	float GetOutputLevel (void) const;		// returns [-1.0, 1.0]
+	TSample GetOutputLevel (void) const;		// returns [-1.0, 1.0]
 
 private:
-	CSynthModule *m_pInput;
-	CSynthModule *m_pModulator;
-	CSynthModule *m_pEnvelope;
+	CSynthModuleT<TSample> *m_pInput;
+	CSynthModuleT<TSample> *m_pModulator;
+	CSynthModuleT<TSample> *m_pEnvelope;
 
-	float m_fModulationVolume;
+	const TAmplifierParameters *m_pParameters;
 
-	float m_fOutputLevel;
+	TSample m_OutputLevel;
+
+	static const TAmplifierParameters s_DefaultParameters;
 };
 
+template <> void CAmplifierT<float>::NextSample (void);
+#ifdef FIXED_POINT_DSP
+template <> void CAmplifierT<TQ15>::NextSample (void);
+#endif
+
+typedef CAmplifierT<float> CAmplifier;
+
 #endif
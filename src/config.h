@@ -20,18 +20,23 @@
 #ifndef _config_h
 #define _config_h
 
-#define SAMPLE_RATE		48000		// overall system clock
+#define SAMPLE_RATE_DEFAULT	48000		// overall system clock (see samplerate.h)
 
 #if RASPPI >= 2
 	#define VOICES_PER_CORE	3		// polyphonic voices per CPU core
 #else
-	#define VOICES_PER_CORE	4		// polyphonic voices (1 core only)
+	#define VOICES_PER_CORE	8		// max. polyphonic voices (1 core only),
+	#define VOICES_CALIBRATED		// limited to the render time measured on start
 #endif
 
 #define VELOCITY_DEFAULT	80		// for PC keyboard (max. 127)
 
 #define PATCHES			48		// number of configurable patches, don't change
 
+#define PARTS			16		// multi-timbral parts (share the voices)
+
+#define ZONES			8		// keyboard split/layer zones of part 0
+
 #define DRIVE			"SD:"		// drive to use
 
 // configurable options
@@ -39,4 +44,26 @@
 
 #define DAC_I2C_ADDRESS		0		// I2C slave address of the DAC (0 for auto probing)
 
+#if RASPPI == 1
+	#define FIXED_POINT_DSP			// voices use Q15 samples (see sample.h)
+#endif
+
+//#define SHOW_STATUS				// log the render statistics every STATUS_INTERVAL_SECS
+#define STATUS_INTERVAL_SECS	10
+
+//#define CC_STORM_BENCHMARK			// log the time for 1000 MIDI CCs after start
+//#define NOTE_TIMING_TEST			// log the note onset jitter, rendered before start
+//#define MIDI_PARSER_BENCHMARK		// log the serial MIDI parser throughput
+//#define PROFILE_STAGES			// log the cycles per sample of the voice and reverb stages
+//#define TRACE_EVENTS				// write a trace of the real-time path to trace.bin
+//#define SAMPLE_RATE_BENCHMARK		// log the max. voices per core at each sample rate, before start
+//#define FIXED_POINT_TEST			// compare the fixed-point with the float voice, before start
+//#define FAST_MATH_BENCHMARK		// log the error and speed of the fast-math functions, before start
+//#define PATCH_LOAD_BENCHMARK		// log the time to load all patches from the bank and the text files
+//#define STRESS_TEST				// play test patterns, if "stresstest=secs" is in cmdline.txt
+
+#ifdef STRESS_TEST
+	#define SHOW_STATUS				// the stress test reports the render statistics
+#endif
+
 #endif
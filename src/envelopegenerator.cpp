@@ -18,76 +18,96 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include "envelopegenerator.h"
+#include "samplerate.h"
 #include "config.h"
 #include <assert.h>
 
-CEnvelopeGenerator::CEnvelopeGenerator (void)
-:	m_nAttackMsec (200),
-	m_nDecayMsec (5000),
-	m_fSustainLevel (0.5),
-	m_nReleaseMsec (500),
-	m_State (EnvelopeStateIdle),
-	m_nSampleCount (0),
-	m_fOutputLevel (0.0)
+// used until SetParameters() is called, so that the default sample rate is sufficient
+template <typename TSample>
+const TEnvelopeParameters CEnvelopeGeneratorT<TSample>::s_DefaultParameters =
 {
-}
+	1000.0f / (200 * SAMPLE_RATE_DEFAULT),
+	1000.0f / (5000 * SAMPLE_RATE_DEFAULT),
+	0.5f,
+	1000.0f / (500 * SAMPLE_RATE_DEFAULT)
+#ifdef FIXED_POINT_DSP
+	, (TQ30) (Q30_ONE * (1000.0 / (200 * SAMPLE_RATE_DEFAULT))),
+	(TQ30) (Q30_ONE * (1000.0 / (5000 * SAMPLE_RATE_DEFAULT))),
+	Q15_ONE / 2,
+	(TQ30) (Q30_ONE * (1000.0 / (500 * SAMPLE_RATE_DEFAULT)))
+#endif
+};
 
-CEnvelopeGenerator::~CEnvelopeGenerator (void)
+template <typename TSample>
+CEnvelopeGeneratorT<TSample>::CEnvelopeGeneratorT (void)
+:	m_pParameters (&s_DefaultParameters),
+	m_State (EnvelopeStateIdle),
+	m_nSampleCount (0),
+	m_OutputLevel (0)
 {
 }
 
-void CEnvelopeGenerator::SetAttack (unsigned nMilliSeconds)
+template <typename TSample>
+CEnvelopeGeneratorT<TSample>::~CEnvelopeGeneratorT (void)
 {
-	m_nAttackMsec = nMilliSeconds;
+	m_pParameters = 0;
 }
 
-void CEnvelopeGenerator::SetDecay (unsigned nMilliSeconds)
+template <typename TSample>
+void CEnvelopeGeneratorT<TSample>::SetParameters (const TEnvelopeParameters *pParameters)
 {
-	assert (nMilliSeconds > 0);
-	m_nDecayMsec = nMilliSeconds;
+	assert (pParameters != 0);
+	assert (0.0f <= pParameters->fSustainLevel && pParameters->fSustainLevel <= 1.0f);
+	assert (pParameters->fDecayIncrement < 1.0f);
+	m_pParameters = pParameters;
 }
 
-void CEnvelopeGenerator::SetSustain (float fLevel)
+template <typename TSample>
+float CEnvelopeGeneratorT<TSample>::GetIncrement (unsigned nMilliSeconds)
 {
-	assert (0.0 <= fLevel && fLevel <= 1.0);
-	m_fSustainLevel = fLevel;
-
-}
+	if (nMilliSeconds == 0)
+	{
+		return 1.0f;			// next phase starts with the first sample
+	}
 
-void CEnvelopeGenerator::SetRelease (unsigned nMilliSeconds)
-{
-	m_nReleaseMsec = nMilliSeconds;
+	return 1000.0f / ((float) nMilliSeconds * CSampleRate::Get ());
 }
 
-void CEnvelopeGenerator::NoteOn (float fVelocityLevel)
+template <typename TSample>
+void CEnvelopeGeneratorT<TSample>::NoteOn (float fVelocityLevel)
 {
 	m_State = EnvelopeStateAttack;
 
-	assert (0.0 < fVelocityLevel && fVelocityLevel <= 1.0);
-	m_fVelocityLevel = fVelocityLevel;
+	assert (0.0f < fVelocityLevel && fVelocityLevel <= 1.0f);
+	m_VelocityLevel = SampleFromFloat<TSample> (fVelocityLevel);
 
 	m_nSampleCount = 0;
-	m_fOutputLevel = 0.0;
+	m_OutputLevel = 0;
 }
 
-void CEnvelopeGenerator::NoteOff (void)
+template <typename TSample>
+void CEnvelopeGeneratorT<TSample>::NoteOff (void)
 {
 	if (m_State != EnvelopeStateIdle)
 	{
 		m_State = EnvelopeStateRelease;
 
 		m_nSampleCount = 0;
-		m_fReleaseLevel = m_fOutputLevel;
+		m_ReleaseLevel = m_OutputLevel;
 	}
 }
 
-TEnvelopeState CEnvelopeGenerator::GetState (void) const
+template <typename TSample>
+TEnvelopeState CEnvelopeGeneratorT<TSample>::GetState (void) const
 {
 	return m_State;
 }
 
-void CEnvelopeGenerator::NextSample (void)
+template <>
+void CEnvelopeGeneratorT<float>::NextSample (void)
 {
+	assert (m_pParameters != 0);
+
 	if (++m_nSampleCount == 0)	// may wrap
 	{
 		m_nSampleCount = (unsigned) -1;
@@ -99,7 +119,7 @@ void CEnvelopeGenerator::NextSample (void)
 		break;
 
 	case EnvelopeStateAttack:
-		if (CalculateLevel (0.0, m_fVelocityLevel, m_nAttackMsec))
+		if (CalculateLevel (0.0, m_VelocityLevel, m_pParameters->fAttackIncrement))
 		{
 			m_nSampleCount = 0;
 			m_State = EnvelopeStateDecay;
@@ -107,13 +127,14 @@ void CEnvelopeGenerator::NextSample (void)
 		break;
 
 	case EnvelopeStateDecay:
-		if (CalculateLevel (m_fVelocityLevel, m_fSustainLevel*m_fVelocityLevel, m_nDecayMsec))
+		if (CalculateLevel (m_VelocityLevel, m_pParameters->fSustainLevel*m_VelocityLevel,
+				    m_pParameters->fDecayIncrement))
 		{
 			m_nSampleCount = 0;
 			m_State = EnvelopeStateSustain;
 		}
 
-		if (m_fOutputLevel == 0.0) // Forse è troppo stringente, metterei: < (piccola frazione)
+		if (m_OutputLevel == 0.0f) // Forse è troppo stringente, metterei: < (piccola frazione)
 		{
 			m_State = EnvelopeStateIdle;
 		}
@@ -123,7 +144,7 @@ void CEnvelopeGenerator::NextSample (void)
 		break;
 
 	case EnvelopeStateRelease:
-		if (CalculateLevel (m_fReleaseLevel, 0.0, m_nReleaseMsec))
+		if (CalculateLevel (m_ReleaseLevel, 0.0, m_pParameters->fReleaseIncrement))
 		{
 			m_State = EnvelopeStateIdle;
 		}
@@ -135,35 +156,134 @@ void CEnvelopeGenerator::NextSample (void)
 	}
 }
 
-float CEnvelopeGenerator::GetOutputLevel (void) const
+#ifdef FIXED_POINT_DSP
+
+template <>
+void CEnvelopeGeneratorT<TQ15>::NextSample (void)
 {
-	return m_fOutputLevel;
+	assert (m_pParameters != 0);
+
+	if (++m_nSampleCount == 0)	// may wrap
+	{
+		m_nSampleCount = (unsigned) -1;
+	}
+
+	switch (m_State)
+	{
+	case EnvelopeStateIdle:
+		break;
+
+	case EnvelopeStateAttack:
+		if (CalculateLevel (0, m_VelocityLevel, m_pParameters->nAttackIncrement))
+		{
+			m_nSampleCount = 0;
+			m_State = EnvelopeStateDecay;
+		}
+		break;
+
+	case EnvelopeStateDecay:
+		if (CalculateLevel (m_VelocityLevel,
+				    Q15Multiply (m_pParameters->nSustainLevel, m_VelocityLevel),
+				    m_pParameters->nDecayIncrement))
+		{
+			m_nSampleCount = 0;
+			m_State = EnvelopeStateSustain;
+		}
+
+		if (m_OutputLevel == 0)
+		{
+			m_State = EnvelopeStateIdle;
+		}
+		break;
+
+	case EnvelopeStateSustain:
+		break;
+
+	case EnvelopeStateRelease:
+		if (CalculateLevel (m_ReleaseLevel, 0, m_pParameters->nReleaseIncrement))
+		{
+			m_State = EnvelopeStateIdle;
+		}
+		break;
+
+	default:
+		assert (0);
+		break;
+	}
+}
+
+#endif
+
+template <typename TSample>
+TSample CEnvelopeGeneratorT<TSample>::GetOutputLevel (void) const
+{
+	return m_OutputLevel;
 }
 
-boolean CEnvelopeGenerator::CalculateLevel (float fPrevLevel, float fNextLevel, unsigned nMsDelay)
+template <>
+boolean CEnvelopeGeneratorT<float>::CalculateLevel (float fPrevLevel, float fNextLevel,
+						    float fIncrement)
 {
-	if (nMsDelay == 0)
+	float fProgress = m_nSampleCount * fIncrement;
+	if (fProgress >= 1.0f)
 	{
-		m_fOutputLevel = fNextLevel;
+		m_OutputLevel = fNextLevel;
 
 		return TRUE;
 	}
 
-	float fMsElapsed = m_nSampleCount * 1000.0 / SAMPLE_RATE;
+	m_OutputLevel = fPrevLevel + (fNextLevel-fPrevLevel) * fProgress;
+	if (m_OutputLevel < 0.0f)
+	{
+		m_OutputLevel = 0.0f;
 
-	m_fOutputLevel = fPrevLevel + (fNextLevel-fPrevLevel) * (fMsElapsed / nMsDelay);
-	if (m_fOutputLevel < 0.0)
+		return TRUE;
+	}
+	if (m_OutputLevel > 1.0f)
 	{
-		m_fOutputLevel = 0.0;
+		m_OutputLevel = 1.0f;
 
 		return TRUE;
 	}
-	if (m_fOutputLevel > 1.0)
+
+	return FALSE;
+}
+
+#ifdef FIXED_POINT_DSP
+
+template <>
+boolean CEnvelopeGeneratorT<TQ15>::CalculateLevel (TQ15 nPrevLevel, TQ15 nNextLevel,
+						   TQ30 nIncrement)
+{
+	u64 nProgress = (u64) m_nSampleCount * nIncrement;
+	if (nProgress >= Q30_ONE)
 	{
-		m_fOutputLevel = 1.0;
+		m_OutputLevel = nNextLevel;
 
 		return TRUE;
 	}
 
-	return fMsElapsed >= nMsDelay;
+	// both factors fit into 16 bits
+	m_OutputLevel = nPrevLevel + (((nNextLevel-nPrevLevel) * (TQ15) (nProgress >> 15)) >> 15);
+	if (m_OutputLevel < 0)
+	{
+		m_OutputLevel = 0;
+
+		return TRUE;
+	}
+	if (m_OutputLevel > Q15_MAX)
+	{
+		m_OutputLevel = Q15_MAX;
+
+		return TRUE;
+	}
+
+	return FALSE;
 }
+
+#endif
+
+template class CEnvelopeGeneratorT<float>;
+#ifdef FIXED_POINT_DSP
+template class CEnvelopeGeneratorT<TQ15>;
+#endif
@@ -35,16 +35,29 @@ enum TEnvelopeState
 	EnvelopeStateUnknown
 };
 
-class CEnvelopeGenerator : public CSynthModule
+struct TEnvelopeParameters
+{
+	float	fAttackIncrement;		// progress per sample, derived from delay
+	float	fDecayIncrement;
+	float	fSustainLevel;			// [0.0, 1.0]
+	float	fReleaseIncrement;
+#ifdef FIXED_POINT_DSP
+	TQ30	nAttackIncrement;		// derived from the float values
+	TQ30	nDecayIncrement;
+	TQ15	nSustainLevel;
+	TQ30	nReleaseIncrement;
+#endif
+};
+
+template <typename TSample>
+class CEnvelopeGeneratorT : public CSynthModuleT<TSample>
 {
 public:
-	CEnvelopeGenerator (void);
-	~CEnvelopeGenerator (void);
+	CEnvelopeGeneratorT (void);
+	~CEnvelopeGeneratorT (void);
 
-	void SetAttack (unsigned nMilliSeconds);
-	void SetDecay (unsigned nMilliSeconds);
-	void SetSustain (float fLevel);			// [0.0, 1.0]
-	void SetRelease (unsigned nMilliSeconds);
+	// the parameters are referenced, not copied
+	void SetParameters (const TEnvelopeParameters *pParameters);
 
 	void NoteOn (float fVelocityLevel = 1.0);	// (0.0, 1.0]
 	void NoteOff (void);
@@ -52,25 +65,41 @@ public:
 	TEnvelopeState GetState (void) const;
 
 	void NextSample (void);
-	float GetOutputLevel (void) const;		// returns [0.0, 1.0]
+	TSample GetOutputLevel (void) const;		// returns [0.0, 1.0]
+
+	// helper to derive the parameters
+	static float GetIncrement (unsigned nMilliSeconds);
 
 private:
 	// returns TRUE if next phase starts
-	boolean CalculateLevel (float fPrevLevel, float fNextLevel, unsigned nMsDelay);
+	boolean CalculateLevel (TSample PrevLevel, TSample NextLevel, float fIncrement);
+#ifdef FIXED_POINT_DSP
+	boolean CalculateLevel (TSample PrevLevel, TSample NextLevel, TQ30 nIncrement);
+#endif
 
 private:
-	unsigned m_nAttackMsec;
-	unsigned m_nDecayMsec;
-	float    m_fSustainLevel;
-	unsigned m_nReleaseMsec;
+	const TEnvelopeParameters *m_pParameters;
 
 	TEnvelopeState m_State;
 
-	float m_fVelocityLevel;				// [0.0, 1.0]
+	TSample m_VelocityLevel;			// [0.0, 1.0]
 	unsigned m_nSampleCount;
-	float m_fReleaseLevel;
+	TSample m_ReleaseLevel;
+
+	TSample m_OutputLevel;
 
-	float m_fOutputLevel;
+	static const TEnvelopeParameters s_DefaultParameters;
 };
 
+template <> void CEnvelopeGeneratorT<float>::NextSample (void);
+template <> boolean CEnvelopeGeneratorT<float>::CalculateLevel (float fPrevLevel, float fNextLevel,
+								 float fIncrement);
+#ifdef FIXED_POINT_DSP
+template <> void CEnvelopeGeneratorT<TQ15>::NextSample (void);
+template <> boolean CEnvelopeGeneratorT<TQ15>::CalculateLevel (TQ15 nPrevLevel, TQ15 nNextLevel,
+								TQ30 nIncrement);
+#endif
+
+typedef CEnvelopeGeneratorT<float> CEnvelopeGenerator;
+
 #endif
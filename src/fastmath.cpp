@@ -0,0 +1,248 @@
+//
+// fastmath.cpp
+//
+// MiniSynth Pi - A virtual analogue synthesizer for Raspberry Pi
+// Copyright (C) 2017-2023  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "fastmath.h"
+
+#ifdef FAST_MATH_BENCHMARK
+
+#include <circle/timer.h>
+#include <circle/logger.h>
+#include "math.h"
+#include <assert.h>
+
+#define ERROR_POINTS		100000		// per function
+#define TIMING_VALUES		1024
+#define TIMING_REPEAT		100
+
+enum TErrorType
+{
+	ErrorAbsolute,
+	ErrorRelative,
+	ErrorRelativeAboveOne,			// absolute for |result| <= 1
+	ErrorTangent				// abs./rel., where |cos (x)| > 0.1
+};
+
+struct TFastMathFunction
+{
+	const char *pName;
+	float fMin;
+	float fMax;
+	boolean bGeometric;			// distribute the test points logarithmically
+	TErrorType ErrorType;
+	double (*pReference) (double);
+	float (*pFast) (float);
+	void (*pBlock) (float *pOut, const float *pIn, unsigned nCount);
+	unsigned (*pTimeLibrary) (void);	// return clock ticks
+	unsigned (*pTimeFast) (void);
+	unsigned (*pTimeBlock) (void);
+};
+
+static const char FromFastMath[] = "fastmath";
+
+static const char *s_pErrorName[] = {"absolute", "relative", "abs./rel.", "abs./rel."};
+
+static float s_fInput[TIMING_VALUES];
+static float s_fOutput[TIMING_VALUES];
+
+template <float (*Function) (float)>
+static unsigned TimeScalar (void)
+{
+	unsigned nTicks = CTimer::GetClockTicks ();
+
+	for (unsigned nRepeat = 0; nRepeat < TIMING_REPEAT; nRepeat++)
+	{
+		for (unsigned i = 0; i < TIMING_VALUES; i++)
+		{
+			s_fOutput[i] = (*Function) (s_fInput[i]);
+		}
+	}
+
+	return CTimer::GetClockTicks () - nTicks;
+}
+
+template <void (*Block) (float *pOut, const float *pIn, unsigned nCount)>
+static unsigned TimeBlock (void)
+{
+	unsigned nTicks = CTimer::GetClockTicks ();
+
+	for (unsigned nRepeat = 0; nRepeat < TIMING_REPEAT; nRepeat++)
+	{
+		(*Block) (s_fOutput, s_fInput, TIMING_VALUES);
+	}
+
+	return CTimer::GetClockTicks () - nTicks;
+}
+
+static double ReferenceExp2 (double x)
+{
+	return pow (2.0, x);
+}
+
+static double ReferenceLog2 (double x)
+{
+	return log (x) / log (2.0);
+}
+
+static const TFastMathFunction s_Functions[] =
+{
+	{"exp2", -126.0f, 127.4f, FALSE, ErrorRelative, ReferenceExp2, FastExp2, FastExp2Block,
+	 TimeScalar<exp2f>, TimeScalar<FastExp2>, TimeBlock<FastExp2Block>},
+	{"exp", -87.0f, 88.0f, FALSE, ErrorRelative, exp, FastExp, FastExpBlock,
+	 TimeScalar<expf>, TimeScalar<FastExp>, TimeBlock<FastExpBlock>},
+	{"log2", 1e-30f, 1e30f, TRUE, ErrorRelativeAboveOne, ReferenceLog2, FastLog2, FastLog2Block,
+	 TimeScalar<log2f>, TimeScalar<FastLog2>, TimeBlock<FastLog2Block>},
+	{"sin", -8192.0f, 8192.0f, FALSE, ErrorAbsolute, sin, FastSin, FastSinBlock,
+	 TimeScalar<sinf>, TimeScalar<FastSin>, TimeBlock<FastSinBlock>},
+	{"cos", -8192.0f, 8192.0f, FALSE, ErrorAbsolute, cos, FastCos, FastCosBlock,
+	 TimeScalar<cosf>, TimeScalar<FastCos>, TimeBlock<FastCosBlock>},
+	{"tan", -8192.0f, 8192.0f, FALSE, ErrorTangent, tan, FastTan, FastTanBlock,
+	 TimeScalar<tanf>, TimeScalar<FastTan>, TimeBlock<FastTanBlock>}
+};
+
+static float GetPoint (const TFastMathFunction *pFunction, unsigned nPoint, unsigned nPoints)
+{
+	assert (nPoints > 1);
+	double fPos = (double) nPoint / (nPoints - 1);
+
+	if (pFunction->bGeometric)
+	{
+		return (float) (pFunction->fMin * pow (pFunction->fMax / pFunction->fMin, fPos));
+	}
+
+	return (float) (pFunction->fMin + (pFunction->fMax - pFunction->fMin) * fPos);
+}
+
+// returns the maximum error of the scalar function or of the block function, which is
+// called with TIMING_VALUES points at once
+static double GetMaxError (const TFastMathFunction *pFunction, boolean bBlock)
+{
+	double fMaxError = 0.0;
+
+	for (unsigned nPoint = 0; nPoint < ERROR_POINTS; nPoint++)
+	{
+		float x = GetPoint (pFunction, nPoint, ERROR_POINTS);
+
+		float fResult;
+		if (bBlock)
+		{
+			unsigned nValue = nPoint % TIMING_VALUES;
+			if (nValue == 0)
+			{
+				unsigned nCount = ERROR_POINTS - nPoint;
+				if (nCount > TIMING_VALUES)
+				{
+					nCount = TIMING_VALUES;
+				}
+
+				for (unsigned i = 0; i < nCount; i++)
+				{
+					s_fInput[i] = GetPoint (pFunction, nPoint + i, ERROR_POINTS);
+				}
+
+				(*pFunction->pBlock) (s_fOutput, s_fInput, nCount);
+			}
+
+			fResult = s_fOutput[nValue];
+		}
+		else
+		{
+			fResult = (*pFunction->pFast) (x);
+		}
+
+		if (   pFunction->ErrorType == ErrorTangent
+		    && fabs (cos ((double) x)) <= 0.1)
+		{
+			continue;
+		}
+
+		double fReference = (*pFunction->pReference) (x);
+		double fError = fabs (fResult - fReference);
+
+		switch (pFunction->ErrorType)
+		{
+		case ErrorRelative:
+			fError /= fabs (fReference);
+			break;
+
+		case ErrorRelativeAboveOne:
+		case ErrorTangent:
+			if (fabs (fReference) > 1.0)
+			{
+				fError /= fabs (fReference);
+			}
+			break;
+
+		default:
+			break;
+		}
+
+		if (fError > fMaxError)
+		{
+			fMaxError = fError;
+		}
+	}
+
+	return fMaxError;
+}
+
+static float GetNanoSecs (unsigned nTicks)
+{
+	return (float) ((double) nTicks * 1000000000.0 / CLOCKHZ / (TIMING_VALUES * TIMING_REPEAT));
+}
+
+void RunFastMathBenchmark (void)
+{
+	// The maximum error of each function is measured against the C library in
+	// double precision at ERROR_POINTS points of the documented range (see
+	// fastmath.h), for the scalar and for the block function. The time per value
+	// is measured for the float function of the C library, the scalar fast
+	// function and the block function (SIMD, if available) with TIMING_VALUES
+	// values from the same range.
+	for (unsigned i = 0; i < sizeof s_Functions / sizeof s_Functions[0]; i++)
+	{
+		const TFastMathFunction *pFunction = &s_Functions[i];
+
+		double fMaxError = GetMaxError (pFunction, FALSE);
+		double fMaxBlockError = GetMaxError (pFunction, TRUE);
+
+		for (unsigned nValue = 0; nValue < TIMING_VALUES; nValue++)
+		{
+			s_fInput[nValue] = GetPoint (pFunction, nValue, TIMING_VALUES);
+		}
+
+		unsigned nLibraryTicks = (*pFunction->pTimeLibrary) ();
+		unsigned nFastTicks = (*pFunction->pTimeFast) ();
+		unsigned nBlockTicks = (*pFunction->pTimeBlock) ();
+
+		CLogger::Get ()->Write (FromFastMath, LogNotice,
+					"%s: max. %s error %.2fe-7 (block %.2fe-7), "
+					"libm %.1f ns, fast %.1f ns, block %.1f ns per value",
+					pFunction->pName,
+					s_pErrorName[pFunction->ErrorType],
+					fMaxError * 1e7, fMaxBlockError * 1e7,
+					GetNanoSecs (nLibraryTicks),
+					GetNanoSecs (nFastTicks), GetNanoSecs (nBlockTicks));
+	}
+
+#ifdef FAST_MATH_SIMD
+	CLogger::Get ()->Write (FromFastMath, LogNotice, "Block functions use SIMD");
+#endif
+}
+
+#endif
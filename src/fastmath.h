@@ -0,0 +1,458 @@
+//
+// fastmath.h
+//
+// Fast approximations of the transcendental functions used by the DSP code
+//
+// MiniSynth Pi - A virtual analogue synthesizer for Raspberry Pi
+// Copyright (C) 2017-2023  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _fastmath_h
+#define _fastmath_h
+
+#include <circle/types.h>
+#include "config.h"
+
+// The functions replace expf(), exp2f(), log2f(), powf(), sinf(), cosf() and tanf()
+// of the C library in the DSP code. They work in single precision only, do not
+// check for NaN or infinity and do not set errno. Each function is available for
+// one float and (with NEON) for a vector of four floats (TFloat4), which
+// computes the same polynomials. The ...Block() functions process arrays with the
+// vector functions, if available. The error bounds below are given for the scalar
+// functions, RunFastMathBenchmark() measures them against the C library in double
+// precision and logs the error of the ...Block() functions separately (FastTan()
+// on a TFloat4 divides with a refined reciprocal estimate on AArch32):
+//
+// FastExp2 (x)	x in [-126, 127.4]	relative error < 2.5e-7
+// FastExp (x)	x in [-87, 88]		relative error < 2.5e-7 + 7.3e-8 * |x|
+//					(|x| * 2^-24 from rounding x * log2 (e) to float,
+//					 1.3e-8 * |x| from rounding log2 (e) to float)
+// FastLog2 (x)	x in [0.5, 2]		absolute error < 1.3e-7
+//		other x > 0 (normal)	relative error < 1.1e-7
+// FastPow (x, y)	x >= 0		FastExp2 (y * FastLog2 (x)), 0 for x == 0
+// FastSin (x)	|x| <= 8192		absolute error < 1e-7
+// FastCos (x)	|x| <= 8192		absolute error < 1e-7
+// FastTan (x)	|x| <= 8192		absolute error < 2.5e-7 for |tan (x)| < 1,
+//					relative error < 3e-7 for other x with |cos (x)| > 0.1
+//					(near the zeros, the reduction error divided by
+//					 the small sine is relatively large)
+//
+// The exponent is reduced to [-0.5, 0.5] and 2^x is approximated by a minimax
+// polynomial of degree 5. The logarithm is reduced to a mantissa in [sqrt(0.5),
+// sqrt(2)) and log2(1+t) = t * P(t) with a minimax polynomial of degree 7. The angle
+// is reduced to [-PI/4, PI/4] in three steps (Cody-Waite) and the polynomials of
+// sin and cos are taken from the Cephes library.
+
+#if defined (__ARM_NEON) || defined (__ARM_NEON__)
+	#include <arm_neon.h>
+	#define FAST_MATH_SIMD
+#endif
+
+#define FAST_MATH_LOG2E		1.44269504f
+#define FAST_MATH_SQRT_HALF	0x3F3504F3	// sqrt (0.5) as float
+
+#define FAST_MATH_EXP2_C0	1.00000007f
+#define FAST_MATH_EXP2_C1	0.693146967f
+#define FAST_MATH_EXP2_C2	0.240221197f
+#define FAST_MATH_EXP2_C3	0.0555071327f
+#define FAST_MATH_EXP2_C4	0.00967554133f
+#define FAST_MATH_EXP2_C5	0.00132764722f
+
+#define FAST_MATH_LOG2_C0	1.44269477f
+#define FAST_MATH_LOG2_C1	-0.721357149f
+#define FAST_MATH_LOG2_C2	0.480939445f
+#define FAST_MATH_LOG2_C3	-0.360087216f
+#define FAST_MATH_LOG2_C4	0.286707452f
+#define FAST_MATH_LOG2_C5	-0.250069034f
+#define FAST_MATH_LOG2_C6	0.236890398f
+#define FAST_MATH_LOG2_C7	-0.145744518f
+
+#define FAST_MATH_2_OVER_PI	0.636619772f
+#define FAST_MATH_PI_2_1	1.5703125f	// PI/2 = PI_2_1 + PI_2_2 + PI_2_3
+#define FAST_MATH_PI_2_2	4.83751297e-4f
+#define FAST_MATH_PI_2_3	7.54978995e-8f
+
+#define FAST_MATH_SIN_C1	-1.6666654611e-1f
+#define FAST_MATH_SIN_C2	8.3321608736e-3f
+#define FAST_MATH_SIN_C3	-1.9515295891e-4f
+
+#define FAST_MATH_COS_C1	4.166664568298827e-2f
+#define FAST_MATH_COS_C2	-1.388731625493765e-3f
+#define FAST_MATH_COS_C3	2.443315711809948e-5f
+
+union TFastMathBits
+{
+	float	fValue;
+	s32	nValue;
+};
+
+inline float FastExp2 (float x)
+{
+	if (x < -126.0f)
+	{
+		x = -126.0f;
+	}
+	else if (x > 127.49f)
+	{
+		x = 127.49f;
+	}
+
+	// n = round (x), with x + 0.5 > 0
+	s32 n = (s32) (x + 127.5f) - 127;
+	float f = x - (float) n;
+
+	float p = FAST_MATH_EXP2_C0 + f * (FAST_MATH_EXP2_C1 + f * (FAST_MATH_EXP2_C2
+		+ f * (FAST_MATH_EXP2_C3 + f * (FAST_MATH_EXP2_C4 + f * FAST_MATH_EXP2_C5))));
+
+	TFastMathBits Scale;
+	Scale.nValue = (n + 127) << 23;
+
+	return p * Scale.fValue;
+}
+
+inline float FastExp (float x)
+{
+	return FastExp2 (x * FAST_MATH_LOG2E);
+}
+
+inline float FastLog2 (float x)
+{
+	// x = 2^e * m, with m in [sqrt (0.5), sqrt (2))
+	TFastMathBits Bits;
+	Bits.fValue = x;
+	s32 nBits = Bits.nValue - FAST_MATH_SQRT_HALF;
+	s32 e = nBits >> 23;
+	Bits.nValue = (nBits & 0x7FFFFF) + FAST_MATH_SQRT_HALF;
+
+	float t = Bits.fValue - 1.0f;
+
+	float p = FAST_MATH_LOG2_C0 + t * (FAST_MATH_LOG2_C1 + t * (FAST_MATH_LOG2_C2
+		+ t * (FAST_MATH_LOG2_C3 + t * (FAST_MATH_LOG2_C4 + t * (FAST_MATH_LOG2_C5
+		+ t * (FAST_MATH_LOG2_C6 + t * FAST_MATH_LOG2_C7))))));
+
+	return (float) e + t * p;
+}
+
+inline float FastPow (float x, float y)
+{
+	if (x <= 0.0f)
+	{
+		return 0.0f;
+	}
+
+	return FastExp2 (y * FastLog2 (x));
+}
+
+// sin and cos of the reduced angle r in [-PI/4, PI/4]
+inline void FastSinCosReduced (float r, float *pSin, float *pCos)
+{
+	float z = r * r;
+
+	*pSin = r + r * z * (FAST_MATH_SIN_C1 + z * (FAST_MATH_SIN_C2 + z * FAST_MATH_SIN_C3));
+	*pCos = 1.0f - 0.5f * z
+		+ z * z * (FAST_MATH_COS_C1 + z * (FAST_MATH_COS_C2 + z * FAST_MATH_COS_C3));
+}
+
+// returns the quadrant of x and the remaining angle in *pReduced
+inline s32 FastReduceAngle (float x, float *pReduced)
+{
+	float y = x * FAST_MATH_2_OVER_PI;
+	s32 q = (s32) (y >= 0.0f ? y + 0.5f : y - 0.5f);
+	float fQuadrant = (float) q;
+
+	*pReduced =   ((x - fQuadrant * FAST_MATH_PI_2_1)
+		    - fQuadrant * FAST_MATH_PI_2_2)
+		    - fQuadrant * FAST_MATH_PI_2_3;
+
+	return q;
+}
+
+inline void FastSinCos (float x, float *pSin, float *pCos)
+{
+	float r;
+	s32 q = FastReduceAngle (x, &r);
+
+	float s, c;
+	FastSinCosReduced (r, &s, &c);
+
+	float fSin = q & 1 ? c : s;
+	float fCos = q & 1 ? s : c;
+
+	*pSin = q & 2 ? -fSin : fSin;
+	*pCos = (q+1) & 2 ? -fCos : fCos;
+}
+
+inline float FastSin (float x)
+{
+	float fSin, fCos;
+	FastSinCos (x, &fSin, &fCos);
+
+	return fSin;
+}
+
+inline float FastCos (float x)
+{
+	float fSin, fCos;
+	FastSinCos (x, &fSin, &fCos);
+
+	return fCos;
+}
+
+inline float FastTan (float x)
+{
+	float r;
+	s32 q = FastReduceAngle (x, &r);
+
+	float s, c;
+	FastSinCosReduced (r, &s, &c);
+
+	return q & 1 ? -c / s : s / c;
+}
+
+#ifdef FAST_MATH_SIMD
+
+// a small set of vector operations, which is mapped to NEON intrinsics
+
+typedef float32x4_t TFloat4;
+typedef int32x4_t TInt4;
+typedef uint32x4_t TMask4;
+
+inline TFloat4 F4Load (const float *p)			{ return vld1q_f32 (p); }
+inline void F4Store (float *p, TFloat4 a)		{ vst1q_f32 (p, a); }
+inline TFloat4 F4Set (float f)				{ return vdupq_n_f32 (f); }
+inline TFloat4 F4Add (TFloat4 a, TFloat4 b)		{ return vaddq_f32 (a, b); }
+inline TFloat4 F4Sub (TFloat4 a, TFloat4 b)		{ return vsubq_f32 (a, b); }
+inline TFloat4 F4Mul (TFloat4 a, TFloat4 b)		{ return vmulq_f32 (a, b); }
+inline TFloat4 F4MulAdd (TFloat4 a, TFloat4 b, float c)	{ return vmlaq_n_f32 (a, b, c); }
+inline TFloat4 F4Min (TFloat4 a, TFloat4 b)		{ return vminq_f32 (a, b); }
+inline TFloat4 F4Max (TFloat4 a, TFloat4 b)		{ return vmaxq_f32 (a, b); }
+inline TFloat4 F4Negate (TFloat4 a)			{ return vnegq_f32 (a); }
+
+inline TFloat4 F4Divide (TFloat4 a, TFloat4 b)
+{
+#if AARCH == 64
+	return vdivq_f32 (a, b);
+#else
+	// reciprocal estimate with two Newton-Raphson steps
+	TFloat4 r = vrecpeq_f32 (b);
+	r = vmulq_f32 (r, vrecpsq_f32 (b, r));
+	r = vmulq_f32 (r, vrecpsq_f32 (b, r));
+
+	return vmulq_f32 (a, r);
+#endif
+}
+
+inline TInt4 F4ToInt (TFloat4 a)			{ return vcvtq_s32_f32 (a); }	// truncates
+inline TFloat4 F4FromInt (TInt4 n)			{ return vcvtq_f32_s32 (n); }
+inline TFloat4 F4FromBits (TInt4 n)			{ return vreinterpretq_f32_s32 (n); }
+inline TInt4 F4ToBits (TFloat4 a)			{ return vreinterpretq_s32_f32 (a); }
+
+inline TInt4 I4Set (s32 n)				{ return vdupq_n_s32 (n); }
+inline TInt4 I4Add (TInt4 a, TInt4 b)			{ return vaddq_s32 (a, b); }
+inline TInt4 I4Sub (TInt4 a, TInt4 b)			{ return vsubq_s32 (a, b); }
+inline TInt4 I4And (TInt4 a, TInt4 b)			{ return vandq_s32 (a, b); }
+inline TInt4 I4ShiftLeft23 (TInt4 a)			{ return vshlq_n_s32 (a, 23); }
+inline TInt4 I4ShiftRight23 (TInt4 a)			{ return vshrq_n_s32 (a, 23); }	// arithmetic
+
+inline TMask4 I4Test (TInt4 a, s32 nBits)		{ return vtstq_s32 (a, vdupq_n_s32 (nBits)); }
+inline TMask4 F4Less (TFloat4 a, TFloat4 b)		{ return vcltq_f32 (a, b); }
+inline TFloat4 F4Select (TMask4 m, TFloat4 a, TFloat4 b) { return vbslq_f32 (m, a, b); }
+
+inline TFloat4 FastExp2 (TFloat4 x)
+{
+	x = F4Max (F4Min (x, F4Set (127.49f)), F4Set (-126.0f));
+
+	TInt4 n = I4Sub (F4ToInt (F4Add (x, F4Set (127.5f))), I4Set (127));
+	TFloat4 f = F4Sub (x, F4FromInt (n));
+
+	TFloat4 p = F4MulAdd (F4Set (FAST_MATH_EXP2_C4), f, FAST_MATH_EXP2_C5);
+	p = F4Add (F4Set (FAST_MATH_EXP2_C3), F4Mul (f, p));
+	p = F4Add (F4Set (FAST_MATH_EXP2_C2), F4Mul (f, p));
+	p = F4Add (F4Set (FAST_MATH_EXP2_C1), F4Mul (f, p));
+	p = F4Add (F4Set (FAST_MATH_EXP2_C0), F4Mul (f, p));
+
+	return F4Mul (p, F4FromBits (I4ShiftLeft23 (I4Add (n, I4Set (127)))));
+}
+
+inline TFloat4 FastExp (TFloat4 x)
+{
+	return FastExp2 (F4Mul (x, F4Set (FAST_MATH_LOG2E)));
+}
+
+inline TFloat4 FastLog2 (TFloat4 x)
+{
+	TInt4 nBits = I4Sub (F4ToBits (x), I4Set (FAST_MATH_SQRT_HALF));
+	TInt4 e = I4ShiftRight23 (nBits);
+	TFloat4 m = F4FromBits (I4Add (I4And (nBits, I4Set (0x7FFFFF)),
+				       I4Set (FAST_MATH_SQRT_HALF)));
+
+	TFloat4 t = F4Sub (m, F4Set (1.0f));
+
+	TFloat4 p = F4MulAdd (F4Set (FAST_MATH_LOG2_C6), t, FAST_MATH_LOG2_C7);
+	p = F4Add (F4Set (FAST_MATH_LOG2_C5), F4Mul (t, p));
+	p = F4Add (F4Set (FAST_MATH_LOG2_C4), F4Mul (t, p));
+	p = F4Add (F4Set (FAST_MATH_LOG2_C3), F4Mul (t, p));
+	p = F4Add (F4Set (FAST_MATH_LOG2_C2), F4Mul (t, p));
+	p = F4Add (F4Set (FAST_MATH_LOG2_C1), F4Mul (t, p));
+	p = F4Add (F4Set (FAST_MATH_LOG2_C0), F4Mul (t, p));
+
+	return F4Add (F4FromInt (e), F4Mul (t, p));
+}
+
+inline TFloat4 FastPow (TFloat4 x, TFloat4 y)
+{
+	TFloat4 r = FastExp2 (F4Mul (y, FastLog2 (x)));
+
+	return F4Select (F4Less (F4Set (0.0f), x), r, F4Set (0.0f));
+}
+
+// returns the quadrant of x and the remaining angle in *pReduced
+inline TInt4 FastReduceAngle (TFloat4 x, TFloat4 *pReduced)
+{
+	TFloat4 y = F4Mul (x, F4Set (FAST_MATH_2_OVER_PI));
+	TFloat4 fHalf = F4Select (F4Less (y, F4Set (0.0f)), F4Set (-0.5f), F4Set (0.5f));
+	TInt4 q = F4ToInt (F4Add (y, fHalf));
+	TFloat4 fQuadrant = F4FromInt (q);
+
+	TFloat4 r = F4Sub (x, F4Mul (fQuadrant, F4Set (FAST_MATH_PI_2_1)));
+	r = F4Sub (r, F4Mul (fQuadrant, F4Set (FAST_MATH_PI_2_2)));
+	*pReduced = F4Sub (r, F4Mul (fQuadrant, F4Set (FAST_MATH_PI_2_3)));
+
+	return q;
+}
+
+inline void FastSinCosReduced (TFloat4 r, TFloat4 *pSin, TFloat4 *pCos)
+{
+	TFloat4 z = F4Mul (r, r);
+
+	TFloat4 s = F4MulAdd (F4Set (FAST_MATH_SIN_C2), z, FAST_MATH_SIN_C3);
+	s = F4Add (F4Set (FAST_MATH_SIN_C1), F4Mul (z, s));
+	*pSin = F4Add (r, F4Mul (F4Mul (r, z), s));
+
+	TFloat4 c = F4MulAdd (F4Set (FAST_MATH_COS_C2), z, FAST_MATH_COS_C3);
+	c = F4Add (F4Set (FAST_MATH_COS_C1), F4Mul (z, c));
+	c = F4Mul (F4Mul (z, z), c);
+	*pCos = F4Add (F4MulAdd (F4Set (1.0f), z, -0.5f), c);
+}
+
+inline void FastSinCos (TFloat4 x, TFloat4 *pSin, TFloat4 *pCos)
+{
+	TFloat4 r;
+	TInt4 q = FastReduceAngle (x, &r);
+
+	TFloat4 s, c;
+	FastSinCosReduced (r, &s, &c);
+
+	TMask4 bOdd = I4Test (q, 1);
+	TFloat4 fSin = F4Select (bOdd, c, s);
+	TFloat4 fCos = F4Select (bOdd, s, c);
+
+	*pSin = F4Select (I4Test (q, 2), F4Negate (fSin), fSin);
+	*pCos = F4Select (I4Test (I4Add (q, I4Set (1)), 2), F4Negate (fCos), fCos);
+}
+
+inline TFloat4 FastSin (TFloat4 x)
+{
+	TFloat4 fSin, fCos;
+	FastSinCos (x, &fSin, &fCos);
+
+	return fSin;
+}
+
+inline TFloat4 FastCos (TFloat4 x)
+{
+	TFloat4 fSin, fCos;
+	FastSinCos (x, &fSin, &fCos);
+
+	return fCos;
+}
+
+inline TFloat4 FastTan (TFloat4 x)
+{
+	TFloat4 r;
+	TInt4 q = FastReduceAngle (x, &r);
+
+	TFloat4 s, c;
+	FastSinCosReduced (r, &s, &c);
+
+	TMask4 bOdd = I4Test (q, 1);
+
+	return F4Divide (F4Select (bOdd, F4Negate (c), s), F4Select (bOdd, s, c));
+}
+
+#endif
+
+// applies a function to nCount values, pOut may be equal to pIn
+template <float (*Scalar) (float)
+#ifdef FAST_MATH_SIMD
+	  , TFloat4 (*Vector) (TFloat4)
+#endif
+	  >
+inline void FastMathBlock (float *pOut, const float *pIn, unsigned nCount)
+{
+#ifdef FAST_MATH_SIMD
+	for (; nCount >= 4; nCount -= 4, pIn += 4, pOut += 4)
+	{
+		F4Store (pOut, (*Vector) (F4Load (pIn)));
+	}
+#endif
+
+	for (; nCount > 0; nCount--)
+	{
+		*pOut++ = (*Scalar) (*pIn++);
+	}
+}
+
+#ifdef FAST_MATH_SIMD
+	#define FAST_MATH_BLOCK(function)	FastMathBlock<function, function>
+#else
+	#define FAST_MATH_BLOCK(function)	FastMathBlock<function>
+#endif
+
+inline void FastExp2Block (float *pOut, const float *pIn, unsigned nCount)
+{
+	FAST_MATH_BLOCK (FastExp2) (pOut, pIn, nCount);
+}
+
+inline void FastExpBlock (float *pOut, const float *pIn, unsigned nCount)
+{
+	FAST_MATH_BLOCK (FastExp) (pOut, pIn, nCount);
+}
+
+inline void FastLog2Block (float *pOut, const float *pIn, unsigned nCount)
+{
+	FAST_MATH_BLOCK (FastLog2) (pOut, pIn, nCount);
+}
+
+inline void FastSinBlock (float *pOut, const float *pIn, unsigned nCount)
+{
+	FAST_MATH_BLOCK (FastSin) (pOut, pIn, nCount);
+}
+
+inline void FastCosBlock (float *pOut, const float *pIn, unsigned nCount)
+{
+	FAST_MATH_BLOCK (FastCos) (pOut, pIn, nCount);
+}
+
+inline void FastTanBlock (float *pOut, const float *pIn, unsigned nCount)
+{
+	FAST_MATH_BLOCK (FastTan) (pOut, pIn, nCount);
+}
+
+#ifdef FAST_MATH_BENCHMARK
+void RunFastMathBenchmark (void);		// logs the error and throughput of each function
+#endif
+
+#endif
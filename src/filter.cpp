@@ -26,62 +26,134 @@
 //
 #include "filter.h"
 #include "math.h"
+#include "fastmath.h"
+#include "samplerate.h"
 #include "config.h"
 #include <assert.h>
 
 #define MAX_FREQ	20000
 
-CFilter::CFilter (CSynthModule *pInput, CSynthModule *pModulator, CSynthModule *pEnvelope)
+// the cutoff frequency is limited below the Nyquist frequency at lower sample rates
+static float s_fMaxFrequency = MAX_FREQ;
+static unsigned s_nTableSampleRate = 0;		// tables are invalid
+
+#ifdef FIXED_POINT_DSP
+
+// cos (W0), sin (W0) and 1 - cos (W0) for the cutoff frequencies 10% to 100%
+#define CUTOFF_STEPS_PER_PERCENT	20
+#define CUTOFF_STEPS			(90 * CUTOFF_STEPS_PER_PERCENT + 1)
+
+static float s_fCosW0[CUTOFF_STEPS];
+static float s_fSinW0[CUTOFF_STEPS];
+static float s_fOneMinusCosW0[CUTOFF_STEPS];	// calculated without cancellation
+
+#endif
+
+template <typename TSample>
+const TFilterParameters CFilterT<TSample>::s_DefaultParameters =
+{
+	80.0f,
+	1.68179283f,		// GetQ (50)
+	0.0f
+#ifdef FIXED_POINT_DSP
+	, 80 * Q16_ONE,
+	0
+#endif
+};
+
+template <typename TSample>
+CFilterT<TSample>::CFilterT (CSynthModuleT<TSample> *pInput, CSynthModuleT<TSample> *pModulator,
+			     CSynthModuleT<TSample> *pEnvelope)
 :	m_pInput (pInput),
 	m_pModulator (pModulator),
 	m_pEnvelope (pEnvelope),
-	m_fCutoffFrequency (80.0),
-	m_fResonance (50.0),
-	m_fModulationVolume (0.0),
+	m_pParameters (&s_DefaultParameters),
 	m_X1 (0.0),
 	m_X2 (0.0),
 	m_Y0 (0.0),
 	m_Y1 (0.0),
 	m_Y2 (0.0)
+#ifdef FIXED_POINT_DSP
+	, m_nCutoffStep (CUTOFF_STEPS),		// invalid
+	m_fCoefficientQ (0.0f),
+	m_nX1 (0),
+	m_nX2 (0),
+	m_nY1 (0),
+	m_nY2 (0),
+	m_nOutputLevel (0)
+#endif
 {
+	if (s_nTableSampleRate != CSampleRate::Get ())	// the voices are created on core 0 only
+	{
+		UpdateTables ();
+	}
 }
 
-CFilter::~CFilter (void)
+template <typename TSample>
+CFilterT<TSample>::~CFilterT (void)
 {
 	m_pInput = 0;
 	m_pModulator = 0;
 	m_pEnvelope = 0;
+	m_pParameters = 0;
 }
 
-void CFilter::SetCutoffFrequency (unsigned nPercent)
+template <typename TSample>
+void CFilterT<TSample>::SetParameters (const TFilterParameters *pParameters)
 {
-	assert (nPercent <= 100);
-	m_fCutoffFrequency = (float) nPercent;
+	assert (pParameters != 0);
+	m_pParameters = pParameters;
 }
 
-void CFilter::SetResonance (unsigned nPercent)
+template <typename TSample>
+float CFilterT<TSample>::GetQ (unsigned nResonance)
 {
-	assert (nPercent <= 100);
-	m_fResonance = (float) nPercent;
+	assert (nResonance <= 100);
 
-	// optimizing for speed because "a" is fixed: pow(a, b) == exp(log(a)*b)
-	// m_Q = powf (sqrt (2), (m_fResonance - 100.0/5.0) / (100.0/5.0));
-#define LOG_SQRT2	0.34657359f
-	m_Q = expf (LOG_SQRT2 * (m_fResonance - 100.0/5.0) / (100.0/5.0));
+	// optimizing for speed because "a" is fixed: pow(a, b) == exp2(log2(a)*b)
+	// return powf (sqrt (2), (nResonance - 100.0/5.0) / (100.0/5.0));
+	return FastExp2 (0.5f * (nResonance - 100.0f/5.0f) / (100.0f/5.0f));
 }
 
-void CFilter::SetModulationVolume (float fVolume)
+template <typename TSample>
+void CFilterT<TSample>::UpdateTables (void)
 {
-	assert (0.0 <= fVolume && fVolume <= 1.0);
-	m_fModulationVolume = fVolume;
+	s_nTableSampleRate = CSampleRate::Get ();
+
+	s_fMaxFrequency = 0.45f * s_nTableSampleRate;
+	if (s_fMaxFrequency > MAX_FREQ)
+	{
+		s_fMaxFrequency = MAX_FREQ;
+	}
+
+#ifdef FIXED_POINT_DSP
+	for (unsigned nStep = 0; nStep < CUTOFF_STEPS; nStep++)
+	{
+		float fCutoffFrequency = 10.0f + (float) nStep / CUTOFF_STEPS_PER_PERCENT;
+		float F0 = FastExp2 ((fCutoffFrequency-100.0f) / 10.0f) * MAX_FREQ;
+		if (F0 > s_fMaxFrequency)
+		{
+			F0 = s_fMaxFrequency;
+		}
+
+		float W0 = 2.0f*PI * F0 / s_nTableSampleRate;
+
+		FastSinCos (W0, &s_fSinW0[nStep], &s_fCosW0[nStep]);
+
+		float fSinHalfW0 = FastSin (W0 / 2.0f);
+		s_fOneMinusCosW0[nStep] = 2.0f * fSinHalfW0*fSinHalfW0;
+	}
+#endif
 }
 
-void CFilter::NextSample (void)
+template <>
+void CFilterT<float>::NextSample (void)
 {
-	float fCutoffFrequency = m_fCutoffFrequency;
+	assert (m_pParameters != 0);
+	float fCutoffFrequency = m_pParameters->fCutoffFrequency;
 
 	assert (m_pModulator != 0);
-	fCutoffFrequency *= 1.0 + m_pModulator->GetOutputLevel ()*m_fModulationVolume;
+	fCutoffFrequency *= 1.0f + m_pModulator->GetOutputLevel ()*m_pParameters->fModulationVolume;
 
 	assert (m_pEnvelope != 0);
 	fCutoffFrequency *= m_pEnvelope->GetOutputLevel ();
@@ -108,25 +180,121 @@ void CFilter::NextSample (void)
 	m_Y1 = m_Y0;
 }
 
-float CFilter::GetOutputLevel (void) const
+template <>
+float CFilterT<float>::GetOutputLevel (void) const
 {
 	return m_Y0;
 }
 
-void CFilter::CalculateCoefficients (float fCutoffFrequency)
+template <typename TSample>
+void CFilterT<TSample>::CalculateCoefficients (float fCutoffFrequency)
 {
-	// optimizing for speed because "a" is fixed: pow(a, b) == exp(log(a)*b)
+	// optimizing for speed because "a" is fixed: pow(a, b) == exp2(log2(a)*b)
 	// float F0 = powf (2.0, (m_fCutoffFrequency-100.0) / 10.0) * MAX_FREQ;
-#define LOG_2	0.69314718f
-	float F0 = expf (LOG_2 * (fCutoffFrequency-100.0) / 10.0) * MAX_FREQ;
-
-	float W0 = 2.0*PI * F0 / SAMPLE_RATE;
-	float Alpha = sinf (W0) / (2.0*m_Q);
-	float CosW0 = cosf (W0);
-
-	m_A0 =  1.0 + Alpha;
-	m_A1 = -2.0 * CosW0;
-	m_A2 =  1.0 - Alpha;
-	m_B1 =  1.0 - CosW0;
-	m_B0_B2 = m_B1 / 2.0;		// coefficients B0 and B2 are equal
+	float F0 = FastExp2 ((fCutoffFrequency-100.0f) / 10.0f) * MAX_FREQ;
+	if (F0 > s_fMaxFrequency)
+	{
+		F0 = s_fMaxFrequency;
+	}
+
+	float W0 = 2.0f*PI * F0 / s_nTableSampleRate;
+	float SinW0, CosW0;
+	FastSinCos (W0, &SinW0, &CosW0);
+	float Alpha = SinW0 / (2.0f*m_pParameters->fQ);
+
+	m_A0 =  1.0f + Alpha;
+	m_A1 = -2.0f * CosW0;
+	m_A2 =  1.0f - Alpha;
+	m_B1 =  1.0f - CosW0;
+	m_B0_B2 = m_B1 / 2.0f;		// coefficients B0 and B2 are equal
+}
+
+#ifdef FIXED_POINT_DSP
+
+template <>
+void CFilterT<TQ15>::NextSample (void)
+{
+	assert (m_pParameters != 0);
+	TQ16 nCutoffFrequency = m_pParameters->nCutoffFrequency;
+
+	// the cutoff frequency is at most 200% with modulation, so that it is reduced
+	// to Q8 before the multiplications, to fit into 32 bits
+	assert (m_pModulator != 0);
+	TQ15 nGain = Q15_ONE + Q15Multiply (m_pModulator->GetOutputLevel (),
+					    m_pParameters->nModulationVolume);
+	nCutoffFrequency = ((nCutoffFrequency >> 8) * nGain) >> 7;
+
+	assert (m_pEnvelope != 0);
+	nCutoffFrequency = ((nCutoffFrequency >> 8) * m_pEnvelope->GetOutputLevel ()) >> 7;
+
+	if (nCutoffFrequency < 10 * Q16_ONE)
+	{
+		nCutoffFrequency = 10 * Q16_ONE;
+	}
+	else if (nCutoffFrequency > 100 * Q16_ONE)
+	{
+		nCutoffFrequency = 100 * Q16_ONE;
+	}
+
+	unsigned nCutoffStep = (  (nCutoffFrequency - 10 * Q16_ONE) * CUTOFF_STEPS_PER_PERCENT
+				+ Q16_ONE/2) >> 16;
+	if (   nCutoffStep != m_nCutoffStep
+	    || m_pParameters->fQ != m_fCoefficientQ)
+	{
+		UpdateCoefficients (nCutoffStep);
+	}
+
+	// the input is converted to Q27, which gives enough headroom for the resonance
+	assert (m_pInput != 0);
+	s32 nX0 = m_pInput->GetOutputLevel () << 12;
+
+	s64 nY0 =   (s64) m_nB0_B2 * (nX0 + m_nX2) + (s64) m_nB1 * m_nX1
+		  - (s64) m_nA1 * m_nY1 - (s64) m_nA2 * m_nY2;
+	nY0 >>= 29;
+
+	if (nY0 > 0x7FFFFFFF)
+	{
+		nY0 = 0x7FFFFFFF;
+	}
+	else if (nY0 < -0x7FFFFFFF)
+	{
+		nY0 = -0x7FFFFFFF;
+	}
+
+	m_nX2 = m_nX1;
+	m_nY2 = m_nY1;
+	m_nX1 = nX0;
+	m_nY1 = (s32) nY0;
+
+	m_nOutputLevel = Q15SaturateWide (m_nY1 >> 12);
+}
+
+template <>
+TQ15 CFilterT<TQ15>::GetOutputLevel (void) const
+{
+	return m_nOutputLevel;
 }
+
+template <typename TSample>
+void CFilterT<TSample>::UpdateCoefficients (unsigned nCutoffStep)
+{
+	assert (nCutoffStep < CUTOFF_STEPS);
+	m_nCutoffStep = nCutoffStep;
+	m_fCoefficientQ = m_pParameters->fQ;
+
+	// calculated with float, normalized and converted to Q29
+	float Alpha = s_fSinW0[nCutoffStep] / (2.0f*m_fCoefficientQ);
+	float fScale = (float) (1 << 29) / (1.0f + Alpha);
+
+	m_nA1 = (s32) (-2.0f * s_fCosW0[nCutoffStep] * fScale);
+	m_nA2 = (s32) ((1.0f - Alpha) * fScale);
+	m_nB1 = (s32) (s_fOneMinusCosW0[nCutoffStep] * fScale);
+	m_nB0_B2 = m_nB1 / 2;
+}
+
+#endif
+
+template class CFilterT<float>;
+#ifdef FIXED_POINT_DSP
+template class CFilterT<TQ15>;
+#endif
@@ -24,33 +24,51 @@
 
 #include "synthmodule.h"
 
-class CFilter : public CSynthModule
+struct TFilterParameters
+{
+	float	fCutoffFrequency;		// in percent [10.0, 100.0]
+	float	fQ;				// derived from resonance
+	float	fModulationVolume;		// [0.0, 1.0]
+#ifdef FIXED_POINT_DSP
+	TQ16	nCutoffFrequency;		// derived from the float values
+	TQ15	nModulationVolume;
+#endif
+};
+
+template <typename TSample>
+class CFilterT : public CSynthModuleT<TSample>
 {
 public:
-	CFilter (CSynthModule *pInput, CSynthModule *pModulator, CSynthModule *pEnvelope);
-	~CFilter (void);
+	CFilterT (CSynthModuleT<TSample> *pInput, CSynthModuleT<TSample> *pModulator,
+		  CSynthModuleT<TSample> *pEnvelope);
+	~CFilterT (void);
 
-	void SetCutoffFrequency (unsigned nPercent);
-	void SetResonance (unsigned nPercent);
-	void SetModulationVolume (float fVolume);	// [0.0, 1.0]
+	// the parameters are referenced, not copied
+	void SetParameters (const TFilterParameters *pParameters);
 
 	void NextSample (void);
-	float GetOutputLevel (void) const;		// returns [-1.0, 1.0]
+	TSample GetOutputLevel (void) const;		// returns [-1.0, 1.0]
+
+	// helper to derive the parameters
+	static float GetQ (unsigned nResonance);	// in percent
+
+	// rebuilds the tables, call after the sample rate has been changed
+	static void UpdateTables (void);
 
 private:
 	void CalculateCoefficients (float fCutoffFrequency);
+#ifdef FIXED_POINT_DSP
+	void UpdateCoefficients (unsigned nCutoffStep);	// from the cutoff table
+#endif
 
 private:
-	CSynthModule *m_pInput;
-	CSynthModule *m_pModulator;
-	CSynthModule *m_pEnvelope;
+	CSynthModuleT<TSample> *m_pInput;
+	CSynthModuleT<TSample> *m_pModulator;
+	CSynthModuleT<TSample> *m_pEnvelope;
 
-	float m_fCutoffFrequency;
-	float m_fResonance;
-	float m_fModulationVolume;
-
-	float m_Q;
+	const TFilterParameters *m_pParameters;
 
+	// float implementation
 	float m_A0;
 	float m_A1;
 	float m_A2;
@@ -62,6 +80,37 @@ private:
 	float m_Y0;
 	float m_Y1;
 	float m_Y2;
+
+#ifdef FIXED_POINT_DSP
+	// fixed-point implementation, the coefficients are normalized (divided by A0),
+	// the cutoff is quantized to steps of the cutoff table, the coefficients are
+	// only recalculated, when the step or Q has changed
+	unsigned m_nCutoffStep;
+	float m_fCoefficientQ;
+
+	s32 m_nA1;					// Q29
+	s32 m_nA2;
+	s32 m_nB0_B2;
+	s32 m_nB1;
+
+	s32 m_nX1;					// Q27
+	s32 m_nX2;
+	s32 m_nY1;
+	s32 m_nY2;
+
+	TQ15 m_nOutputLevel;
+#endif
+
+	static const TFilterParameters s_DefaultParameters;
 };
 
+template <> void CFilterT<float>::NextSample (void);
+template <> float CFilterT<float>::GetOutputLevel (void) const;
+#ifdef FIXED_POINT_DSP
+template <> void CFilterT<TQ15>::NextSample (void);
+template <> TQ15 CFilterT<TQ15>::GetOutputLevel (void) const;
+#endif
+
+typedef CFilterT<float> CFilter;
+
 #endif
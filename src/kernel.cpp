@@ -18,6 +18,9 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include "kernel.h"
+#include "midiparser.h"
+#include "samplerate.h"
+#include "fastmath.h"
 #include "config.h"
 #include <circle/machineinfo.h>
 #include <circle/string.h>
@@ -35,6 +38,9 @@ CKernel::CKernel (void)
 	m_EMMC (&m_Interrupt, &m_Timer, &m_ActLED),
 	m_Config (&m_FileSystem),
 	m_pSynthesizer (0)
+#ifdef STRESS_TEST
+	, m_pStressTest (0)
+#endif
 {
 }
 
@@ -106,6 +112,23 @@ boolean CKernel::Initialize (void)
 		// TODO : initialize display
 	}
 
+	if (bOK)
+	{
+		// the sample rate must be set, before the synthesizer is created
+		unsigned nSampleRate = m_Options.GetAppOptionDecimal ("samplerate",
+								      SAMPLE_RATE_DEFAULT);
+		if (!CSampleRate::IsValid (nSampleRate))
+		{
+			m_Logger.Write (FromKernel, LogWarning, "Invalid sample rate: %u Hz",
+					nSampleRate);
+
+			nSampleRate = SAMPLE_RATE_DEFAULT;
+		}
+
+		CSampleRate::Set (nSampleRate);
+		m_Logger.Write (FromKernel, LogNotice, "Sample rate is %u Hz", nSampleRate);
+	}
+
 	if (bOK)
 	{
 		const char *pSoundDevice = m_Options.GetSoundDevice ();
@@ -143,29 +166,88 @@ TShutdownMode CKernel::Run (void)
 		m_Logger.Write (FromKernel, LogPanic, "Cannot mount drive: %s", DRIVE);
 	}
 
+#ifdef TRACE_EVENTS
+	m_Trace.Initialize ();
+#endif
+
 	// Load global configuration
 	m_Config.Load ();
 
-	// Load all patches
-	for (unsigned i = 0; i < PATCHES; i++)
-	{
-		m_Config.SetActivePatchNumber (i);
-
-		CPatch *pPatch = m_Config.GetActivePatch ();
-		assert (pPatch != 0);
+#ifdef PATCH_LOAD_BENCHMARK
+	m_Config.RunPatchLoadBenchmark ();
+#endif
 
-		pPatch->Load ();
-	}
+	// Load patch 0, the other patches are loaded in the background
+	m_Config.LoadPatches ();
 
 	// Activate patch 0
 	m_Config.SetActivePatchNumber (0);
 	assert (m_pSynthesizer);
 	m_pSynthesizer->SetPatch (m_Config.GetActivePatch ());
 
+	// Activate the patches of the other multi-timbral parts
+	for (unsigned nPart = 1; nPart < PARTS; nPart++)
+	{
+		if (m_Config.GetEnabledParts () & (1 << nPart))
+		{
+			m_pSynthesizer->SetPatch (m_Config.GetPartPatch (nPart), nPart);
+		}
+	}
+
+	// Activate the patches of the keyboard zones of part 0
+	for (unsigned nZone = 0; nZone < ZONES; nZone++)
+	{
+		if (m_Config.GetEnabledZones () & (1 << nZone))
+		{
+			m_pSynthesizer->SetPatch (m_Config.GetZonePatch (nZone), ZONE_PART (nZone));
+		}
+	}
+
+#ifdef VOICES_CALIBRATED
+	m_pSynthesizer->CalibrateVoices ();
+#endif
+
+#ifdef NOTE_TIMING_TEST
+	m_pSynthesizer->RunNoteTimingTest ();
+#endif
+
+#if defined (FIXED_POINT_TEST) && defined (FIXED_POINT_DSP)
+	m_pSynthesizer->RunFixedPointTest ();
+#endif
+
+#ifdef SAMPLE_RATE_BENCHMARK
+	m_pSynthesizer->RunSampleRateBenchmark ();
+#endif
+
+#ifdef FAST_MATH_BENCHMARK
+	RunFastMathBenchmark ();
+#endif
+
 	m_pSynthesizer->Start ();
 
+#ifdef CC_STORM_BENCHMARK
+	m_pSynthesizer->RunCCStormBenchmark ();
+#endif
+
+#ifdef MIDI_PARSER_BENCHMARK
+	CMIDIParser::RunBenchmark ();
+#endif
+
+#ifdef STRESS_TEST
+	unsigned nStressTestSecs = m_Options.GetAppOptionDecimal ("stresstest", 0);
+	if (nStressTestSecs > 0)
+	{
+		m_pStressTest = new CStressTest (m_pSynthesizer, &m_Config, nStressTestSecs);
+		assert (m_pStressTest != 0);
+	}
+#endif
+
 	// TODO: first display update
 
+#if defined (SHOW_STATUS) || defined (PROFILE_STAGES)
+	unsigned nNextStatusTime = m_Timer.GetUptime () + STATUS_INTERVAL_SECS;
+#endif
+
 #ifndef SCREENSHOT_AFTER_SECS
 	while (m_pSynthesizer->IsActive ())
 #else
@@ -176,6 +258,48 @@ TShutdownMode CKernel::Run (void)
 
 		m_pSynthesizer->Process (bUpdated);
 
+		m_Config.Process ();
+
+#ifdef TRACE_EVENTS
+		m_Trace.Process ();
+#endif
+
+#ifdef STRESS_TEST
+		if (m_pStressTest != 0)
+		{
+			m_pStressTest->Process ();
+
+			if (m_pStressTest->IsFinished ())
+			{
+				delete m_pStressTest;
+				m_pStressTest = 0;
+			}
+		}
+#endif
+
+#if defined (SHOW_STATUS) || defined (PROFILE_STAGES)
+		if (m_Timer.GetUptime () >= nNextStatusTime)
+		{
+#ifdef SHOW_STATUS
+			m_Logger.Write (FromKernel, LogNotice, "%s", m_pSynthesizer->GetStatus ());
+
+			CRenderStatistics Statistics;
+			m_pSynthesizer->GetStatistics (&Statistics);
+			Statistics.Dump (FromKernel);
+
+			CLatencyStatistics LatencyStatistics;
+			m_pSynthesizer->GetLatencyStatistics (&LatencyStatistics);
+			LatencyStatistics.Dump (FromKernel);
+#endif
+
+#ifdef PROFILE_STAGES
+			m_Profiler.Dump (FromKernel);
+#endif
+
+			nNextStatusTime += STATUS_INTERVAL_SECS;
+		}
+#endif
+
 		if (m_pSynthesizer->ConfigUpdated ())
 		{
 			// TODO: Update display (was MainWindow update)
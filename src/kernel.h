@@ -39,6 +39,9 @@
 #include <circle/types.h>
 #include "synthconfig.h"
 #include "minisynth.h"
+#include "trace.h"
+#include "profiler.h"
+#include "stresstest.h"
 
 enum TShutdownMode
 {
@@ -82,7 +85,16 @@ private:
 
 	FATFS			m_FileSystem;
 	CSynthConfig		m_Config;
+#ifdef TRACE_EVENTS
+	CTrace			m_Trace;
+#endif
+#ifdef PROFILE_STAGES
+	CProfiler		m_Profiler;
+#endif
 	CMiniSynthesizer	*m_pSynthesizer;
+#ifdef STRESS_TEST
+	CStressTest		*m_pStressTest;
+#endif
 };
 
 #endif
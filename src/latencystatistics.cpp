@@ -0,0 +1,161 @@
+//
+// latencystatistics.cpp
+//
+// MiniSynth Pi - A virtual analogue synthesizer for Raspberry Pi
+// Copyright (C) 2017-2023  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "latencystatistics.h"
+#include <circle/logger.h>
+#include <assert.h>
+
+static const char *SourceName[NoteSourceUnknown] =
+{
+	"umidi1", "umidi2", "serial", "ukbd1", "stress"
+};
+
+CLatencyStatistics::CLatencyStatistics (void)
+{
+	Reset ();
+}
+
+CLatencyStatistics::~CLatencyStatistics (void)
+{
+}
+
+void CLatencyStatistics::Reset (void)
+{
+	for (unsigned nSource = 0; nSource < NoteSourceUnknown; nSource++)
+	{
+		TSourceStatistics *pSource = &m_Source[nSource];
+
+		pSource->nCount = 0;
+		pSource->nMinimum = (unsigned) -1;
+		pSource->nMaximum = 0;
+		pSource->nSum = 0;
+
+		for (unsigned nBucket = 0; nBucket < LatencyBuckets; nBucket++)
+		{
+			pSource->nHistogram[nBucket] = 0;
+		}
+	}
+}
+
+void CLatencyStatistics::AddLatency (TNoteSource Source, unsigned nMicros)
+{
+	assert (Source < NoteSourceUnknown);
+	TSourceStatistics *pSource = &m_Source[Source];
+
+	pSource->nCount++;
+	pSource->nSum += nMicros;
+
+	if (nMicros < pSource->nMinimum)
+	{
+		pSource->nMinimum = nMicros;
+	}
+
+	if (nMicros > pSource->nMaximum)
+	{
+		pSource->nMaximum = nMicros;
+	}
+
+	unsigned nBucket = nMicros / LatencyBucketMicros;
+	if (nBucket >= LatencyBuckets)
+	{
+		nBucket = LatencyBuckets-1;
+	}
+
+	pSource->nHistogram[nBucket]++;
+}
+
+unsigned CLatencyStatistics::GetCount (TNoteSource Source) const
+{
+	assert (Source < NoteSourceUnknown);
+	return m_Source[Source].nCount;
+}
+
+unsigned CLatencyStatistics::GetMinimum (TNoteSource Source) const
+{
+	assert (Source < NoteSourceUnknown);
+	return m_Source[Source].nCount > 0 ? m_Source[Source].nMinimum : 0;
+}
+
+unsigned CLatencyStatistics::GetAverage (TNoteSource Source) const
+{
+	assert (Source < NoteSourceUnknown);
+	const TSourceStatistics *pSource = &m_Source[Source];
+
+	return pSource->nCount > 0 ? (unsigned) (pSource->nSum / pSource->nCount) : 0;
+}
+
+unsigned CLatencyStatistics::GetMaximum (TNoteSource Source) const
+{
+	assert (Source < NoteSourceUnknown);
+	return m_Source[Source].nMaximum;
+}
+
+unsigned CLatencyStatistics::GetPercentile (TNoteSource Source, unsigned nPercent) const
+{
+	assert (Source < NoteSourceUnknown);
+	assert (nPercent <= 100);
+	const TSourceStatistics *pSource = &m_Source[Source];
+
+	if (pSource->nCount == 0)
+	{
+		return 0;
+	}
+
+	// number of values, which must be below the percentile (rounded up)
+	unsigned nLimit = ((u64) pSource->nCount * nPercent + 99) / 100;
+
+	unsigned nValues = 0;
+	for (unsigned nBucket = 0; nBucket < LatencyBuckets-1; nBucket++)
+	{
+		nValues += pSource->nHistogram[nBucket];
+		if (nValues >= nLimit)
+		{
+			unsigned nMicros = (nBucket+1) * LatencyBucketMicros;
+
+			return nMicros < pSource->nMaximum ? nMicros : pSource->nMaximum;
+		}
+	}
+
+	return pSource->nMaximum;
+}
+
+void CLatencyStatistics::Dump (const char *pFrom) const
+{
+	for (unsigned nSource = 0; nSource < NoteSourceUnknown; nSource++)
+	{
+		TNoteSource Source = (TNoteSource) nSource;
+		if (GetCount (Source) == 0)
+		{
+			continue;
+		}
+
+		CLogger::Get ()->Write (pFrom, LogNotice,
+					"Latency %s: %u notes, min %u us, avg %u us, "
+					"p99 %u us, max %u us",
+					SourceName[nSource], GetCount (Source),
+					GetMinimum (Source), GetAverage (Source),
+					GetPercentile (Source, 99), GetMaximum (Source));
+	}
+}
+
+const char *CLatencyStatistics::GetSourceName (TNoteSource Source)
+{
+	assert (Source < NoteSourceUnknown);
+	return SourceName[Source];
+}
@@ -0,0 +1,81 @@
+//
+// latencystatistics.h
+//
+// Key-to-sound latency of the note input devices
+//
+// MiniSynth Pi - A virtual analogue synthesizer for Raspberry Pi
+// Copyright (C) 2017-2023  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _latencystatistics_h
+#define _latencystatistics_h
+
+#include <circle/types.h>
+
+enum TNoteSource				// the device, a note has been received from
+{
+	NoteSourceUSBMIDI1,			// umidi1
+	NoteSourceUSBMIDI2,			// umidi2
+	NoteSourceSerialMIDI,			// serial
+	NoteSourcePCKeyboard,			// ukbd1
+	NoteSourceStressTest,			// stress
+	NoteSourceUnknown			// not measured
+};
+
+// The latency is measured from the arrival of a note on message, before the global
+// lock is acquired, until the first non-zero sample of the started voice will be
+// audible. This is the time until the chunk, which contains this sample, has been
+// requested, plus the offset of the sample in the chunk, plus the DMA queue depth.
+// The values are counted in a histogram with LatencyBucketMicros resolution, from
+// which the percentiles are calculated.
+
+class CLatencyStatistics
+{
+public:
+	CLatencyStatistics (void);
+	~CLatencyStatistics (void);
+
+	void Reset (void);
+
+	void AddLatency (TNoteSource Source, unsigned nMicros);
+
+	unsigned GetCount (TNoteSource Source) const;
+	unsigned GetMinimum (TNoteSource Source) const;		// in microseconds
+	unsigned GetAverage (TNoteSource Source) const;
+	unsigned GetMaximum (TNoteSource Source) const;
+	unsigned GetPercentile (TNoteSource Source, unsigned nPercent) const;	// upper limit
+
+	// writes the statistics of the sources, which have been used, to the logger
+	void Dump (const char *pFrom) const;
+
+	static const char *GetSourceName (TNoteSource Source);
+
+private:
+	static const unsigned LatencyBucketMicros = 200;
+	static const unsigned LatencyBuckets = 256;		// last includes the overflow
+
+	struct TSourceStatistics
+	{
+		unsigned nCount;
+		unsigned nMinimum;
+		unsigned nMaximum;
+		u64 nSum;
+		unsigned nHistogram[LatencyBuckets];
+	};
+
+	TSourceStatistics m_Source[NoteSourceUnknown];
+};
+
+#endif
@@ -278,7 +278,8 @@ void CMainWindow::EventHandler (lv_obj_t *pObject, lv_event_code_t Event)
 
 		if (pObject == m_pButtonSave)
 		{
-			m_pConfig->GetActivePatch ()->Save ();
+			// queued, written by CSynthConfig::Process() via a temporary file
+			m_pConfig->SavePatch (m_pConfig->GetActivePatchNumber ());
 
 			return;
 		}
@@ -27,9 +27,11 @@
 #define MIDI_CONTROL_CHANGE	0b1011
 #define MIDI_PROGRAM_CHANGE	0b1100
 
-CMIDIDevice::CMIDIDevice (CMiniSynthesizer *pSynthesizer, CSynthConfig *pConfig)
+CMIDIDevice::CMIDIDevice (CMiniSynthesizer *pSynthesizer, CSynthConfig *pConfig,
+			  TNoteSource Source)
 :	m_pSynthesizer (pSynthesizer),
-	m_pConfig (pConfig)
+	m_pConfig (pConfig),
+	m_Source (Source)
 {
 }
 
@@ -57,55 +59,55 @@ void CMIDIDevice::MIDIMessageHandler (const u8 *pMessage, size_t nLength)
 	u8 ucKeyNumber = pMessage[1];
 	u8 ucVelocity  = pMessage[2];
 
+	// the parts, which listen on this channel
 	assert (m_pConfig != 0);
-	CPatch *pPatch = m_pConfig->GetActivePatch ();
-	assert (pPatch != 0);
-	unsigned nMIDIChannel = pPatch->GetParameter (MIDIChannel);
-	if (   nMIDIChannel != 0		// Omni mode
-	    && nMIDIChannel != (ucChannel + 1U))
-	{
-		return;
-	}
+	u16 usParts = m_pConfig->GetChannelParts (ucChannel);
 
-	switch (ucType)
+	for (; usParts != 0; usParts &= usParts-1)
 	{
-	case MIDI_NOTE_ON:
-		if (nLength < 3)
-		{
-			break;
-		}
+		unsigned nPart = __builtin_ctz (usParts);
 
-		if (ucVelocity > 0)
+		switch (ucType)
 		{
-			if (ucVelocity <= 127)
+		case MIDI_NOTE_ON:
+			if (nLength < 3)
 			{
-				m_pSynthesizer->NoteOn (ucKeyNumber, ucVelocity);
+				break;
 			}
-		}
-		else
-		{
-			m_pSynthesizer->NoteOff (ucKeyNumber);
-		}
-		break;
 
-	case MIDI_NOTE_OFF:
-		if (nLength < 3)
-		{
+			if (ucVelocity > 0)
+			{
+				if (ucVelocity <= 127)
+				{
+					m_pSynthesizer->NoteOn (ucKeyNumber, ucVelocity, nPart,
+								m_Source);
+				}
+			}
+			else
+			{
+				m_pSynthesizer->NoteOff (ucKeyNumber, nPart);
+			}
 			break;
-		}
 
-		m_pSynthesizer->NoteOff (ucKeyNumber);
-		break;
+		case MIDI_NOTE_OFF:
+			if (nLength < 3)
+			{
+				break;
+			}
 
-	case MIDI_CONTROL_CHANGE:
-		m_pSynthesizer->ControlChange (pMessage[1], pMessage[2]);
-		break;
+			m_pSynthesizer->NoteOff (ucKeyNumber, nPart);
+			break;
 
-	case MIDI_PROGRAM_CHANGE:
-		m_pSynthesizer->ProgramChange (pMessage[1]);
-		break;
+		case MIDI_CONTROL_CHANGE:
+			m_pSynthesizer->ControlChange (pMessage[1], pMessage[2], nPart);
+			break;
+
+		case MIDI_PROGRAM_CHANGE:
+			m_pSynthesizer->ProgramChange (pMessage[1], nPart);
+			break;
 
-	default:
-		break;
+		default:
+			break;
+		}
 	}
 }
@@ -22,13 +22,15 @@
 
 #include <circle/types.h>
 #include "synthconfig.h"
+#include "latencystatistics.h"
 
 class CMiniSynthesizer;
 
 class CMIDIDevice
 {
 public:
-	CMIDIDevice (CMiniSynthesizer *pSynthesizer, CSynthConfig *pConfig);
+	CMIDIDevice (CMiniSynthesizer *pSynthesizer, CSynthConfig *pConfig,
+		     TNoteSource Source);
 	~CMIDIDevice (void);
 
 protected:
@@ -37,6 +39,7 @@ protected:
 private:
 	CMiniSynthesizer *m_pSynthesizer;
 	CSynthConfig *m_pConfig;
+	TNoteSource m_Source;
 };
 
 #endif
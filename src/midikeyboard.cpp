@@ -33,7 +33,9 @@ TMIDIPacketHandler * const CMIDIKeyboard::s_pMIDIPacketHandler[MaxInstances] =
 
 CMIDIKeyboard::CMIDIKeyboard (CMiniSynthesizer *pSynthesizer, CSynthConfig *pConfig,
 			      unsigned nInstance)
-:	CMIDIDevice (pSynthesizer, pConfig),
+:	CMIDIDevice (pSynthesizer, pConfig,
+		     nInstance <= 1 ? (TNoteSource) (NoteSourceUSBMIDI1 + nInstance)
+				    : NoteSourceUnknown),
 	m_nInstance (nInstance),
 	m_pMIDIDevice (0)
 {
@@ -0,0 +1,212 @@
+//
+// midiparser.cpp
+//
+// MiniSynth Pi - A virtual analogue synthesizer for Raspberry Pi
+// Copyright (C) 2017-2023  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "midiparser.h"
+#include <assert.h>
+
+#ifdef MIDI_PARSER_BENCHMARK
+	#include <circle/timer.h>
+	#include <circle/logger.h>
+	#include "math.h"
+#endif
+
+#define MIDI_SYSTEM_EXCLUSIVE	0xF0
+#define MIDI_END_OF_EXCLUSIVE	0xF7
+#define MIDI_REALTIME_FIRST	0xF8
+
+// message length including status byte, indexed by the upper nibble of channel
+// messages (0x8-0xE) and the lower nibble of system common messages (0x0-0x7)
+static const u8 s_ChannelMessageLength[8] = {3, 3, 3, 3, 2, 2, 3, 0};
+static const u8 s_SystemMessageLength[8]  = {0, 2, 3, 2, 0, 0, 1, 0};
+
+CMIDIParser::CMIDIParser (TMessageHandler *pHandler, void *pParam)
+:	m_pHandler (pHandler),
+	m_pParam (pParam),
+	m_ucRunningStatus (0),
+	m_nMessageLength (0),
+	m_nLength (0),
+	m_bSysEx (FALSE),
+	m_bSysExOverflow (FALSE)
+{
+	assert (m_pHandler != 0);
+}
+
+CMIDIParser::~CMIDIParser (void)
+{
+	m_pHandler = 0;
+}
+
+void CMIDIParser::Parse (const u8 *pData, size_t nLength)
+{
+	assert (pData != 0);
+	assert (m_pHandler != 0);
+
+	while (nLength-- > 0)
+	{
+		u8 ucData = *pData++;
+
+		if (!(ucData & 0x80))				// data byte
+		{
+			if (m_bSysEx)
+			{
+				if (m_nLength < MaxMessageSize-1)	// leave room for 0xF7
+				{
+					m_Message[m_nLength++] = ucData;
+				}
+				else
+				{
+					m_bSysExOverflow = TRUE;
+				}
+
+				continue;
+			}
+
+			if (m_nLength == 0)
+			{
+				if (m_ucRunningStatus == 0)	// no status received yet
+				{
+					continue;
+				}
+
+				m_Message[0] = m_ucRunningStatus;
+				m_nLength = 1;
+			}
+
+			m_Message[m_nLength++] = ucData;
+
+			if (m_nLength >= m_nMessageLength)	// message is complete
+			{
+				(*m_pHandler) (m_Message, m_nLength, m_pParam);
+
+				m_nLength = 0;
+			}
+
+			continue;
+		}
+
+		if (ucData >= MIDI_REALTIME_FIRST)		// may come at any time
+		{
+			(*m_pHandler) (&ucData, 1, m_pParam);
+
+			continue;
+		}
+
+		if (m_bSysEx)				// any status byte ends it
+		{
+			m_bSysEx = FALSE;
+
+			if (ucData == MIDI_END_OF_EXCLUSIVE)
+			{
+				if (!m_bSysExOverflow)
+				{
+					m_Message[m_nLength++] = ucData;
+
+					(*m_pHandler) (m_Message, m_nLength, m_pParam);
+				}
+
+				m_nLength = 0;
+
+				continue;
+			}
+		}
+
+		m_Message[0] = ucData;
+		m_nLength = 1;
+
+		if (ucData < MIDI_SYSTEM_EXCLUSIVE)		// channel message
+		{
+			m_ucRunningStatus = ucData;
+			m_nMessageLength = s_ChannelMessageLength[(ucData >> 4) & 7];
+
+			continue;
+		}
+
+		m_ucRunningStatus = 0;			// cleared by system common messages
+
+		if (ucData == MIDI_SYSTEM_EXCLUSIVE)
+		{
+			m_bSysEx = TRUE;
+			m_bSysExOverflow = FALSE;
+
+			continue;
+		}
+
+		m_nMessageLength = s_SystemMessageLength[ucData & 7];
+		if (m_nMessageLength == 0)			// undefined or stray 0xF7
+		{
+			m_nLength = 0;
+		}
+		else if (m_nMessageLength == 1)			// tune request
+		{
+			(*m_pHandler) (m_Message, m_nLength, m_pParam);
+
+			m_nLength = 0;
+		}
+	}
+}
+
+#ifdef MIDI_PARSER_BENCHMARK
+
+static unsigned s_nBenchmarkMessages;
+
+static void BenchmarkHandler (const u8 *pMessage, size_t nLength, void *pParam)
+{
+	s_nBenchmarkMessages++;
+}
+
+void CMIDIParser::RunBenchmark (void)
+{
+	static const unsigned StreamSize = 0x10000;
+	static u8 Stream[StreamSize];
+
+	// mostly running status data with some status, real-time and SysEx bytes
+	unsigned nSeed = 1;
+	for (unsigned i = 0; i < StreamSize; i++)
+	{
+		unsigned nRandom = rand_r (&nSeed);
+		switch (nRandom & 0x1F)
+		{
+		case 0:
+		case 1:
+			Stream[i] = 0x80 | ((nRandom >> 5) & 0x7F);	// any status
+			break;
+
+		case 2:
+			Stream[i] = 0xF8;				// timing clock
+			break;
+
+		default:
+			Stream[i] = (nRandom >> 5) & 0x7F;
+			break;
+		}
+	}
+
+	CMIDIParser Parser (BenchmarkHandler);
+
+	s_nBenchmarkMessages = 0;
+
+	unsigned nTicks = CTimer::GetClockTicks ();
+	Parser.Parse (Stream, StreamSize);
+	nTicks = CTimer::GetClockTicks () - nTicks;
+
+	CLogger::Get ()->Write ("midiparser", LogNotice, "%u bytes, %u messages in %u us",
+				StreamSize, s_nBenchmarkMessages, nTicks / (CLOCKHZ / 1000000));
+}
+
+#endif
@@ -0,0 +1,64 @@
+//
+// midiparser.h
+//
+// Parses a MIDI byte stream with running status into messages
+//
+// MiniSynth Pi - A virtual analogue synthesizer for Raspberry Pi
+// Copyright (C) 2017-2023  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _midiparser_h
+#define _midiparser_h
+
+#include <circle/types.h>
+#include "config.h"
+
+// Channel messages may omit the status byte, if it is the same as of the previous
+// message (running status). System real-time messages (0xF8-0xFF) may appear
+// anywhere, even within other messages, and are passed on at once. System
+// exclusive messages are passed on completely (including 0xF0 and 0xF7), if they
+// fit into the buffer, otherwise they are dropped.
+
+class CMIDIParser
+{
+public:
+	typedef void TMessageHandler (const u8 *pMessage, size_t nLength, void *pParam);
+
+public:
+	CMIDIParser (TMessageHandler *pHandler, void *pParam = 0);
+	~CMIDIParser (void);
+
+	void Parse (const u8 *pData, size_t nLength);
+
+#ifdef MIDI_PARSER_BENCHMARK
+	static void RunBenchmark (void);	// logs the throughput for a fuzzed stream
+#endif
+
+private:
+	TMessageHandler *m_pHandler;
+	void *m_pParam;
+
+	u8 m_ucRunningStatus;			// 0 if none
+	unsigned m_nMessageLength;		// including status byte
+	unsigned m_nLength;			// received bytes of the message, 0 if idle
+
+	boolean m_bSysEx;
+	boolean m_bSysExOverflow;
+
+	static const unsigned MaxMessageSize = 256;	// for system exclusive
+	u8 m_Message[MaxMessageSize];
+};
+
+#endif
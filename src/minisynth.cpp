@@ -18,12 +18,15 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include "minisynth.h"
-#include "math.h"
+#include "trace.h"
+#include "samplerate.h"
 #include "config.h"
+#include "math.h"
 #include <circle/timer.h>
 #include <circle/synchronize.h>
 #include <circle/memory.h>
 #include <circle/logger.h>
+#include <circle/util.h>
 #include <assert.h>
 
 static const char FromMiniSynth[] = "synth";
@@ -37,12 +40,29 @@ CMiniSynthesizer::CMiniSynthesizer (CSynthConfig *pConfig, CInterruptSystem *pIn
 	m_bUseSerial (FALSE),
 	m_nConfigRevisionWrite (0),
 	m_nConfigRevisionRead (0),
-	m_VoiceManager (CMemorySystem::Get ()),
-	m_fVolume (0.0)
+	m_usPendingParts (0),
+	m_nEventIn (0),
+	m_nEventOut (0),
+	m_nNextEventFrame ((unsigned) -1),
+	m_VoiceManager (CMemorySystem::Get ())
 #ifdef SHOW_STATUS
-	, m_nMaxDelayTicks (0)
+	, m_nLastVoiceSteals (0),
+	m_nChunkTicks (0),
+	m_nChunkFrames (0),
+	m_nLatencyVoices (0)
 #endif
 {
+	for (unsigned nPart = 0; nPart < PARTS; nPart++)
+	{
+		m_nPendingMask[nPart] = 0;
+		m_nPendingProgram[nPart] = PATCHES;
+	}
+
+	memset (m_ucKeyZones, 0, sizeof m_ucKeyZones);
+
+#ifdef SHOW_STATUS
+	assert (VOICES <= 32);				// for m_nLatencyVoices
+#endif
 }
 
 CMiniSynthesizer::~CMiniSynthesizer (void)
@@ -76,39 +96,61 @@ void CMiniSynthesizer::Process (boolean bPlugAndPlayUpdated)
 	{
 		m_SerialController.Process ();
 	}
-}
 
-void CMiniSynthesizer::SetPatch (CPatch *pPatch)
-{
-	assert (pPatch != 0);
+	for (unsigned nPart = 0; nPart < PARTS; nPart++)
+	{
+		unsigned nProgram = m_nPendingProgram[nPart];
+		if (nProgram < PATCHES)
+		{
+			assert (m_pConfig != 0);
+			m_pConfig->GetPatch (nProgram);		// loads the patch
 
-	GlobalLock ();
+			GlobalLock ();
 
-	m_VoiceManager.SetPatch (pPatch);
+			if (m_nPendingProgram[nPart] == nProgram)	// not changed in the meantime
+			{
+				ProgramChange ((u8) nProgram, nPart);
+			}
 
-	m_fVolume = powf (pPatch->GetParameter (SynthVolume) / 100.0, 3.3f); // apply some curve
+			GlobalUnlock ();
+		}
+	}
+}
 
-	GlobalUnlock ();
+void CMiniSynthesizer::SetPatch (CPatch *pPatch, unsigned nPart)
+{
+	assert (pPatch != 0);
+
+	// the snapshot is applied by GetChunk(), so that this is only a pointer swap
+	m_VoiceManager.SetPatch (pPatch->GetSnapshot (), nPart);
 }
 
-void CMiniSynthesizer::NoteOn (u8 ucKeyNumber, u8 ucVelocity)
+void CMiniSynthesizer::NoteOn (u8 ucKeyNumber, u8 ucVelocity, unsigned nPart,
+			       TNoteSource Source)
 {
-	// apply velocity curve
-	assert (m_pConfig != 0);
-	ucVelocity = m_pConfig->MapVelocity (ucVelocity);
+	assert (ucKeyNumber <= 127);
+	assert (1 <= ucVelocity && ucVelocity <= 127);
+	assert (nPart < PARTS);
+
+	unsigned nTicks = CTimer::GetClockTicks ();	// before waiting for the lock
 
 	GlobalLock ();
 
-	m_VoiceManager.NoteOn (ucKeyNumber, ucVelocity);
+	QueueEvent (ucKeyNumber, ucVelocity, nPart, nTicks, Source);
 
 	GlobalUnlock ();
 }
 
-void CMiniSynthesizer::NoteOff (u8 ucKeyNumber)
+void CMiniSynthesizer::NoteOff (u8 ucKeyNumber, unsigned nPart)
 {
+	assert (ucKeyNumber <= 127);
+	assert (nPart < PARTS);
+
+	unsigned nTicks = CTimer::GetClockTicks ();
+
 	GlobalLock ();
 
-	m_VoiceManager.NoteOff (ucKeyNumber);
+	QueueEvent (ucKeyNumber, 0, nPart, nTicks);
 
 	GlobalUnlock ();
 }
@@ -126,7 +168,7 @@ boolean CMiniSynthesizer::ConfigUpdated (void)
 	return FALSE;
 }
 
-void CMiniSynthesizer::ControlChange (u8 ucFunction, u8 ucValue)
+void CMiniSynthesizer::ControlChange (u8 ucFunction, u8 ucValue, unsigned nPart)
 {
 	assert (m_pConfig != 0);
 	TSynthParameter Parameter = m_pConfig->MapMIDICC (ucFunction);
@@ -135,45 +177,826 @@ void CMiniSynthesizer::ControlChange (u8 ucFunction, u8 ucValue)
 		return;
 	}
 
+	ParameterChange (Parameter, CPatch::MapMIDIValue (Parameter, ucValue), nPart);
+}
+
+void CMiniSynthesizer::ParameterChange (TSynthParameter Parameter, unsigned nValue, unsigned nPart)
+{
+	ParameterChanges (&Parameter, &nValue, 1, nPart);
+}
+
+void CMiniSynthesizer::ParameterChanges (const TSynthParameter *pParameter, const unsigned *pValue,
+					 unsigned nCount, unsigned nPart)
+{
+	assert (pParameter != 0);
+	assert (pValue != 0);
+	assert (nPart < PARTS);
+
 	GlobalLock ();
 
-	CPatch *pPatch = m_pConfig->GetActivePatch ();
-	assert (pPatch != 0);
+	// coalesced and applied in GetChunk()
+	assert (SynthParameterUnknown <= 32);
+	for (unsigned i = 0; i < nCount; i++)
+	{
+		TSynthParameter Parameter = pParameter[i];
+		assert (Parameter < SynthParameterUnknown);
 
-	pPatch->SetMIDIParameter (Parameter, ucValue);
-	SetPatch (pPatch);
+		m_nPendingValue[nPart][Parameter] = pValue[i];
+		m_nPendingMask[nPart] |= 1 << Parameter;
+	}
 
-	m_nConfigRevisionWrite++;
+	m_usPendingParts |= 1 << nPart;
 
 	GlobalUnlock ();
 }
 
-void CMiniSynthesizer::ProgramChange (u8 ucProgram)
+void CMiniSynthesizer::ProgramChange (u8 ucProgram, unsigned nPart)
 {
 	assert (m_pConfig != 0);
+	assert (nPart < PARTS);
 
 	GlobalLock ();
 
 	if (ucProgram < PATCHES)
 	{
-		m_pConfig->SetActivePatchNumber (ucProgram);
-		SetPatch (m_pConfig->GetActivePatch ());
-		m_nConfigRevisionWrite++;
+		if (m_pConfig->IsPatchLoaded (ucProgram))
+		{
+			ApplyParameterChanges ();		// still for the previous patch
+
+			m_pConfig->SetPartPatchNumber (nPart, ucProgram);
+			SetPatch (m_pConfig->GetPartPatch (nPart), nPart);
+			if (nPart == 0)
+			{
+				m_nConfigRevisionWrite++;
+			}
+
+			m_nPendingProgram[nPart] = PATCHES;
+		}
+		else
+		{
+			m_nPendingProgram[nPart] = ucProgram;	// cannot load it here (IRQ)
+		}
+	}
+
+	GlobalUnlock ();
+}
+
+#ifdef CC_STORM_BENCHMARK
+
+void CMiniSynthesizer::RunCCStormBenchmark (void)
+{
+	static const unsigned Count = 1000;
+
+	assert (m_pConfig != 0);
+	CPatch *pPatch = m_pConfig->GetActivePatch ();
+	assert (pPatch != 0);
+
+	// find a MIDI CC, which is mapped to a patch parameter
+	u8 ucFunction;
+	for (ucFunction = MIDICC_MIN; ucFunction < MIDICC_MAX; ucFunction++)
+	{
+		if (m_pConfig->MapMIDICC (ucFunction) < SynthParameterUnknown)
+		{
+			break;
+		}
 	}
 
+	TSynthParameter Parameter = m_pConfig->MapMIDICC (ucFunction);
+	if (Parameter >= SynthParameterUnknown)
+	{
+		CLogger::Get ()->Write (FromMiniSynth, LogWarning, "No MIDI CC mapped");
+
+		return;
+	}
+
+	unsigned nValue = pPatch->GetParameter (Parameter);
+
+	// the former path: recompile the whole patch and apply it to all voices,
+	// two snapshots are used alternately, so that they are really re-applied
+	static CPatchSnapshot Snapshot[2];
+
+	unsigned nTicks = CTimer::GetClockTicks ();
+	for (unsigned i = 0; i < Count; i++)
+	{
+		GlobalLock ();
+
+		pPatch->SetMIDIParameter (Parameter, i & 0x7F);
+		Snapshot[i & 1].Compile (pPatch);
+		m_VoiceManager.SetPatch (&Snapshot[i & 1]);
+		m_VoiceManager.BeginChunk ();
+
+		GlobalUnlock ();
+	}
+	unsigned nFullTicks = CTimer::GetClockTicks () - nTicks;
+
+	GlobalLock ();
+
+	m_VoiceManager.SetPatch (pPatch->GetSnapshot ());
+	m_VoiceManager.BeginChunk ();
+
 	GlobalUnlock ();
+
+	// the incremental path, each CC applied on its own (without coalescing)
+	nTicks = CTimer::GetClockTicks ();
+	for (unsigned i = 0; i < Count; i++)
+	{
+		ControlChange (ucFunction, i & 0x7F);
+
+		GlobalLock ();
+		ApplyParameterChanges ();
+		GlobalUnlock ();
+	}
+	unsigned nUpdateTicks = CTimer::GetClockTicks () - nTicks;
+
+	pPatch->SetParameter (Parameter, nValue);
+
+	CLogger::Get ()->Write (FromMiniSynth, LogNotice,
+				"%u CCs on %s: full %u us, incremental %u us",
+				Count, CPatch::GetParameterName (Parameter),
+				nFullTicks / (CLOCKHZ / 1000000), nUpdateTicks / (CLOCKHZ / 1000000));
+}
+
+#endif
+
+#ifdef NOTE_TIMING_TEST
+
+void CMiniSynthesizer::RunNoteTimingTest (void)
+{
+	static const unsigned Notes = 16;
+	static const unsigned Frames = 1024;			// chunk size of the I2S device
+	const unsigned ChunkTicks = (u64) Frames * CLOCKHZ / CSampleRate::Get ();
+	static const unsigned NoteOffChunk = 4;
+	const unsigned MaxChunks = 2 * CSampleRate::Get () / Frames;
+	static const float OnsetLevel = 0.00001f;	// output is silent before
+
+	// The notes are received at different times within a chunk period on a virtual
+	// clock. The chunks are rendered offline, like GetChunk() would do it, and the
+	// onset of each note is detected in the output. The delay between the receive
+	// time and the onset should be the same for all notes.
+	int nMinDelay = 0x7FFFFFFF;
+	int nMaxDelay = -nMinDelay;
+	unsigned nOnsets = 0;
+
+	unsigned nChunk = 0;
+	for (unsigned nNote = 0; nNote < Notes; nNote++)
+	{
+		unsigned nPhaseTicks = nNote * 7919 % ChunkTicks;
+		unsigned nPhase = (u64) nPhaseTicks * CSampleRate::Get () / CLOCKHZ;
+		int nExpectedFrame = nChunk * Frames + nPhase;
+
+		GlobalLock ();
+		QueueEvent (60, 100, 0, nChunk * ChunkTicks + nPhaseTicks);
+		GlobalUnlock ();
+
+		boolean bOnset = FALSE;
+		int nNoteDelay = 0;
+		for (unsigned i = 0; i < MaxChunks; i++, nChunk++)
+		{
+			GlobalLock ();
+
+			if (i == NoteOffChunk)
+			{
+				QueueEvent (60, 0, 0, nChunk * ChunkTicks);
+			}
+
+			m_VoiceManager.BeginChunk ();
+			BeginEvents (Frames, (nChunk+1) * ChunkTicks);
+
+			for (unsigned nFrame = 0; nFrame < Frames; nFrame++)
+			{
+				ProcessEvents (nFrame);
+				m_VoiceManager.NextSample ();
+
+				float fLevel = m_VoiceManager.GetOutputLevelLeft ();
+				if (   !bOnset
+				    && (fLevel > OnsetLevel || fLevel < -OnsetLevel))
+				{
+					int nDelay = nChunk * Frames + nFrame - nExpectedFrame;
+					nNoteDelay = nDelay;
+					if (nDelay < nMinDelay)
+					{
+						nMinDelay = nDelay;
+					}
+					if (nDelay > nMaxDelay)
+					{
+						nMaxDelay = nDelay;
+					}
+
+					nOnsets++;
+					bOnset = TRUE;
+				}
+			}
+
+			GlobalUnlock ();
+
+			if (   i > NoteOffChunk
+			    && m_VoiceManager.IsSilent ())
+			{
+				nChunk++;
+
+				break;
+			}
+		}
+
+		if (bOnset)
+		{
+			CLogger::Get ()->Write (FromMiniSynth, LogNotice,
+						"Note %u received at frame %u, onset delay %d samples",
+						nNote, nPhase, nNoteDelay);
+		}
+	}
+
+	if (nOnsets < Notes)
+	{
+		CLogger::Get ()->Write (FromMiniSynth, LogWarning,
+					"Note timing: only %u of %u onsets detected", nOnsets, Notes);
+
+		return;
+	}
+
+	CLogger::Get ()->Write (FromMiniSynth, LogNotice,
+				"Note timing: jitter %d samples, onset delay %d-%d samples",
+				nMaxDelay - nMinDelay, nMinDelay, nMaxDelay);
 }
 
+#endif
+
+#if defined (FIXED_POINT_TEST) && defined (FIXED_POINT_DSP)
+
+void CMiniSynthesizer::RunFixedPointTest (void)
+{
+	static const u8 Keys[] = {36, 60, 84, 108};
+	const unsigned Samples = CSampleRate::Get ();		// per key
+	const unsigned NoteOffSample = Samples / 2;
+
+	// The active patch is played on a float and a fixed-point voice with the same
+	// keys. The output of the float voice is the golden reference. The maximum
+	// error and the signal-to-noise ratio of the fixed-point voice are logged.
+	assert (m_pConfig != 0);
+	const CPatchSnapshot *pSnapshot = m_pConfig->GetActivePatch ()->GetSnapshot ();
+	assert (pSnapshot != 0);
+
+	for (unsigned i = 0; i < sizeof Keys / sizeof Keys[0]; i++)
+	{
+		CVoiceT<float> *pFloatVoice = new CVoiceT<float>;
+		CVoiceT<TQ15> *pFixedVoice = new CVoiceT<TQ15>;
+		assert (pFloatVoice != 0);
+		assert (pFixedVoice != 0);
+
+		pFloatVoice->SetPatch (pSnapshot);
+		pFixedVoice->SetPatch (pSnapshot);
+
+		pFloatVoice->NoteOn (Keys[i], VELOCITY_DEFAULT);
+		pFixedVoice->NoteOn (Keys[i], VELOCITY_DEFAULT);
+
+		float fMaxError = 0.0f;
+		float fSignal = 0.0f;
+		float fNoise = 0.0f;
+		for (unsigned nSample = 0; nSample < Samples; nSample++)
+		{
+			if (nSample == NoteOffSample)
+			{
+				pFloatVoice->NoteOff ();
+				pFixedVoice->NoteOff ();
+			}
+
+			pFloatVoice->NextSample ();
+			pFixedVoice->NextSample ();
+
+			float fLevel = pFloatVoice->GetOutputLevel ();
+			float fError = pFixedVoice->GetOutputLevel () - fLevel;
+
+			if (fError > fMaxError)
+			{
+				fMaxError = fError;
+			}
+			else if (-fError > fMaxError)
+			{
+				fMaxError = -fError;
+			}
+
+			fSignal += fLevel * fLevel;
+			fNoise += fError * fError;
+		}
+
+		delete pFixedVoice;
+		delete pFloatVoice;
+
+		float fSNR = fNoise > 0.0f ? 10.0f * log10f (fSignal / fNoise) : 999.0f;
+
+		CLogger::Get ()->Write (FromMiniSynth, LogNotice,
+					"Fixed point: key %u, max error %.5f, SNR %.1f dB",
+					(unsigned) Keys[i], (double) fMaxError, (double) fSNR);
+	}
+}
+
+#endif
+
+#if defined (SAMPLE_RATE_BENCHMARK) || defined (VOICES_CALIBRATED)
+
+static const unsigned RenderBudgetPercent = 80;		// of the sample period
+
+void CMiniSynthesizer::MeasureRenderTicks (unsigned nSamples, unsigned *pVoiceTicks,
+					   unsigned *pReverbTicks)
+{
+	static CPatchSnapshot Snapshot;
+
+	assert (m_pConfig != 0);
+	CPatch *pPatch = m_pConfig->GetActivePatch ();
+	assert (pPatch != 0);
+
+	Snapshot.Compile (pPatch);
+
+	CVoice *pVoice = new CVoice;
+	assert (pVoice != 0);
+	pVoice->SetPatch (&Snapshot);
+	pVoice->NoteOn (60, VELOCITY_DEFAULT);
+
+	CReverbModule *pReverb = new CReverbModule;
+	assert (pReverb != 0);
+	pReverb->SetParameters (&Snapshot.Reverb);
+
+	unsigned nStartTicks = CTimer::GetClockTicks ();
+	for (unsigned nSample = 0; nSample < nSamples; nSample++)
+	{
+		pVoice->NextSample ();
+	}
+	unsigned nVoiceTicks = CTimer::GetClockTicks () - nStartTicks;
+
+	nStartTicks = CTimer::GetClockTicks ();
+	for (unsigned nSample = 0; nSample < nSamples; nSample++)
+	{
+		pReverb->NextSample (nSample & 64 ? 0.5f : -0.5f);
+	}
+	unsigned nReverbTicks = CTimer::GetClockTicks () - nStartTicks;
+
+	delete pReverb;
+	delete pVoice;
+
+	assert (pVoiceTicks != 0);
+	*pVoiceTicks = nVoiceTicks > 0 ? nVoiceTicks : 1;
+
+	assert (pReverbTicks != 0);
+	*pReverbTicks = nReverbTicks;
+}
+
+#endif
+
+#ifdef SAMPLE_RATE_BENCHMARK
+
+void CMiniSynthesizer::RunSampleRateBenchmark (void)
+{
+	static const unsigned SampleRates[] = {32000, 44100, 48000, 96000};
+
+	// One voice with the active patch and the reverb are rendered for 250 ms at
+	// each sample rate. The render time is compared with the sample period to get
+	// the number of voices, which would fit on core 0 (with reverb) and on the
+	// other cores. The configured sample rate is restored afterwards.
+	unsigned nSampleRate = CSampleRate::Get ();
+
+	for (unsigned i = 0; i < sizeof SampleRates / sizeof SampleRates[0]; i++)
+	{
+		CSampleRate::Set (SampleRates[i]);
+		CFilterT<TVoiceSample>::UpdateTables ();
+		COscillatorT<TVoiceSample>::UpdateTables ();
+
+		unsigned nSamples = SampleRates[i] / 4;
+
+		unsigned nVoiceTicks, nReverbTicks;
+		MeasureRenderTicks (nSamples, &nVoiceTicks, &nReverbTicks);
+
+		unsigned nBudgetTicks = CLOCKHZ / 4 * RenderBudgetPercent / 100;
+
+		unsigned nVoicesCore0 =   nBudgetTicks > nReverbTicks
+					? (nBudgetTicks - nReverbTicks) / nVoiceTicks : 0;
+
+		CLogger::Get ()->Write (FromMiniSynth, LogNotice,
+					"Sample rate %u: voice %u ns, reverb %u ns per sample, "
+					"max. %u voices on core 0, %u on other cores",
+					SampleRates[i],
+					(unsigned) ((u64) nVoiceTicks * 1000000000 / CLOCKHZ / nSamples),
+					(unsigned) ((u64) nReverbTicks * 1000000000 / CLOCKHZ / nSamples),
+					nVoicesCore0, nBudgetTicks / nVoiceTicks);
+	}
+
+	CSampleRate::Set (nSampleRate);
+	CFilterT<TVoiceSample>::UpdateTables ();
+	COscillatorT<TVoiceSample>::UpdateTables ();
+
+	CLogger::Get ()->Write (FromMiniSynth, LogNotice,
+				"Sample rate is %u Hz, %u voices per core are configured",
+				nSampleRate, VOICES_PER_CORE);
+}
+
+#endif
+
+#ifdef VOICES_CALIBRATED
+
+void CMiniSynthesizer::CalibrateVoices (void)
+{
+	// The voices are limited to the number, which can be rendered together with the
+	// reverb in RenderBudgetPercent of the sample period on this model and at this
+	// sample rate. One voice with the active patch is measured for 100 ms.
+	unsigned nVoiceTicks, nReverbTicks;
+	MeasureRenderTicks (CSampleRate::Get () / 10, &nVoiceTicks, &nReverbTicks);
+
+	unsigned nBudgetTicks = CLOCKHZ / 10 * RenderBudgetPercent / 100;
+	unsigned nVoices =   nBudgetTicks > nReverbTicks
+			   ? (nBudgetTicks - nReverbTicks) / nVoiceTicks : 0;
+	if (nVoices < 1)
+	{
+		nVoices = 1;
+	}
+	else if (nVoices > VOICES)
+	{
+		nVoices = VOICES;
+	}
+
+	m_VoiceManager.SetVoiceLimit (nVoices);
+
+	CLogger::Get ()->Write (FromMiniSynth, LogNotice,
+				"%u of %u voices usable (voice %u us, reverb %u us per 100 ms)",
+				nVoices, VOICES, nVoiceTicks * (1000000 / CLOCKHZ),
+				nReverbTicks * (1000000 / CLOCKHZ));
+}
+
+#endif
+
 #ifdef SHOW_STATUS
 
 const char *CMiniSynthesizer::GetStatus (void)
 {
-	m_Status.Format ("%u ms", m_nMaxDelayTicks * 1000 / CLOCKHZ);
+	m_Status.Format ("%u us (%u%%) max, %u underruns, %u voices peak, "
+			 "serial %u frames %u errors %u parity",
+			 m_Statistics.GetMaxRenderTicks (0) * (1000000 / CLOCKHZ),
+			 m_Statistics.GetMaxRenderPercent (0),
+			 m_Statistics.GetUnderrunCount (),
+			 m_Statistics.GetPeakVoices (),
+			 m_SerialController.GetFrameCount (),
+			 m_SerialController.GetErrorCount (),
+			 m_SerialController.GetParityErrorCount ());
 
 	return m_Status;
 }
 
+void CMiniSynthesizer::GetStatistics (CRenderStatistics *pStatistics, boolean bReset)
+{
+	assert (pStatistics != 0);
+
+	GlobalLock ();
+
+	*pStatistics = m_Statistics;
+
+	if (bReset)
+	{
+		m_Statistics.Reset ();
+	}
+
+	GlobalUnlock ();
+}
+
+void CMiniSynthesizer::UpdateStatistics (unsigned nStartTicks, unsigned nFrames)
+{
+	unsigned nDeadlineTicks = (u64) nFrames * CLOCKHZ / CSampleRate::Get ();
+
+	m_Statistics.AddRenderTime (0, CTimer::GetClockTicks () - nStartTicks, nDeadlineTicks);
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	for (unsigned nCore = 1; nCore < CORES; nCore++)
+	{
+		m_Statistics.AddRenderTime (nCore, m_VoiceManager.GetBusyTicks (nCore),
+					    nDeadlineTicks);
+	}
+#endif
+
+	m_Statistics.AddActiveVoices (m_VoiceManager.GetActiveVoices ());
+
+	unsigned nVoiceSteals = m_VoiceManager.GetVoiceSteals ();
+	m_Statistics.AddVoiceSteals (nVoiceSteals - m_nLastVoiceSteals);
+	m_nLastVoiceSteals = nVoiceSteals;
+}
+
+void CMiniSynthesizer::GetLatencyStatistics (CLatencyStatistics *pStatistics, boolean bReset)
+{
+	assert (pStatistics != 0);
+
+	GlobalLock ();
+
+	*pStatistics = m_LatencyStatistics;
+
+	if (bReset)
+	{
+		m_LatencyStatistics.Reset ();
+	}
+
+	GlobalUnlock ();
+}
+
+void CMiniSynthesizer::CheckLatency (unsigned nFrame)
+{
+	for (u32 nVoices = m_nLatencyVoices; nVoices != 0; nVoices &= nVoices-1)
+	{
+		unsigned nVoice = __builtin_ctz (nVoices);
+
+		if (m_VoiceManager.GetVoiceState (nVoice) == VoiceStateIdle)
+		{
+			m_nLatencyVoices &= ~(1U << nVoice);	// has been silent all the time
+
+			continue;
+		}
+
+		if (m_VoiceManager.GetVoiceOutputLevel (nVoice) == 0.0f)
+		{
+			continue;
+		}
+
+		// the chunk is played, when DMA has finished the previous chunk
+		int nWaitTicks = (int) (m_nChunkTicks - m_nLatencyTicks[nVoice]);
+		unsigned nMicros =   (nWaitTicks > 0 ? nWaitTicks : 0) * (1000000 / CLOCKHZ)
+				   + (u64) (m_nChunkFrames + nFrame) * 1000000 / CSampleRate::Get ();
+
+		m_LatencyStatistics.AddLatency ((TNoteSource) m_ucLatencySource[nVoice], nMicros);
+
+		m_nLatencyVoices &= ~(1U << nVoice);
+	}
+}
+
+#endif
+
+unsigned CMiniSynthesizer::PlayNoteOn (u8 ucKeyNumber, u8 ucVelocity, unsigned nPart)
+{
+	assert (ucKeyNumber <= 127);
+	assert (nPart < PARTS);
+
+	TRACE (TraceNoteOn, nPart, ucKeyNumber | ucVelocity << 8);
+
+	// zones are selected with the played velocity, looked up in a table
+	assert (m_pConfig != 0);
+	u8 ucZones = nPart == 0 ? m_pConfig->GetKeyZones (ucKeyNumber, ucVelocity) : 0;
+
+	// apply velocity curve
+	ucVelocity = m_pConfig->MapVelocity (ucVelocity);
+
+	if (nPart == 0)
+	{
+		// a repeated key may select other zones than before, release the others
+		u8 ucPrevZones = m_ucKeyZones[ucKeyNumber];
+		if (ucPrevZones != 0)
+		{
+			ZonesNoteOff (ucKeyNumber, ucPrevZones & ~ucZones);
+		}
+		else if (ucZones != 0)
+		{
+			m_VoiceManager.NoteOff (ucKeyNumber, 0);
+		}
+
+		m_ucKeyZones[ucKeyNumber] = ucZones;
+	}
+
+	unsigned nVoice = VOICES;			// the first started voice
+
+	if (ucZones == 0)
+	{
+		nVoice = m_VoiceManager.NoteOn (ucKeyNumber, ucVelocity, nPart);
+	}
+
+	for (; ucZones != 0; ucZones &= ucZones-1)	// layered zones get a voice each
+	{
+		unsigned nZone = __builtin_ctz (ucZones);
+
+		int nKeyNumber = ucKeyNumber + m_pConfig->GetZoneTranspose (nZone);
+		if (0 <= nKeyNumber && nKeyNumber <= 127)
+		{
+			unsigned nZoneVoice = m_VoiceManager.NoteOn ((u8) nKeyNumber, ucVelocity,
+								     ZONE_PART (nZone));
+			if (nVoice >= VOICES)
+			{
+				nVoice = nZoneVoice;
+			}
+		}
+	}
+
+	return nVoice;
+}
+
+void CMiniSynthesizer::PlayNoteOff (u8 ucKeyNumber, unsigned nPart)
+{
+	assert (ucKeyNumber <= 127);
+	assert (nPart < PARTS);
+
+	TRACE (TraceNoteOff, nPart, ucKeyNumber);
+
+	if (   nPart == 0
+	    && m_ucKeyZones[ucKeyNumber] != 0)
+	{
+		ZonesNoteOff (ucKeyNumber, m_ucKeyZones[ucKeyNumber]);
+		m_ucKeyZones[ucKeyNumber] = 0;
+	}
+	else
+	{
+		m_VoiceManager.NoteOff (ucKeyNumber, nPart);
+	}
+}
+
+void CMiniSynthesizer::ZonesNoteOff (u8 ucKeyNumber, u8 ucZones)
+{
+	assert (m_pConfig != 0);
+
+	for (; ucZones != 0; ucZones &= ucZones-1)
+	{
+		unsigned nZone = __builtin_ctz (ucZones);
+
+		int nKeyNumber = ucKeyNumber + m_pConfig->GetZoneTranspose (nZone);
+		if (0 <= nKeyNumber && nKeyNumber <= 127)
+		{
+			m_VoiceManager.NoteOff ((u8) nKeyNumber, ZONE_PART (nZone));
+		}
+	}
+}
+
+void CMiniSynthesizer::ApplyParameterChanges (void)
+{
+	if (m_usPendingParts == 0)
+	{
+		return;
+	}
+
+	assert (m_pConfig != 0);
+
+	for (unsigned nParts = m_usPendingParts; nParts != 0; nParts &= nParts-1)
+	{
+		unsigned nPart = __builtin_ctz (nParts);
+
+		CPatch *pPatch = m_pConfig->GetPartPatch (nPart);
+		assert (pPatch != 0);
+
+		for (u32 nMask = m_nPendingMask[nPart]; nMask != 0; nMask &= nMask-1)
+		{
+			TSynthParameter Parameter = (TSynthParameter) __builtin_ctz (nMask);
+
+			// only updates the values depending on this parameter in the snapshot
+			pPatch->SetParameterRamped (Parameter, m_nPendingValue[nPart][Parameter]);
+		}
+
+		m_nPendingMask[nPart] = 0;
+	}
+
+	if (m_usPendingParts & 1)
+	{
+		m_nConfigRevisionWrite++;		// the active patch has been modified
+	}
+
+	m_usPendingParts = 0;
+}
+
+void CMiniSynthesizer::BeginEvents (unsigned nFrames, unsigned nTicks)
+{
+	assert (nFrames > 0);
+
+	m_nNextEventFrame = (unsigned) -1;
+
+#ifdef SHOW_STATUS
+	m_nChunkTicks = nTicks;
+	m_nChunkFrames = nFrames;
+#endif
+
+	for (unsigned i = m_nEventOut; i != m_nEventIn; i = (i+1) % EventQueueSize)
+	{
+		TNoteEvent *pEvent = &m_EventQueue[i];
+
+		// events of the last chunk period are played in this chunk, older at once
+		unsigned nAgeFrames = (u64) (nTicks - pEvent->nTicks) * CSampleRate::Get () / CLOCKHZ;
+		if (nAgeFrames >= nFrames)
+		{
+			pEvent->nFrame = 0;
+		}
+		else if (nAgeFrames == 0)
+		{
+			pEvent->nFrame = nFrames-1;
+		}
+		else
+		{
+			pEvent->nFrame = nFrames - nAgeFrames;
+		}
+	}
+
+	if (m_nEventOut != m_nEventIn)
+	{
+		m_nNextEventFrame = m_EventQueue[m_nEventOut].nFrame;
+	}
+}
+
+boolean CMiniSynthesizer::HasEvents (void) const
+{
+	return m_nEventOut != m_nEventIn;
+}
+
+void CMiniSynthesizer::QueueEvent (u8 ucKeyNumber, u8 ucVelocity, unsigned nPart,
+				   unsigned nTicks, TNoteSource Source)
+{
+	unsigned nNextIn = (m_nEventIn+1) % EventQueueSize;
+	if (nNextIn == m_nEventOut)
+	{
+		// Queue full, we are in IRQ context and must not play the event here. A note
+		// on is dropped. A note off replaces the latest queued note on (of the same
+		// key, if there is one), which is dropped instead, so that no key hangs.
+		if (ucVelocity > 0)
+		{
+			return;
+		}
+
+		unsigned nReplace = EventQueueSize;
+		for (unsigned i = m_nEventOut; i != m_nEventIn; i = (i+1) % EventQueueSize)
+		{
+			const TNoteEvent *pEvent = &m_EventQueue[i];
+			if (pEvent->ucVelocity == 0)
+			{
+				continue;
+			}
+
+			if (   pEvent->ucKeyNumber == ucKeyNumber
+			    && pEvent->ucPart == nPart)
+			{
+				nReplace = i;
+			}
+			else if (   nReplace >= EventQueueSize
+				 || m_EventQueue[nReplace].ucKeyNumber != ucKeyNumber
+				 || m_EventQueue[nReplace].ucPart != nPart)
+			{
+				nReplace = i;
+			}
+		}
+
+		if (nReplace >= EventQueueSize)		// only note offs queued
+		{
+			return;
+		}
+
+		// keeps the timestamp, so that the queue stays ordered
+		TNoteEvent *pEvent = &m_EventQueue[nReplace];
+		pEvent->ucKeyNumber = ucKeyNumber;
+		pEvent->ucVelocity = 0;
+		pEvent->ucPart = (u8) nPart;
+		pEvent->ucSource = (u8) Source;
+
+		return;
+	}
+
+	TNoteEvent *pEvent = &m_EventQueue[m_nEventIn];
+	pEvent->nTicks = nTicks;
+	pEvent->ucKeyNumber = ucKeyNumber;
+	pEvent->ucVelocity = ucVelocity;
+	pEvent->ucPart = (u8) nPart;
+	pEvent->ucSource = (u8) Source;
+
+	m_nEventIn = nNextIn;
+}
+
+void CMiniSynthesizer::PlayEvents (unsigned nFrame)
+{
+	while (m_nEventOut != m_nEventIn)
+	{
+		unsigned nEventFrame = m_EventQueue[m_nEventOut].nFrame;
+		if (nEventFrame > nFrame)
+		{
+			m_nNextEventFrame = nEventFrame;
+
+			return;
+		}
+
+		PlayEvent (m_nEventOut);
+		m_nEventOut = (m_nEventOut+1) % EventQueueSize;
+	}
+
+	m_nNextEventFrame = (unsigned) -1;
+}
+
+void CMiniSynthesizer::PlayEvent (unsigned nEvent)
+{
+	assert (nEvent < EventQueueSize);
+	const TNoteEvent *pEvent = &m_EventQueue[nEvent];
+
+	if (pEvent->ucVelocity > 0)
+	{
+#ifdef SHOW_STATUS
+		unsigned nVoice = PlayNoteOn (pEvent->ucKeyNumber, pEvent->ucVelocity,
+					      pEvent->ucPart);
+		if (   nVoice < VOICES
+		    && pEvent->ucSource < NoteSourceUnknown)
+		{
+			m_nLatencyTicks[nVoice] = pEvent->nTicks;
+			m_ucLatencySource[nVoice] = pEvent->ucSource;
+			m_nLatencyVoices |= 1U << nVoice;
+		}
+#else
+		PlayNoteOn (pEvent->ucKeyNumber, pEvent->ucVelocity, pEvent->ucPart);
 #endif
+	}
+	else
+	{
+		PlayNoteOff (pEvent->ucKeyNumber, pEvent->ucPart);
+	}
+}
 
 void CMiniSynthesizer::GlobalLock (void)
 {
@@ -190,7 +1013,7 @@ void CMiniSynthesizer::GlobalUnlock (void)
 CMiniSynthesizerPWM::CMiniSynthesizerPWM (CSynthConfig *pConfig,
 					  CInterruptSystem *pInterrupt)
 :	CMiniSynthesizer (pConfig, pInterrupt),
-	CPWMSoundBaseDevice (pInterrupt, SAMPLE_RATE),
+	CPWMSoundBaseDevice (pInterrupt, CSampleRate::Get ()),
 	m_nMaxLevel (GetRangeMax ()-1),
 	m_nNullLevel (m_nMaxLevel / 2),
 	m_bChannelsSwapped (AreChannelsSwapped ())
@@ -215,13 +1038,43 @@ unsigned CMiniSynthesizerPWM::GetChunk (u32 *pBuffer, unsigned nChunkSize)
 
 	GlobalLock ();
 
+	TRACE (TraceChunkStart, 0, nChunkSize);
+
 	unsigned nResult = nChunkSize;
 
-	float fVolumeLevel = m_fVolume * m_nMaxLevel/2;
+	ApplyParameterChanges ();
+	m_VoiceManager.BeginChunk ();		// apply a new patch snapshot
+	BeginEvents (nChunkSize / 2, CTimer::GetClockTicks ());
+
+	if (   !HasEvents ()			// fast path, if nothing is playing
+	    && m_VoiceManager.IsSilent ())
+	{
+		for (unsigned i = 0; i < nChunkSize; i++)
+		{
+			pBuffer[i] = m_nNullLevel;
+		}
+
+#ifdef SHOW_STATUS
+		UpdateStatistics (nTicks, nResult / 2);
+#endif
+
+		TRACE (TraceChunkEnd, 1, 0);
+
+		GlobalUnlock ();
+
+		return nResult;
+	}
+
+	// the volume of the parts has been applied by the voice manager
+	float fVolumeLevel = m_nMaxLevel/2.0f;
 
-	for (; nChunkSize > 0; nChunkSize -= 2)		// fill the whole buffer
+	for (unsigned nFrame = 0; nChunkSize > 0; nChunkSize -= 2, nFrame++)
 	{
+		ProcessEvents (nFrame);			// split the chunk at note events
 		m_VoiceManager.NextSample ();
+#ifdef SHOW_STATUS
+		MeasureLatency (nFrame);
+#endif
 
 		float fLevelLeft = m_VoiceManager.GetOutputLevelLeft ();
 		int nLevelLeft = (int) (fLevelLeft*fVolumeLevel + m_nNullLevel);
@@ -259,13 +1112,11 @@ unsigned CMiniSynthesizerPWM::GetChunk (u32 *pBuffer, unsigned nChunkSize)
 	}
 
 #ifdef SHOW_STATUS
-	nTicks = CTimer::GetClockTicks () - nTicks;
-	if (nTicks > m_nMaxDelayTicks)
-	{
-		m_nMaxDelayTicks = nTicks;
-	}
+	UpdateStatistics (nTicks, nResult / 2);
 #endif
 
+	TRACE (TraceChunkEnd, 0, 0);
+
 	GlobalUnlock ();
 
 	return nResult;
@@ -277,7 +1128,7 @@ CMiniSynthesizerI2S::CMiniSynthesizerI2S (CSynthConfig *pConfig,
 					  CInterruptSystem *pInterrupt,
 					  CI2CMaster *pI2CMaster)
 :	CMiniSynthesizer (pConfig, pInterrupt),
-	CI2SSoundBaseDevice (pInterrupt, SAMPLE_RATE, 2048, FALSE, pI2CMaster, DAC_I2C_ADDRESS),
+	CI2SSoundBaseDevice (pInterrupt, CSampleRate::Get (), 2048, FALSE, pI2CMaster, DAC_I2C_ADDRESS),
 	m_nMinLevel (GetRangeMin ()+1),
 	m_nMaxLevel (GetRangeMax ()-1),
 	m_bChannelsSwapped (AreChannelsSwapped ())
@@ -302,13 +1153,40 @@ unsigned CMiniSynthesizerI2S::GetChunk (u32 *pBuffer, unsigned nChunkSize)
 
 	GlobalLock ();
 
+	TRACE (TraceChunkStart, 0, nChunkSize);
+
 	unsigned nResult = nChunkSize;
 
-	float fVolumeLevel = m_fVolume * m_nMaxLevel;
+	ApplyParameterChanges ();
+	m_VoiceManager.BeginChunk ();		// apply a new patch snapshot
+	BeginEvents (nChunkSize / 2, CTimer::GetClockTicks ());
 
-	for (; nChunkSize > 0; nChunkSize -= 2)		// fill the whole buffer
+	if (   !HasEvents ()			// fast path, if nothing is playing
+	    && m_VoiceManager.IsSilent ())
 	{
+		memset (pBuffer, 0, nChunkSize * sizeof (u32));
+
+#ifdef SHOW_STATUS
+		UpdateStatistics (nTicks, nResult / 2);
+#endif
+
+		TRACE (TraceChunkEnd, 1, 0);
+
+		GlobalUnlock ();
+
+		return nResult;
+	}
+
+	// the volume of the parts has been applied by the voice manager
+	float fVolumeLevel = (float) m_nMaxLevel;
+
+	for (unsigned nFrame = 0; nChunkSize > 0; nChunkSize -= 2, nFrame++)
+	{
+		ProcessEvents (nFrame);			// split the chunk at note events
 		m_VoiceManager.NextSample ();
+#ifdef SHOW_STATUS
+		MeasureLatency (nFrame);
+#endif
 
 		float fLevelLeft = m_VoiceManager.GetOutputLevelLeft ();
 		int nLevelLeft = (int) (fLevelLeft*fVolumeLevel);
@@ -346,13 +1224,11 @@ unsigned CMiniSynthesizerI2S::GetChunk (u32 *pBuffer, unsigned nChunkSize)
 	}
 
 #ifdef SHOW_STATUS
-	nTicks = CTimer::GetClockTicks () - nTicks;
-	if (nTicks > m_nMaxDelayTicks)
-	{
-		m_nMaxDelayTicks = nTicks;
-	}
+	UpdateStatistics (nTicks, nResult / 2);
 #endif
 
+	TRACE (TraceChunkEnd, 0, 0);
+
 	GlobalUnlock ();
 
 	return nResult;
@@ -365,7 +1241,7 @@ unsigned CMiniSynthesizerI2S::GetChunk (u32 *pBuffer, unsigned nChunkSize)
 CMiniSynthesizerUSB::CMiniSynthesizerUSB (CSynthConfig *pConfig,
 					  CInterruptSystem *pInterrupt)
 :	CMiniSynthesizer (pConfig, pInterrupt),
-	CUSBSoundBaseDevice (SAMPLE_RATE),
+	CUSBSoundBaseDevice (CSampleRate::Get ()),
 	m_nMinLevel (GetRangeMin ()+1),
 	m_nMaxLevel (GetRangeMax ()-1),
 	m_bChannelsSwapped (AreChannelsSwapped ())
@@ -390,14 +1266,41 @@ unsigned CMiniSynthesizerUSB::GetChunk (s16 *pBuffer, unsigned nChunkSize)
 
 	GlobalLock ();
 
+	TRACE (TraceChunkStart, 0, nChunkSize);
+
 	unsigned nChannels = GetHWTXChannels ();
 	unsigned nResult = nChunkSize;
 
-	float fVolumeLevel = m_fVolume * m_nMaxLevel;
+	ApplyParameterChanges ();
+	m_VoiceManager.BeginChunk ();		// apply a new patch snapshot
+	BeginEvents (nChunkSize / nChannels, CTimer::GetClockTicks ());
 
-	for (; nChunkSize > 0; nChunkSize -= nChannels)		// fill the whole buffer
+	if (   !HasEvents ()			// fast path, if nothing is playing
+	    && m_VoiceManager.IsSilent ())
 	{
+		memset (pBuffer, 0, nChunkSize * sizeof (s16));
+
+#ifdef SHOW_STATUS
+		UpdateStatistics (nTicks, nResult / nChannels);
+#endif
+
+		TRACE (TraceChunkEnd, 1, 0);
+
+		GlobalUnlock ();
+
+		return nResult;
+	}
+
+	// the volume of the parts has been applied by the voice manager
+	float fVolumeLevel = (float) m_nMaxLevel;
+
+	for (unsigned nFrame = 0; nChunkSize > 0; nChunkSize -= nChannels, nFrame++)
+	{
+		ProcessEvents (nFrame);			// split the chunk at note events
 		m_VoiceManager.NextSample ();
+#ifdef SHOW_STATUS
+		MeasureLatency (nFrame);
+#endif
 
 		float fLevelLeft = m_VoiceManager.GetOutputLevelLeft ();
 		int nLevelLeft = (int) (fLevelLeft*fVolumeLevel);
@@ -440,13 +1343,11 @@ unsigned CMiniSynthesizerUSB::GetChunk (s16 *pBuffer, unsigned nChunkSize)
 	}
 
 #ifdef SHOW_STATUS
-	nTicks = CTimer::GetClockTicks () - nTicks;
-	if (nTicks > m_nMaxDelayTicks)
-	{
-		m_nMaxDelayTicks = nTicks;
-	}
+	UpdateStatistics (nTicks, nResult / nChannels);
 #endif
 
+	TRACE (TraceChunkEnd, 0, 0);
+
 	GlobalUnlock ();
 
 	return nResult;
@@ -460,14 +1361,41 @@ unsigned CMiniSynthesizerUSB::GetChunk (u32 *pBuffer, unsigned nChunkSize)
 
 	GlobalLock ();
 
+	TRACE (TraceChunkStart, 0, nChunkSize);
+
 	unsigned nChannels = GetHWTXChannels ();
 	unsigned nResult = nChunkSize;
 
-	float fVolumeLevel = m_fVolume * m_nMaxLevel;
+	ApplyParameterChanges ();
+	m_VoiceManager.BeginChunk ();		// apply a new patch snapshot
+	BeginEvents (nChunkSize / nChannels, CTimer::GetClockTicks ());
+
+	if (   !HasEvents ()			// fast path, if nothing is playing
+	    && m_VoiceManager.IsSilent ())
+	{
+		memset (pBuffer, 0, nChunkSize * 3);	// 24-bit samples
+
+#ifdef SHOW_STATUS
+		UpdateStatistics (nTicks, nResult / nChannels);
+#endif
+
+		TRACE (TraceChunkEnd, 1, 0);
+
+		GlobalUnlock ();
+
+		return nResult;
+	}
 
-	for (; nChunkSize > 0; nChunkSize -= nChannels)		// fill the whole buffer
+	// the volume of the parts has been applied by the voice manager
+	float fVolumeLevel = (float) m_nMaxLevel;
+
+	for (unsigned nFrame = 0; nChunkSize > 0; nChunkSize -= nChannels, nFrame++)
 	{
+		ProcessEvents (nFrame);			// split the chunk at note events
 		m_VoiceManager.NextSample ();
+#ifdef SHOW_STATUS
+		MeasureLatency (nFrame);
+#endif
 
 		float fLevelLeft = m_VoiceManager.GetOutputLevelLeft ();
 		int nLevelLeft = (int) (fLevelLeft*fVolumeLevel);
@@ -515,13 +1443,11 @@ unsigned CMiniSynthesizerUSB::GetChunk (u32 *pBuffer, unsigned nChunkSize)
 	}
 
 #ifdef SHOW_STATUS
-	nTicks = CTimer::GetClockTicks () - nTicks;
-	if (nTicks > m_nMaxDelayTicks)
-	{
-		m_nMaxDelayTicks = nTicks;
-	}
+	UpdateStatistics (nTicks, nResult / nChannels);
 #endif
 
+	TRACE (TraceChunkEnd, 0, 0);
+
 	GlobalUnlock ();
 
 	return nResult;
@@ -33,14 +33,23 @@
 #include "pckeyboard.h"
 #include "serialcontroller.h"
 #include "voicemanager.h"
+#include "renderstatistics.h"
+#include "latencystatistics.h"
 #include "config.h"
 
 // That all runs on core 0. SetPatch() gets called from the GUI and may be
 // interrupted by the other routines. NoteOn/Off() is IRQ-triggered by the USB IRQ
 // handler. GetChunk() is IRQ-triggered by the PWM DMA IRQ handler. IRQ handlers
 // cannot be interrupted again. Thus the execution of these routines (except
-// SetPatch()) is mutual-exclusive. There is no need for explicit synchronization,
-// but setting a single parameter in SetPatch() must be atomic.
+// SetPatch()) is mutual-exclusive. SetPatch() only passes the pointer to the
+// precompiled snapshot of the patch, which is applied at the beginning of the
+// next chunk. Parameters, which are modified in the GUI, are posted to the
+// snapshot and are applied at the beginning of the next chunk too.
+//
+// In multi-timbral mode up to PARTS parts play their own patch on their own MIDI
+// channel. Part 0 is the active patch, which is edited in the GUI. All parts share
+// the same voices and the reverb settings of part 0. Part 0 can be split into
+// keyboard zones, which are played with their own patch like additional parts.
 
 class CMiniSynthesizer
 {
@@ -55,23 +64,104 @@ public:
 
 	void Process (boolean bPlugAndPlayUpdated);
 
-	void SetPatch (CPatch *pPatch);
+	void SetPatch (CPatch *pPatch, unsigned nPart = 0);	// part or ZONE_PART()
 
-	void NoteOn (u8 ucKeyNumber, u8 ucVelocity = VELOCITY_DEFAULT);	// MIDI key number and velocity
-	void NoteOff (u8 ucKeyNumber);
+	// MIDI key number and velocity, part 0 plays the active patch,
+	// the key-to-sound latency is measured for the source device
+	void NoteOn (u8 ucKeyNumber, u8 ucVelocity = VELOCITY_DEFAULT, unsigned nPart = 0,
+		     TNoteSource Source = NoteSourceUnknown);
+	void NoteOff (u8 ucKeyNumber, unsigned nPart = 0);
 
 	boolean ConfigUpdated (void);
-	void ControlChange (u8 ucFunction, u8 ucValue);
-	void ProgramChange (u8 ucProgram);
+	void ControlChange (u8 ucFunction, u8 ucValue, unsigned nPart = 0);
+	void ParameterChange (TSynthParameter Parameter, unsigned nValue, unsigned nPart = 0);
+	// the values are applied together at the beginning of the next chunk
+	void ParameterChanges (const TSynthParameter *pParameter, const unsigned *pValue,
+			       unsigned nCount, unsigned nPart = 0);
+	void ProgramChange (u8 ucProgram, unsigned nPart = 0);
+
+#ifdef CC_STORM_BENCHMARK
+	void RunCCStormBenchmark (void);	// logs the time for 1000 MIDI CCs
+#endif
+
+#ifdef NOTE_TIMING_TEST
+	void RunNoteTimingTest (void);		// must be called before Start()
+#endif
+
+#if defined (FIXED_POINT_TEST) && defined (FIXED_POINT_DSP)
+	void RunFixedPointTest (void);		// must be called before Start()
+#endif
+
+#ifdef SAMPLE_RATE_BENCHMARK
+	void RunSampleRateBenchmark (void);	// must be called before Start()
+#endif
+
+#ifdef VOICES_CALIBRATED
+	void CalibrateVoices (void);		// must be called before Start()
+#endif
 
 #ifdef SHOW_STATUS
 	const char *GetStatus (void);
+
+	// copies the render statistics, which are collected in GetChunk()
+	void GetStatistics (CRenderStatistics *pStatistics, boolean bReset = FALSE);
+	void GetLatencyStatistics (CLatencyStatistics *pStatistics, boolean bReset = FALSE);
 #endif
 
+private:
+	void QueueEvent (u8 ucKeyNumber, u8 ucVelocity, unsigned nPart, unsigned nTicks,
+			 TNoteSource Source = NoteSourceUnknown);
+	void PlayEvents (unsigned nFrame);
+	void PlayEvent (unsigned nEvent);		// index into m_EventQueue[]
+
+#if defined (SAMPLE_RATE_BENCHMARK) || defined (VOICES_CALIBRATED)
+	// renders one voice with the active patch and the reverb for nSamples at the
+	// current sample rate, returns the clock ticks of both
+	void MeasureRenderTicks (unsigned nSamples, unsigned *pVoiceTicks, unsigned *pReverbTicks);
+#endif
+
+	unsigned PlayNoteOn (u8 ucKeyNumber, u8 ucVelocity, unsigned nPart);	// returns voice
+	void PlayNoteOff (u8 ucKeyNumber, unsigned nPart);
+	void ZonesNoteOff (u8 ucKeyNumber, u8 ucZones);
+
 protected:
 	void GlobalLock (void);
 	void GlobalUnlock (void);
 
+	// applies the parameter changes, which have been received since the last chunk
+	void ApplyParameterChanges (void);
+
+	// maps the timestamps of the queued note events to frame offsets in the chunk,
+	// which is requested at nTicks, with a fixed latency of one chunk
+	void BeginEvents (unsigned nFrames, unsigned nTicks);
+	boolean HasEvents (void) const;
+
+	// plays the note events up to this frame, call before each frame of the chunk
+	void ProcessEvents (unsigned nFrame)
+	{
+		if (nFrame >= m_nNextEventFrame)
+		{
+			PlayEvents (nFrame);
+		}
+	}
+
+#ifdef SHOW_STATUS
+	// call at the end of GetChunk(), nStartTicks has been taken on entry
+	void UpdateStatistics (unsigned nStartTicks, unsigned nFrames);
+
+	// checks the started voices for their first non-zero sample, call after each frame
+	void MeasureLatency (unsigned nFrame)
+	{
+		if (m_nLatencyVoices != 0)
+		{
+			CheckLatency (nFrame);
+		}
+	}
+
+private:
+	void CheckLatency (unsigned nFrame);
+#endif
+
 private:
 	CSynthConfig *m_pConfig;
 
@@ -84,14 +174,49 @@ private:
 	unsigned m_nConfigRevisionWrite;
 	unsigned m_nConfigRevisionRead;
 
+	// only the last received value of a parameter is applied per chunk
+	u16 m_usPendingParts;				// bit set for each part with changes
+	u32 m_nPendingMask[PARTS];			// bit set for each changed parameter
+	unsigned m_nPendingValue[PARTS][SynthParameterUnknown];
+
+	// program change to a patch, which has to be loaded in Process() before
+	volatile unsigned m_nPendingProgram[PARTS];	// PATCHES if none
+
+	u8 m_ucKeyZones[128];				// zones, which play a key of part 0
+
+	// Note events are played at the sample offset in the next chunk, which matches
+	// the time they have been received, so that their timing does not depend on
+	// the chunk size. The queue is accessed with GlobalLock() only.
+	struct TNoteEvent
+	{
+		unsigned nTicks;			// CTimer::GetClockTicks() on receive
+		unsigned nFrame;			// offset in the chunk
+		u8 ucKeyNumber;
+		u8 ucVelocity;				// 0 for note off
+		u8 ucPart;
+		u8 ucSource;				// TNoteSource
+	};
+
+	static const unsigned EventQueueSize = 64;
+	TNoteEvent m_EventQueue[EventQueueSize];
+	unsigned m_nEventIn;
+	unsigned m_nEventOut;
+	unsigned m_nNextEventFrame;			// of the next event in this chunk
+
 protected:
 	CVoiceManager m_VoiceManager;
 
-	float m_fVolume;
-
 #ifdef SHOW_STATUS
 	CString m_Status;
-	unsigned m_nMaxDelayTicks;
+	CRenderStatistics m_Statistics;
+	unsigned m_nLastVoiceSteals;			// total count at the last chunk
+
+	CLatencyStatistics m_LatencyStatistics;
+	unsigned m_nChunkTicks;				// of the current chunk
+	unsigned m_nChunkFrames;
+	u32 m_nLatencyVoices;				// bit set for each voice to be measured
+	unsigned m_nLatencyTicks[VOICES];		// arrival of the note on
+	u8 m_ucLatencySource[VOICES];
 #endif
 };
 
@@ -20,28 +20,51 @@
 #include "mixer.h"
 #include <assert.h>
 
-CMixer::CMixer (CSynthModule *pInput1, CSynthModule *pInput2)
+template <typename TSample>
+CMixerT<TSample>::CMixerT (CSynthModuleT<TSample> *pInput1, CSynthModuleT<TSample> *pInput2)
 :	m_pInput1 (pInput1),
 	m_pInput2 (pInput2),
-	m_fOutputLevel (0.0)
+	m_OutputLevel (0)
 {
 }
 
-CMixer::~CMixer (void)
+template <typename TSample>
+CMixerT<TSample>::~CMixerT (void)
 {
 	m_pInput1 = 0;
 	m_pInput2 = 0;
 }
 
-void CMixer::NextSample (void)
+template <>
+void CMixerT<float>::NextSample (void)
 {
 	assert (m_pInput1 != 0);
 	assert (m_pInput2 != 0);
 
-	m_fOutputLevel = (m_pInput1->GetOutputLevel () + m_pInput2->GetOutputLevel ()) / 2.0;
+	m_OutputLevel = (m_pInput1->GetOutputLevel () + m_pInput2->GetOutputLevel ()) / 2.0f;
 }
 
-float CMixer::GetOutputLevel (void) const
+#ifdef FIXED_POINT_DSP
+
+template <>
+void CMixerT<TQ15>::NextSample (void)
 {
-	return m_fOutputLevel;
+	assert (m_pInput1 != 0);
+	assert (m_pInput2 != 0);
+
+	// cannot overflow
+	m_OutputLevel = (m_pInput1->GetOutputLevel () + m_pInput2->GetOutputLevel ()) >> 1;
 }
+
+#endif
+
+template <typename TSample>
+TSample CMixerT<TSample>::GetOutputLevel (void) const
+{
+	return m_OutputLevel;
+}
+
+template class CMixerT<float>;
+#ifdef FIXED_POINT_DSP
+template class CMixerT<TQ15>;
+#endif
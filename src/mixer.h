@@ -22,20 +22,28 @@
 
 #include "synthmodule.h"
 
-class CMixer : public CSynthModule
+template <typename TSample>
+class CMixerT : public CSynthModuleT<TSample>
 {
 public:
-	CMixer (CSynthModule *pInput1, CSynthModule *pInput2);
-	~CMixer (void);
+	CMixerT (CSynthModuleT<TSample> *pInput1, CSynthModuleT<TSample> *pInput2);
+	~CMixerT (void);
 
 	void NextSample (void);
-	float GetOutputLevel (void) const;		// returns [-1.0, 1.0]
+	TSample GetOutputLevel (void) const;		// returns [-1.0, 1.0]
 
 private:
-	CSynthModule *m_pInput1;
-	CSynthModule *m_pInput2;
+	CSynthModuleT<TSample> *m_pInput1;
+	CSynthModuleT<TSample> *m_pInput2;
 
-	float m_fOutputLevel;
+	TSample m_OutputLevel;
 };
 
+template <> void CMixerT<float>::NextSample (void);
+#ifdef FIXED_POINT_DSP
+template <> void CMixerT<TQ15>::NextSample (void);
+#endif
+
+typedef CMixerT<float> CMixer;
+
 #endif
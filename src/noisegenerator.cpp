@@ -0,0 +1,278 @@
+//
+// noisegenerator.cpp
+//
+// MiniSynth Pi - A virtual analogue synthesizer for Raspberry Pi
+// Copyright (C) 2017-2023  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "noisegenerator.h"
+#include "fastmath.h"
+#include <assert.h>
+
+// pink noise filter (P. Kellet), the input gains are scaled by 0.2 for an output
+// level of about -9.3 dB (RMS), so that the peaks rarely have to be saturated
+#define PINK_POLE0		0.99765f
+#define PINK_POLE1		0.96300f
+#define PINK_POLE2		0.57000f
+#define PINK_GAIN0		0.0198092f
+#define PINK_GAIN1		0.0593033f
+#define PINK_GAIN2		0.2105383f
+#define PINK_GAIN_DIRECT	0.03696f
+
+// brown noise: b = b * (1 - 1/256) + w * BROWN_GAIN, about -9.8 dB (RMS)
+#define BROWN_LEAK_SHIFT	8
+#define BROWN_GAIN		0.05f
+
+#define Q15(value)		((s32) ((value) * Q15_ONE + 0.5f))
+
+static unsigned s_nNextStream = 0;		// shared by both sample types
+
+// mixes the bits of the stream and lane number (from MurmurHash3's finalizer)
+static u32 GetSeed (unsigned nStream, unsigned nLane)
+{
+	u32 nSeed = nStream * NOISE_LANES + nLane + 1;
+
+	nSeed ^= nSeed >> 16;
+	nSeed *= 0x85EBCA6BU;
+	nSeed ^= nSeed >> 13;
+	nSeed *= 0xC2B2AE35U;
+	nSeed ^= nSeed >> 16;
+
+	return nSeed != 0 ? nSeed : 0x6D2B79F5U;	// xorshift must not start at 0
+}
+
+static inline u32 XorShift32 (u32 *pState)
+{
+	u32 nState = *pState;
+
+	nState ^= nState << 13;
+	nState ^= nState >> 17;
+	nState ^= nState << 5;
+
+	return *pState = nState;
+}
+
+template <typename TSample>
+CNoiseGeneratorT<TSample>::CNoiseGeneratorT (void)
+:	m_Brown (0)
+{
+	unsigned nStream = s_nNextStream++;
+
+	for (unsigned i = 0; i < NOISE_LANES; i++)
+	{
+		m_nState[i] = GetSeed (nStream, i);
+	}
+
+	for (unsigned i = 0; i < 3; i++)
+	{
+		m_Pink[i] = 0;
+	}
+}
+
+template <typename TSample>
+CNoiseGeneratorT<TSample>::~CNoiseGeneratorT (void)
+{
+}
+
+template <typename TSample>
+void CNoiseGeneratorT<TSample>::Generate (TSample *pBuffer, unsigned nCount, TNoiseColor Color)
+{
+	GenerateWhite (pBuffer, nCount);
+
+	switch (Color)
+	{
+	case NoiseWhite:
+		break;
+
+	case NoisePink:
+		FilterPink (pBuffer, nCount);
+		break;
+
+	case NoiseBrown:
+		FilterBrown (pBuffer, nCount);
+		break;
+
+	default:
+		assert (0);
+		break;
+	}
+}
+
+template <>
+void CNoiseGeneratorT<float>::GenerateWhite (float *pBuffer, unsigned nCount)
+{
+	assert (pBuffer != 0);
+	assert (nCount % NOISE_LANES == 0);
+
+	// (x >> 9) | 0x40000000 is a float in [2.0, 4.0) with x in the mantissa
+#ifdef FAST_MATH_SIMD
+	uint32x4_t State = vld1q_u32 (m_nState);
+	const uint32x4_t Exponent = vdupq_n_u32 (0x40000000);
+	const float32x4_t Three = vdupq_n_f32 (3.0f);
+
+	for (; nCount > 0; nCount -= NOISE_LANES, pBuffer += NOISE_LANES)
+	{
+		State = veorq_u32 (State, vshlq_n_u32 (State, 13));
+		State = veorq_u32 (State, vshrq_n_u32 (State, 17));
+		State = veorq_u32 (State, vshlq_n_u32 (State, 5));
+
+		uint32x4_t Bits = vorrq_u32 (vshrq_n_u32 (State, 9), Exponent);
+		vst1q_f32 (pBuffer, vsubq_f32 (vreinterpretq_f32_u32 (Bits), Three));
+	}
+
+	vst1q_u32 (m_nState, State);
+#else
+	for (; nCount > 0; nCount -= NOISE_LANES)
+	{
+		for (unsigned i = 0; i < NOISE_LANES; i++)
+		{
+			union
+			{
+				u32	nBits;
+				float	fValue;
+			}
+			Value;
+
+			Value.nBits = (XorShift32 (&m_nState[i]) >> 9) | 0x40000000;
+
+			*pBuffer++ = Value.fValue - 3.0f;
+		}
+	}
+#endif
+}
+
+template <>
+void CNoiseGeneratorT<float>::FilterPink (float *pBuffer, unsigned nCount)
+{
+	float b0 = m_Pink[0];
+	float b1 = m_Pink[1];
+	float b2 = m_Pink[2];
+
+	for (unsigned i = 0; i < nCount; i++)
+	{
+		float fWhite = pBuffer[i];
+
+		b0 = PINK_POLE0 * b0 + PINK_GAIN0 * fWhite;
+		b1 = PINK_POLE1 * b1 + PINK_GAIN1 * fWhite;
+		b2 = PINK_POLE2 * b2 + PINK_GAIN2 * fWhite;
+
+		float fPink = b0 + b1 + b2 + PINK_GAIN_DIRECT * fWhite;
+		if (fPink > 1.0f)
+		{
+			fPink = 1.0f;
+		}
+		else if (fPink < -1.0f)
+		{
+			fPink = -1.0f;
+		}
+
+		pBuffer[i] = fPink;
+	}
+
+	m_Pink[0] = b0;
+	m_Pink[1] = b1;
+	m_Pink[2] = b2;
+}
+
+template <>
+void CNoiseGeneratorT<float>::FilterBrown (float *pBuffer, unsigned nCount)
+{
+	float fBrown = m_Brown;
+
+	for (unsigned i = 0; i < nCount; i++)
+	{
+		fBrown -= fBrown * (1.0f / (1 << BROWN_LEAK_SHIFT));
+		fBrown += BROWN_GAIN * pBuffer[i];
+		if (fBrown > 1.0f)
+		{
+			fBrown = 1.0f;
+		}
+		else if (fBrown < -1.0f)
+		{
+			fBrown = -1.0f;
+		}
+
+		pBuffer[i] = fBrown;
+	}
+
+	m_Brown = fBrown;
+}
+
+#ifdef FIXED_POINT_DSP
+
+template <>
+void CNoiseGeneratorT<TQ15>::GenerateWhite (TQ15 *pBuffer, unsigned nCount)
+{
+	assert (pBuffer != 0);
+	assert (nCount % NOISE_LANES == 0);
+
+	// the same numbers as the float implementation
+	for (; nCount > 0; nCount -= NOISE_LANES)
+	{
+		for (unsigned i = 0; i < NOISE_LANES; i++)
+		{
+			*pBuffer++ = (TQ15) (XorShift32 (&m_nState[i]) >> 16) - Q15_ONE;
+		}
+	}
+}
+
+template <>
+void CNoiseGeneratorT<TQ15>::FilterPink (TQ15 *pBuffer, unsigned nCount)
+{
+	// the products are rounded, otherwise the poles near 1.0 build up an offset
+	s32 b0 = m_Pink[0];
+	s32 b1 = m_Pink[1];
+	s32 b2 = m_Pink[2];
+
+	for (unsigned i = 0; i < nCount; i++)
+	{
+		s32 nWhite = pBuffer[i];
+
+		b0 = (Q15 (PINK_POLE0) * b0 + Q15 (PINK_GAIN0) * nWhite + Q15_ONE/2) >> 15;
+		b1 = (Q15 (PINK_POLE1) * b1 + Q15 (PINK_GAIN1) * nWhite + Q15_ONE/2) >> 15;
+		b2 = (Q15 (PINK_POLE2) * b2 + Q15 (PINK_GAIN2) * nWhite + Q15_ONE/2) >> 15;
+
+		pBuffer[i] = Q15Saturate (  b0 + b1 + b2
+					  + ((Q15 (PINK_GAIN_DIRECT) * nWhite + Q15_ONE/2) >> 15));
+	}
+
+	m_Pink[0] = b0;
+	m_Pink[1] = b1;
+	m_Pink[2] = b2;
+}
+
+template <>
+void CNoiseGeneratorT<TQ15>::FilterBrown (TQ15 *pBuffer, unsigned nCount)
+{
+	s32 nBrown = m_Brown;
+
+	for (unsigned i = 0; i < nCount; i++)
+	{
+		nBrown -= (nBrown + (1 << (BROWN_LEAK_SHIFT-1))) >> BROWN_LEAK_SHIFT;
+		nBrown += (Q15 (BROWN_GAIN) * pBuffer[i] + Q15_ONE/2) >> 15;
+		nBrown = Q15Saturate (nBrown);
+
+		pBuffer[i] = nBrown;
+	}
+
+	m_Brown = nBrown;
+}
+
+#endif
+
+template class CNoiseGeneratorT<float>;
+#ifdef FIXED_POINT_DSP
+template class CNoiseGeneratorT<TQ15>;
+#endif
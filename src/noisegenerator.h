@@ -0,0 +1,79 @@
+//
+// noisegenerator.h
+//
+// Block noise generator with independent streams
+//
+// MiniSynth Pi - A virtual analogue synthesizer for Raspberry Pi
+// Copyright (C) 2017-2023  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _noisegenerator_h
+#define _noisegenerator_h
+
+#include "sample.h"
+#include <circle/types.h>
+
+#define NOISE_LANES		4		// interleaved xorshift32 generators
+#define NOISE_BLOCK_SIZE	16		// samples, multiple of NOISE_LANES
+
+enum TNoiseColor
+{
+	NoiseWhite,
+	NoisePink,				// -3 dB per octave
+	NoiseBrown,				// -6 dB per octave (above 30 Hz at 48 kHz)
+	NoiseUnknown
+};
+
+// The generator fills blocks of samples in [-1.0, 1.0) from NOISE_LANES xorshift32
+// generators, which are stepped together (with NEON in one vector) and which
+// deliver the samples 0, 1, 2, 3 of each group of NOISE_LANES. A random number is
+// converted to float by setting the exponent bits, without a multiplication, and
+// to TQ15 by taking the upper 16 bits, so that both sample types get the same
+// noise. Each instance gets its own seeds, so that the voices do not play
+// correlated noise. Pink noise is filtered from white noise with three one-pole
+// filters (P. Kellet's "economy" filter), brown noise with a leaky integrator.
+
+template <typename TSample>
+class CNoiseGeneratorT
+{
+public:
+	CNoiseGeneratorT (void);			// must be constructed on core 0
+	~CNoiseGeneratorT (void);
+
+	// nCount must be a multiple of NOISE_LANES
+	void Generate (TSample *pBuffer, unsigned nCount, TNoiseColor Color);
+
+private:
+	void GenerateWhite (TSample *pBuffer, unsigned nCount);
+	void FilterPink (TSample *pBuffer, unsigned nCount);	// in place
+	void FilterBrown (TSample *pBuffer, unsigned nCount);
+
+private:
+	u32 m_nState[NOISE_LANES];
+
+	TSample m_Pink[3];				// filter states
+	TSample m_Brown;
+};
+
+template <> void CNoiseGeneratorT<float>::GenerateWhite (float *pBuffer, unsigned nCount);
+template <> void CNoiseGeneratorT<float>::FilterPink (float *pBuffer, unsigned nCount);
+template <> void CNoiseGeneratorT<float>::FilterBrown (float *pBuffer, unsigned nCount);
+#ifdef FIXED_POINT_DSP
+template <> void CNoiseGeneratorT<TQ15>::GenerateWhite (TQ15 *pBuffer, unsigned nCount);
+template <> void CNoiseGeneratorT<TQ15>::FilterPink (TQ15 *pBuffer, unsigned nCount);
+template <> void CNoiseGeneratorT<TQ15>::FilterBrown (TQ15 *pBuffer, unsigned nCount);
+#endif
+
+#endif
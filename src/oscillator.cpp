@@ -18,195 +18,409 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include "oscillator.h"
+#include "samplerate.h"
 #include "config.h"
 #include "math.h"
+#include "fastmath.h"
 #include <assert.h>
 
-#define SINE_POINTS	360
-
-float COscillator::s_SineTable[SINE_POINTS] =
-{
-0.00000000, 0.01745241, 0.03489950, 0.05233596, 0.06975647, 0.08715574, 0.10452846, 0.12186934,
-0.13917310, 0.15643447, 0.17364818, 0.19080900, 0.20791169, 0.22495105, 0.24192190, 0.25881905,
-0.27563736, 0.29237170, 0.30901699, 0.32556815, 0.34202014, 0.35836795, 0.37460659, 0.39073113,
-0.40673664, 0.42261826, 0.43837115, 0.45399050, 0.46947156, 0.48480962, 0.50000000, 0.51503807,
-0.52991926, 0.54463904, 0.55919290, 0.57357644, 0.58778525, 0.60181502, 0.61566148, 0.62932039,
-0.64278761, 0.65605903, 0.66913061, 0.68199836, 0.69465837, 0.70710678, 0.71933980, 0.73135370,
-0.74314483, 0.75470958, 0.76604444, 0.77714596, 0.78801075, 0.79863551, 0.80901699, 0.81915204,
-0.82903757, 0.83867057, 0.84804810, 0.85716730, 0.86602540, 0.87461971, 0.88294759, 0.89100652,
-0.89879405, 0.90630779, 0.91354546, 0.92050485, 0.92718385, 0.93358043, 0.93969262, 0.94551858,
-0.95105652, 0.95630476, 0.96126170, 0.96592583, 0.97029573, 0.97437006, 0.97814760, 0.98162718,
-0.98480775, 0.98768834, 0.99026807, 0.99254615, 0.99452190, 0.99619470, 0.99756405, 0.99862953,
-0.99939083, 0.99984770, 1.00000000, 0.99984770, 0.99939083, 0.99862953, 0.99756405, 0.99619470,
-0.99452190, 0.99254615, 0.99026807, 0.98768834, 0.98480775, 0.98162718, 0.97814760, 0.97437006,
-0.97029573, 0.96592583, 0.96126170, 0.95630476, 0.95105652, 0.94551858, 0.93969262, 0.93358043,
-0.92718385, 0.92050485, 0.91354546, 0.90630779, 0.89879405, 0.89100652, 0.88294759, 0.87461971,
-0.86602540, 0.85716730, 0.84804810, 0.83867057, 0.82903757, 0.81915204, 0.80901699, 0.79863551,
-0.78801075, 0.77714596, 0.76604444, 0.75470958, 0.74314483, 0.73135370, 0.71933980, 0.70710678,
-0.69465837, 0.68199836, 0.66913061, 0.65605903, 0.64278761, 0.62932039, 0.61566148, 0.60181502,
-0.58778525, 0.57357644, 0.55919290, 0.54463904, 0.52991926, 0.51503807, 0.50000000, 0.48480962,
-0.46947156, 0.45399050, 0.43837115, 0.42261826, 0.40673664, 0.39073113, 0.37460659, 0.35836795,
-0.34202014, 0.32556815, 0.30901699, 0.29237170, 0.27563736, 0.25881905, 0.24192190, 0.22495105,
-0.20791169, 0.19080900, 0.17364818, 0.15643447, 0.13917310, 0.12186934, 0.10452846, 0.08715574,
-0.06975647, 0.05233596, 0.03489950, 0.01745241, 0.00000000, -0.01745241, -0.03489950, -0.05233596,
--0.06975647, -0.08715574, -0.10452846, -0.12186934, -0.13917310, -0.15643447, -0.17364818, -0.19080900,
--0.20791169, -0.22495105, -0.24192190, -0.25881905, -0.27563736, -0.29237170, -0.30901699, -0.32556815,
--0.34202014, -0.35836795, -0.37460659, -0.39073113, -0.40673664, -0.42261826, -0.43837115, -0.45399050,
--0.46947156, -0.48480962, -0.50000000, -0.51503807, -0.52991926, -0.54463904, -0.55919290, -0.57357644,
--0.58778525, -0.60181502, -0.61566148, -0.62932039, -0.64278761, -0.65605903, -0.66913061, -0.68199836,
--0.69465837, -0.70710678, -0.71933980, -0.73135370, -0.74314483, -0.75470958, -0.76604444, -0.77714596,
--0.78801075, -0.79863551, -0.80901699, -0.81915204, -0.82903757, -0.83867057, -0.84804810, -0.85716730,
--0.86602540, -0.87461971, -0.88294759, -0.89100652, -0.89879405, -0.90630779, -0.91354546, -0.92050485,
--0.92718385, -0.93358043, -0.93969262, -0.94551858, -0.95105652, -0.95630476, -0.96126170, -0.96592583,
--0.97029573, -0.97437006, -0.97814760, -0.98162718, -0.98480775, -0.98768834, -0.99026807, -0.99254615,
--0.99452190, -0.99619470, -0.99756405, -0.99862953, -0.99939083, -0.99984770, -1.00000000, -0.99984770,
--0.99939083, -0.99862953, -0.99756405, -0.99619470, -0.99452190, -0.99254615, -0.99026807, -0.98768834,
--0.98480775, -0.98162718, -0.97814760, -0.97437006, -0.97029573, -0.96592583, -0.96126170, -0.95630476,
--0.95105652, -0.94551858, -0.93969262, -0.93358043, -0.92718385, -0.92050485, -0.91354546, -0.90630779,
--0.89879405, -0.89100652, -0.88294759, -0.87461971, -0.86602540, -0.85716730, -0.84804810, -0.83867057,
--0.82903757, -0.81915204, -0.80901699, -0.79863551, -0.78801075, -0.77714596, -0.76604444, -0.75470958,
--0.74314483, -0.73135370, -0.71933980, -0.70710678, -0.69465837, -0.68199836, -0.66913061, -0.65605903,
--0.64278761, -0.62932039, -0.61566148, -0.60181502, -0.58778525, -0.57357644, -0.55919290, -0.54463904,
--0.52991926, -0.51503807, -0.50000000, -0.48480962, -0.46947156, -0.45399050, -0.43837115, -0.42261826,
--0.40673664, -0.39073113, -0.37460659, -0.35836795, -0.34202014, -0.32556815, -0.30901699, -0.29237170,
--0.27563736, -0.25881905, -0.24192190, -0.22495105, -0.20791169, -0.19080900, -0.17364818, -0.15643447,
--0.13917310, -0.12186934, -0.10452846, -0.08715574, -0.06975647, -0.05233596, -0.03489950, -0.01745241
+#define KEYS			128			// MIDI key numbers
+
+#define SINE_POINTS_LOG2	10
+#define SINE_POINTS		(1 << SINE_POINTS_LOG2)
+#define SINE_SHIFT		(32 - SINE_POINTS_LOG2)	// phase to table index
+
+#define PHASE_RANGE		4294967296.0f		// 2^32, one period
+#define MAX_PHASE_INCREMENT	0x7FFFFF80U		// Nyquist frequency, exact as float
+
+// The tables are calculated by the compiler. The constexpr functions use double
+// precision and are not used at runtime.
+
+// sine with a Taylor series, x must be in [-PI, PI]
+static constexpr double ConstSine (double x)
+{
+	double fSum = 0.0;
+	double fTerm = x;
+	for (unsigned n = 1; n < 40; n += 2)
+	{
+		fSum += fTerm;
+		fTerm *= -x*x / ((n+1) * (n+2));
+	}
+
+	return fSum;
+}
+
+// 2^x == 2^n * e^(f * ln(2)), with n integer and f in [0.0, 1.0)
+static constexpr double ConstExp2 (double x)
+{
+	int n = (int) x;
+	if (n > x)
+	{
+		n--;
+	}
+
+	double y = (x - n) * 0.69314718055994531;
+	double fSum = 1.0;
+	double fTerm = 1.0;
+	for (unsigned i = 1; i < 20; i++)
+	{
+		fTerm *= y / i;
+		fSum += fTerm;
+	}
+
+	for (; n > 0; n--)
+	{
+		fSum *= 2.0;
+	}
+
+	for (; n < 0; n++)
+	{
+		fSum /= 2.0;
+	}
+
+	return fSum;
+}
+
+struct TSineTable
+{
+	float Value[SINE_POINTS];
+#ifdef FIXED_POINT_DSP
+	s16 ValueQ15[SINE_POINTS];
+#endif
+
+	constexpr TSineTable (void)
+	:	Value ()
+#ifdef FIXED_POINT_DSP
+		, ValueQ15 ()
+#endif
+	{
+		for (unsigned i = 0; i < SINE_POINTS; i++)
+		{
+			double x = 2.0*3.14159265358979324 * i / SINE_POINTS;
+			if (x > 3.14159265358979324)
+			{
+				x -= 2.0*3.14159265358979324;
+			}
+
+			double fSine = ConstSine (x);
+
+			Value[i] = (float) fSine;
+#ifdef FIXED_POINT_DSP
+			ValueQ15[i] = (s16) (fSine >= 1.0 ? Q15_MAX : fSine * Q15_ONE);
+#endif
+		}
+	}
+};
+
+static constexpr TSineTable SineTable;
+
+// equal temperament with A4 (MIDI key 69) = 440 Hz
+struct TKeyFrequencyTable
+{
+	float Value[KEYS];
+
+	constexpr TKeyFrequencyTable (void)
+	:	Value ()
+	{
+		for (unsigned i = 0; i < KEYS; i++)
+		{
+			Value[i] = (float) (440.0 * ConstExp2 (((int) i - 69) / 12.0));
+		}
+	}
 };
 
+static constexpr TKeyFrequencyTable KeyFrequency;
+
+static float s_fTunedKeyFrequency[KEYS];
+static const float *s_pKeyFrequency = KeyFrequency.Value;
+
+static u32 s_nKeyIncrement[KEYS];		// phase increments per sample
+static unsigned s_nTableSampleRate = 0;		// table is invalid
 
-// See: http://www.deimos.ca/notefreqs/
-static const float KeyFrequency[/* MIDI key number */] =
-{
-	8.17580, 8.66196, 9.17702, 9.72272, 10.3009, 10.9134, 11.5623, 12.2499, 12.9783, 13.7500,
-	14.5676, 15.4339, 16.3516, 17.3239, 18.3540, 19.4454, 20.6017, 21.8268, 23.1247, 24.4997,
-	25.9565, 27.5000, 29.1352, 30.8677, 32.7032, 34.6478, 36.7081, 38.8909, 41.2034, 43.6535,
-	46.2493, 48.9994, 51.9131, 55.0000, 58.2705, 61.7354, 65.4064, 69.2957, 73.4162, 77.7817,
-	82.4069, 87.3071, 92.4986, 97.9989, 103.826, 110.000, 116.541, 123.471, 130.813, 138.591,
-	146.832, 155.563, 164.814, 174.614, 184.997, 195.998, 207.652, 220.000, 233.082, 246.942,
-	261.626, 277.183, 293.665, 311.127, 329.628, 349.228, 369.994, 391.995, 415.305, 440.000,
-	466.164, 493.883, 523.251, 554.365, 587.330, 622.254, 659.255, 698.456, 739.989, 783.991,
-	830.609, 880.000, 932.328, 987.767, 1046.50, 1108.73, 1174.66, 1244.51, 1318.51, 1396.91,
-	1479.98, 1567.98, 1661.22, 1760.00, 1864.66, 1975.53, 2093.00, 2217.46, 2349.32, 2489.02,
-	2637.02, 2793.83, 2959.96, 3135.96, 3322.44, 3520.00, 3729.31, 3951.07, 4186.01, 4434.92,
-	4698.64, 4978.03, 5274.04, 5587.65, 5919.91, 6271.93, 6644.88, 7040.00, 7458.62, 7902.13,
-	8372.02, 8869.84, 9397.27, 9956.06, 10548.1, 11175.3, 11839.8, 12543.9
+template <typename TSample>
+const TOscillatorParameters COscillatorT<TSample>::s_DefaultParameters =
+{
+	WaveformSine,
+	20.0f,
+	(u32) (20.0f * PHASE_RANGE / SAMPLE_RATE_DEFAULT + 0.5f),	// the LFOs of the voices get
+	1.0f,								// it from the snapshot
+	0.0f,
+	(u32) (20.0f * PHASE_RANGE / SAMPLE_RATE_DEFAULT + 0.5f)
+#ifdef FIXED_POINT_DSP
+	, Q16_ONE,
+	0
+#endif
 };
 
-COscillator::COscillator (CSynthModule *pModulator)
+template <typename TSample>
+COscillatorT<TSample>::COscillatorT (CSynthModuleT<TSample> *pModulator)
 :	m_pModulator (pModulator),
-	m_Waveform (WaveformSine),
-	m_fFrequency (20.0),
-	m_fMidFrequency (m_fFrequency),
-	m_uMIDINote(69),	// Middle A, nice
-	m_fDetune (0.0),
-	m_fOctave(0.0),
-	m_fModulationVolume (0.0),
-	m_nSampleCount (0),
-	m_fOutputLevel (0.0),
-	m_nRandSeed (1)
+	m_pParameters (&s_DefaultParameters),
+	m_nKeyIncrement (0),
+	m_nPhase (0),
+	m_OutputLevel (0),
+	m_nNoiseIndex (NOISE_BLOCK_SIZE)			// block is empty
 {
+	if (s_nTableSampleRate != CSampleRate::Get ())	// the voices are created on core 0 only
+	{
+		UpdateTables ();
+	}
 }
 
-COscillator::~COscillator (void)
+template <typename TSample>
+COscillatorT<TSample>::~COscillatorT (void)
 {
 	m_pModulator = 0;
+	m_pParameters = 0;
 }
 
-void COscillator::SetWaveform (TWaveform Waveform)
+template <typename TSample>
+void COscillatorT<TSample>::SetParameters (const TOscillatorParameters *pParameters)
 {
-	assert (Waveform < WaveformUnknown);
-	m_Waveform = Waveform;
+	assert (pParameters != 0);
+	assert (pParameters->Waveform < WaveformUnknown);
+	m_pParameters = pParameters;
 }
 
-void COscillator::SetFrequency (float fFrequency)
+template <typename TSample>
+void COscillatorT<TSample>::SetMIDINote (unsigned uMIDINote)
 {
-	assert (fFrequency > 0.0);
-	m_fMidFrequency = fFrequency;
-	m_fFrequency = exp2f (log2f (m_fMidFrequency) + m_fDetune + m_fOctave);
+	if (uMIDINote < KEYS)
+	{
+		m_nKeyIncrement = s_nKeyIncrement[uMIDINote];
+	}
 }
 
-void COscillator::SetMIDINote (unsigned uMIDINote)
+template <typename TSample>
+u32 COscillatorT<TSample>::GetPhaseIncrement (float fFrequency)
 {
-	if (uMIDINote < sizeof KeyFrequency / sizeof KeyFrequency[0])
+	assert (fFrequency >= 0.0f);
+	float fIncrement = fFrequency * (PHASE_RANGE / CSampleRate::Get ()) + 0.5f;
+	if (fIncrement > MAX_PHASE_INCREMENT)
 	{
-		assert (0 <= uMIDINote && uMIDINote <= 127);
-		m_uMIDINote = uMIDINote;
-		//Alt1: m_fMidFrequency = KeyFrequency[m_uMIDINote + (m_iOctave * 12)]; TODO: TEST!
-		// m_fFrequency = exp2f (log2f (m_fMidFrequency) + m_fDetune);
-		m_fMidFrequency = KeyFrequency[m_uMIDINote];
-		m_fFrequency = exp2f (log2f (m_fMidFrequency) + m_fDetune + m_fOctave);
+		fIncrement = MAX_PHASE_INCREMENT;
 	}
+
+	return (u32) fIncrement;
 }
 
 // TODO: Maybe change the scaling of the detune (obiettivo: detune di 7 semitoni, fatto!)
-void COscillator::SetDetune (float fDetune)
+template <typename TSample>
+float COscillatorT<TSample>::GetPitchFactor (float fDetune, int iOctave)
 {
-	assert (-1.0 <= fDetune && fDetune <= 1.0);
-	m_fDetune = fDetune / 2.0; 
-	m_fFrequency = exp2f (log2f (m_fMidFrequency) + m_fDetune + m_fOctave);
+	assert (-1.0f <= fDetune && fDetune <= 1.0f);
+	assert (-3 <= iOctave && iOctave <= 2);
+
+	// exp2f (log2f (fFrequency) + fDetune/2 + iOctave) == fFrequency * GetPitchFactor ()
+	return FastExp2 (fDetune / 2.0f + static_cast<float>(iOctave));
 }
 
-// TODO: Aggiungere supporto ottava
-// TODO: non so se lasciare l'ottava come un valore relativo o no
-void COscillator::SetOctave (int iOctave)
+template <typename TSample>
+void COscillatorT<TSample>::SetTuning (const float *pKeyFrequency)
 {
-	assert(-3 <= iOctave && iOctave <= 2);
-	m_fOctave = static_cast<float>(iOctave);
-	m_fFrequency = exp2f (log2f (m_fMidFrequency) + m_fDetune + m_fOctave);
+	assert (pKeyFrequency != 0);
+
+	for (unsigned i = 0; i < KEYS; i++)
+	{
+		assert (pKeyFrequency[i] > 0.0f);
+		s_fTunedKeyFrequency[i] = pKeyFrequency[i];
+	}
+
+	s_pKeyFrequency = s_fTunedKeyFrequency;
+
+	UpdateTables ();
+}
+
+template <typename TSample>
+void COscillatorT<TSample>::UpdateTables (void)
+{
+	s_nTableSampleRate = CSampleRate::Get ();
+
+	assert (s_pKeyFrequency != 0);
+	for (unsigned i = 0; i < KEYS; i++)
+	{
+		u32 nIncrement = GetPhaseIncrement (s_pKeyFrequency[i]);
+
+		s_nKeyIncrement[i] = nIncrement > 0 ? nIncrement : 1;	// 0 is "no key"
+	}
 }
 
-void COscillator::SetModulationVolume (float fVolume)
+template <typename TSample>
+TSample COscillatorT<TSample>::GetNoiseSample (TNoiseColor Color)
 {
-	assert (0.0 <= fVolume && fVolume <= 1.0);
-	m_fModulationVolume = fVolume;
+	// a change of the color takes effect with the next block
+	if (m_nNoiseIndex >= NOISE_BLOCK_SIZE)
+	{
+		m_Noise.Generate (m_NoiseBlock, NOISE_BLOCK_SIZE, Color);
+		m_nNoiseIndex = 0;
+	}
+
+	return m_NoiseBlock[m_nNoiseIndex++];
 }
 
-void COscillator::NextSample (void)
+template <>
+void COscillatorT<float>::NextSample (void)
 {
-	float fFrequency = m_fFrequency;
-	if (m_pModulator != 0)
+	assert (m_pParameters != 0);
+
+	u32 nIncrement;
+	if (   m_nKeyIncrement == 0			// fixed frequency (LFO), which is not modulated
+	    && m_pModulator == 0)
 	{
-		fFrequency += m_pModulator->GetOutputLevel () * m_fModulationVolume * 20.0;
-		if (fFrequency <= 0.0)
+		nIncrement = m_pParameters->nPhaseIncrement;
+	}
+	else
+	{
+		float fIncrement =   m_nKeyIncrement != 0
+				   ? m_nKeyIncrement * m_pParameters->fPitchFactor
+				   : m_pParameters->nPhaseIncrement;
+		if (m_pModulator != 0)
+		{
+			// the modulation is +/- 20 Hz
+			fIncrement +=   m_pModulator->GetOutputLevel ()
+				      * m_pParameters->fModulationVolume
+				      * m_pParameters->nModulationIncrement;
+			if (fIncrement <= 0.0f)
+			{
+				return;
+			}
+		}
+
+		if (fIncrement > MAX_PHASE_INCREMENT)
 		{
-			return;
+			fIncrement = MAX_PHASE_INCREMENT;
 		}
+
+		nIncrement = (u32) fIncrement;
 	}
 
-	unsigned nPeriod = SAMPLE_RATE / fFrequency + 0.5;
-	if (++m_nSampleCount >= nPeriod)
+	m_nPhase += nIncrement;
+
+	switch (m_pParameters->Waveform)
 	{
-		m_nSampleCount = 0;
+	case WaveformSine:
+		m_OutputLevel = SineTable.Value[m_nPhase >> SINE_SHIFT];
+		break;
+
+	case WaveformSquare:
+		m_OutputLevel = m_nPhase < 0x80000000U ? 1.0f : -1.0f;
+		break;
+
+	case WaveformSawtooth:
+		m_OutputLevel = m_nPhase * (2.0f / PHASE_RANGE) - 1.0f;
+		break;
+
+	case WaveformTriangle:
+		m_OutputLevel =   m_nPhase < 0x80000000U
+				? m_nPhase * (4.0f / PHASE_RANGE) - 1.0f
+				: 3.0f - m_nPhase * (4.0f / PHASE_RANGE);
+		break;
+
+	case WaveformPulse12:
+		m_OutputLevel = m_nPhase < 0x20000000U ? 1.0f : -1.0f;
+		break;
+
+	case WaveformPulse25:
+		m_OutputLevel = m_nPhase < 0x40000000U ? 1.0f : -1.0f;
+		break;
+
+	case WaveformWhiteNoise:
+		m_OutputLevel = GetNoiseSample (NoiseWhite);
+		break;
+
+	case WaveformPinkNoise:
+		m_OutputLevel = GetNoiseSample (NoisePink);
+		break;
+
+	case WaveformBrownNoise:
+		m_OutputLevel = GetNoiseSample (NoiseBrown);
+		break;
+
+	default:
+		assert (0);
+		break;
 	}
+}
+
+#ifdef FIXED_POINT_DSP
 
-	switch (m_Waveform)
+template <>
+void COscillatorT<TQ15>::NextSample (void)
+{
+	assert (m_pParameters != 0);
+
+	u32 nIncrement;
+	if (   m_nKeyIncrement == 0			// fixed frequency (LFO), which is not modulated
+	    && m_pModulator == 0)
+	{
+		nIncrement = m_pParameters->nPhaseIncrement;
+	}
+	else
+	{
+		s64 nModulatedIncrement =   m_nKeyIncrement != 0
+					  ? ((u64) m_nKeyIncrement * m_pParameters->nPitchFactor) >> 16
+					  : m_pParameters->nPhaseIncrement;
+		if (m_pModulator != 0)
+		{
+			// the modulation is +/- 20 Hz (Q30 * increment >> 30)
+			s32 nModulation =   m_pModulator->GetOutputLevel ()
+					  * m_pParameters->nModulationVolume;
+			nModulatedIncrement +=   ((s64) nModulation * m_pParameters->nModulationIncrement)
+					       >> 30;
+			if (nModulatedIncrement <= 0)
+			{
+				return;
+			}
+		}
+
+		if (nModulatedIncrement > MAX_PHASE_INCREMENT)
+		{
+			nModulatedIncrement = MAX_PHASE_INCREMENT;
+		}
+
+		nIncrement = (u32) nModulatedIncrement;
+	}
+
+	m_nPhase += nIncrement;
+
+	switch (m_pParameters->Waveform)
 	{
 	case WaveformSine:
-		m_fOutputLevel = s_SineTable[m_nSampleCount * SINE_POINTS / nPeriod];
+		m_OutputLevel = SineTable.ValueQ15[m_nPhase >> SINE_SHIFT];
 		break;
 
 	case WaveformSquare:
-		m_fOutputLevel = m_nSampleCount*2 < nPeriod ? 1.0 : -1.0;
+		m_OutputLevel = m_nPhase < 0x80000000U ? Q15_MAX : Q15_MIN;
 		break;
 
 	case WaveformSawtooth:
-		m_fOutputLevel = -1.0 + (2.0 * m_nSampleCount) / nPeriod;
+		m_OutputLevel = (TQ15) (m_nPhase >> 16) - Q15_ONE;
 		break;
 
 	case WaveformTriangle:
-		m_fOutputLevel =   m_nSampleCount*2 < nPeriod
-				 ? -1.0 + (2.0 * m_nSampleCount*2) / nPeriod
-				 : 1.0 - (2.0 * (m_nSampleCount*2-nPeriod)) / nPeriod;
+		m_OutputLevel =   m_nPhase < 0x80000000U
+				? (TQ15) (m_nPhase >> 15) - Q15_ONE
+				: Q15Saturate (3*Q15_ONE - (TQ15) (m_nPhase >> 15));
 		break;
 
 	case WaveformPulse12:
-	case WaveformPulse25: {
-		float fPulseWidth = m_Waveform == WaveformPulse12 ? 0.125 : 0.25;
-		m_fOutputLevel = m_nSampleCount < nPeriod*fPulseWidth ? 1.0 : -1.0;
-		} break;
+		m_OutputLevel = m_nPhase < 0x20000000U ? Q15_MAX : Q15_MIN;
+		break;
+
+	case WaveformPulse25:
+		m_OutputLevel = m_nPhase < 0x40000000U ? Q15_MAX : Q15_MIN;
+		break;
 
 	case WaveformWhiteNoise:
-		m_fOutputLevel = rand_r (&m_nRandSeed) * (2.0 / RAND_MAX) - 1.0;
+		m_OutputLevel = GetNoiseSample (NoiseWhite);
+		break;
+
+	case WaveformPinkNoise:
+		m_OutputLevel = GetNoiseSample (NoisePink);
+		break;
+
+	case WaveformBrownNoise:
+		m_OutputLevel = GetNoiseSample (NoiseBrown);
 		break;
 
 	default:
@@ -215,7 +429,15 @@ void COscillator::NextSample (void)
 	}
 }
 
-float COscillator::GetOutputLevel (void) const
+#endif
+
+template <typename TSample>
+TSample COscillatorT<TSample>::GetOutputLevel (void) const
 {
-	return m_fOutputLevel;
+	return m_OutputLevel;
 }
+
+template class COscillatorT<float>;
+#ifdef FIXED_POINT_DSP
+template class COscillatorT<TQ15>;
+#endif
@@ -23,6 +23,7 @@
 #define _oscillator_h
 
 #include "synthmodule.h"
+#include "noisegenerator.h"
 
 enum TWaveform
 {
@@ -33,43 +34,78 @@ enum TWaveform
 	WaveformPulse12,
 	WaveformPulse25,
 	WaveformWhiteNoise,
+	WaveformPinkNoise,
+	WaveformBrownNoise,
 	WaveformUnknown
 };
 
-class COscillator : public CSynthModule
+struct TOscillatorParameters
+{
+	TWaveform	Waveform;
+	float		fFrequency;		// in Hz, if not played by MIDI note
+	u32		nPhaseIncrement;	// per sample, derived from fFrequency
+	float		fPitchFactor;		// applied to the MIDI note frequency
+	float		fModulationVolume;	// [0.0, 1.0]
+	u32		nModulationIncrement;	// phase increment of the full modulation (20 Hz)
+#ifdef FIXED_POINT_DSP
+	TQ16		nPitchFactor;		// derived from the float values
+	TQ15		nModulationVolume;
+#endif
+};
+
+template <typename TSample>
+class COscillatorT : public CSynthModuleT<TSample>
 {
 public:
-	COscillator (CSynthModule *pModulator = 0);
-	~COscillator (void);
+	COscillatorT (CSynthModuleT<TSample> *pModulator = 0);
+	~COscillatorT (void);
+
+	// the parameters are referenced, not copied
+	void SetParameters (const TOscillatorParameters *pParameters);
 
-	void SetWaveform (TWaveform Waveform);
 	void SetMIDINote (unsigned uMIDINote);			// MIDI note number
-	void SetFrequency (float fFrequency);		// in Hz
-	void SetDetune (float fDetune);				// [-1.0, 1.0]
-	void SetOctave (int iOctave);			// [-3, +2]
-	void SetModulationVolume (float fVolume);		// [0.0, 1.0]
 
 	void NextSample (void);
-	float GetOutputLevel (void) const;			// returns [-1.0, 1.0]
+	TSample GetOutputLevel (void) const;			// returns [-1.0, 1.0]
+
+	// helpers to derive the parameters
+	static u32 GetPhaseIncrement (float fFrequency);	// in Hz
+	static float GetPitchFactor (float fDetune,		// [-1.0, 1.0]
+				     int iOctave);		// [-3, +2]
+
+	// The frequencies of the MIDI keys default to equal temperament with A4 = 440 Hz.
+	// Another tuning (128 frequencies in Hz) can be set before the voices are
+	// started. It is compiled into the table of the phase increments per key, which
+	// is rebuilt by UpdateTables(), when the sample rate has changed.
+	static void SetTuning (const float *pKeyFrequency);
+	static void UpdateTables (void);
 
 private:
-	CSynthModule *m_pModulator;
+	TSample GetNoiseSample (TNoiseColor Color);
 
-	TWaveform m_Waveform;
-	float m_fFrequency;
-	float m_fMidFrequency;
-	unsigned m_uMIDINote;
-	float m_fDetune;
-	float m_fOctave;
-	float m_fModulationVolume;
+private:
+	CSynthModuleT<TSample> *m_pModulator;
+
+	const TOscillatorParameters *m_pParameters;
+
+	u32 m_nKeyIncrement;				// 0 if not played by MIDI note
 
-	unsigned m_nSampleCount;
+	u32 m_nPhase;					// 2^32 is one period
 
-	float m_fOutputLevel;
+	TSample m_OutputLevel;
 
-	unsigned m_nRandSeed;
+	CNoiseGeneratorT<TSample> m_Noise;
+	TSample m_NoiseBlock[NOISE_BLOCK_SIZE];
+	unsigned m_nNoiseIndex;				// next sample in m_NoiseBlock
 
-	static float s_SineTable[];
+	static const TOscillatorParameters s_DefaultParameters;
 };
 
+template <> void COscillatorT<float>::NextSample (void);
+#ifdef FIXED_POINT_DSP
+template <> void COscillatorT<TQ15>::NextSample (void);
+#endif
+
+typedef COscillatorT<float> COscillator;
+
 #endif
@@ -21,64 +21,19 @@
 #include <circle/util.h>
 #include <assert.h>
 
-CParameter::CParameter (const char *pName, TParameterType Type,
-			unsigned nMinimum, unsigned nMaximum, unsigned nStep, unsigned nDefault,
-			const char *pHelp)
-:	m_pName (pName),
-	m_Type (Type),
-	m_nMinimum (nMinimum),
-	m_nMaximum (nMaximum),
-	m_nStep (nStep),
-	m_nDefault (nDefault),
-	m_pHelp (pHelp),
-	m_nValue (nDefault)
+boolean CParameter::IsValid (const TParameterInfo &rInfo, unsigned nValue)
 {
-	assert (m_pName != 0);
-	assert (m_Type < ParameterTypeUnknown);
-	assert (m_nMinimum < m_nMaximum);
-	assert (m_nMinimum <= m_nDefault && m_nDefault <= m_nMaximum);
-	assert (m_pHelp != 0);
+	return rInfo.nMinimum <= nValue && nValue <= rInfo.nMaximum;
 }
 
-CParameter::~CParameter (void)
+boolean CParameter::Down (const TParameterInfo &rInfo, unsigned *pValue)
 {
-}
-
-const char *CParameter::GetName (void)
-{
-	return m_pName;
-}
-
-unsigned CParameter::GetDefault (void) const
-{
-	return m_nDefault;
-}
-
-const char *CParameter::GetHelp (void)
-{
-	return m_pHelp;
-}
-
-unsigned CParameter::Get (void) const
-{
-	return m_nValue;
-}
-
-void CParameter::Set (unsigned nValue)
-{
-	if (m_nMinimum <= nValue && nValue <= m_nMaximum)
-	{
-		m_nValue = nValue;
-	}
-}
-
-boolean CParameter::Down (void)
-{
-	unsigned nNewValue = m_nValue - m_nStep;
-	nNewValue = (nNewValue + m_nStep-1) / m_nStep * m_nStep;
-	if (m_nMinimum <= nNewValue && nNewValue <= m_nMaximum)
+	assert (pValue != 0);
+	unsigned nNewValue = *pValue - rInfo.nStep;
+	nNewValue = (nNewValue + rInfo.nStep-1) / rInfo.nStep * rInfo.nStep;
+	if (IsValid (rInfo, nNewValue))
 	{
-		m_nValue = nNewValue;
+		*pValue = nNewValue;
 
 		return TRUE;
 	}
@@ -86,13 +41,14 @@ boolean CParameter::Down (void)
 	return FALSE;
 }
 
-boolean CParameter::Up (void)
+boolean CParameter::Up (const TParameterInfo &rInfo, unsigned *pValue)
 {
-	unsigned nNewValue = m_nValue + m_nStep;
-	nNewValue = nNewValue / m_nStep * m_nStep;
-	if (m_nMinimum <= nNewValue && nNewValue <= m_nMaximum)
+	assert (pValue != 0);
+	unsigned nNewValue = *pValue + rInfo.nStep;
+	nNewValue = nNewValue / rInfo.nStep * rInfo.nStep;
+	if (IsValid (rInfo, nNewValue))
 	{
-		m_nValue = nNewValue;
+		*pValue = nNewValue;
 
 		return TRUE;
 	}
@@ -100,7 +56,8 @@ boolean CParameter::Up (void)
 	return FALSE;
 }
 
-const char *CParameter::GetString (void)
+const char *CParameter::GetString (const TParameterInfo &rInfo, unsigned nValue,
+				   CString *pBuffer)
 {
 	static const char *Waveforms[] =	// must match TWaveform in oscillator.h
 	{
@@ -110,38 +67,42 @@ const char *CParameter::GetString (void)
 		"Triangle",
 		"Pulse12",
 		"Pulse25",
-		"Noise"
+		"Noise",
+		"Pink",
+		"Brown"
 	};
 
-	switch (m_Type)
+	assert (pBuffer != 0);
+
+	switch (rInfo.Type)
 	{
 	case ParameterWaveform:
-		assert (m_nValue < sizeof Waveforms / sizeof Waveforms[0]);
-		return Waveforms[m_nValue];
+		assert (nValue < sizeof Waveforms / sizeof Waveforms[0]);
+		return Waveforms[nValue];
 
 	case ParameterFrequency:
-		m_String.Format ("%u Hz", m_nValue);
-		return m_String;
+		pBuffer->Format ("%u Hz", nValue);
+		return *pBuffer;
 
 	case ParameterFrequencyTenth:
-		m_String.Format ("%.1f Hz", m_nValue / 10.0);
-		return m_String;
+		pBuffer->Format ("%.1f Hz", nValue / 10.0);
+		return *pBuffer;
 
 	case ParameterTime:
-		m_String.Format ("%u ms", m_nValue);
-		return m_String;
+		pBuffer->Format ("%u ms", nValue);
+		return *pBuffer;
 
 	case ParameterPercent:
-		m_String.Format ("%u %", m_nValue);
-		return m_String;
+		pBuffer->Format ("%u %", nValue);
+		return *pBuffer;
 
 	case ParameterChannel:
-		if (m_nValue == 0)
+		if (nValue == 0)
 		{
 			return "Omni Mode";
 		}
-		m_String.Format ("%u", m_nValue);
-		return m_String;
+		pBuffer->Format ("%u", nValue);
+		return *pBuffer;
 
 	default:
 		assert (0);
@@ -149,31 +110,35 @@ const char *CParameter::GetString (void)
 	}
 }
 
-boolean CParameter::IsEditable (void) const
+boolean CParameter::IsEditable (const TParameterInfo &rInfo)
 {
-	return    m_Type != ParameterWaveform
-	       && m_Type != ParameterChannel;
+	return    rInfo.Type != ParameterWaveform
+	       && rInfo.Type != ParameterChannel;
 }
 
-const char *CParameter::GetEditString (void)
+const char *CParameter::GetEditString (const TParameterInfo &rInfo, unsigned nValue,
+				       CString *pBuffer)
 {
-	assert (   m_Type != ParameterWaveform
-		&& m_Type != ParameterChannel);
-	if (m_Type != ParameterFrequencyTenth)
+	assert (IsEditable (rInfo));
+	assert (pBuffer != 0);
+
+	if (rInfo.Type != ParameterFrequencyTenth)
 	{
-		m_String.Format ("%u", m_nValue);
+		pBuffer->Format ("%u", nValue);
 	}
 	else
 	{
-		m_String.Format ("%.1f", m_nValue / 10.0);
+		pBuffer->Format ("%.1f", nValue / 10.0);
 	}
 
-	return m_String;
+	return *pBuffer;
 }
 
-void CParameter::SetEditString (const char *pString)
+boolean CParameter::ParseEditString (const TParameterInfo &rInfo, const char *pString,
+				     unsigned *pValue)
 {
 	assert (pString != 0);
+	assert (pValue != 0);
 
 	char Buffer[20];
 	strncpy (Buffer, pString, sizeof Buffer);
@@ -183,7 +148,7 @@ void CParameter::SetEditString (const char *pString)
 	char *p = strtok_r (Buffer, ".", &pSavePtr);
 	if (!p)
 	{
-		return;
+		return FALSE;
 	}
 
 	char *pEnd = 0;
@@ -191,10 +156,10 @@ void CParameter::SetEditString (const char *pString)
 	if (   pEnd != 0
 	    && *pEnd != '\0')
 	{
-		return;
+		return FALSE;
 	}
 
-	if (m_Type == ParameterFrequencyTenth)
+	if (rInfo.Type == ParameterFrequencyTenth)
 	{
 		ulValue *= 10;
 
@@ -206,12 +171,19 @@ void CParameter::SetEditString (const char *pString)
 				&& *pEnd != '\0')
 			    || ulTenth > 9)
 			{
-				return;
+				return FALSE;
 			}
 
 			ulValue += ulTenth;
 		}
 	}
 
-	Set ((unsigned) ulValue);
+	if (!IsValid (rInfo, (unsigned) ulValue))
+	{
+		return FALSE;
+	}
+
+	*pValue = (unsigned) ulValue;
+
+	return TRUE;
 }
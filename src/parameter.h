@@ -36,42 +36,39 @@ enum TParameterType
 	ParameterTypeUnknown
 };
 
-class CParameter
+struct TParameterInfo			// static description of a parameter
 {
-public:
-	CParameter (const char *pName, TParameterType Type,
-		    unsigned nMinimum, unsigned nMaximum, unsigned nStep, unsigned nDefault,
-		    const char *pHelp);
-	~CParameter (void);
-
-	const char *GetName (void);
-	unsigned GetDefault (void) const;
-	const char *GetHelp (void);
-
-	unsigned Get (void) const;
-	void Set (unsigned nValue);
-
-	boolean Down (void);			// returns TRUE if value has changed
-	boolean Up (void);			// returns TRUE if value has changed
+	const char	*pName;
+	TParameterType	 Type;
+	u16		 nMinimum;
+	u16		 nMaximum;
+	u16		 nStep;
+	u16		 nDefault;
+	const char	*pHelp;
+};
 
-	const char *GetString (void);
+// The value of a parameter is stored elsewhere (as a small integer). This class
+// provides the operations on a value, as defined by the parameter description.
+// The strings are formatted into the given buffer on demand.
 
-	boolean IsEditable (void) const;
-	const char *GetEditString (void);
-	void SetEditString (const char *pString);
+class CParameter
+{
+public:
+	static boolean IsValid (const TParameterInfo &rInfo, unsigned nValue);
 
-private:
-	const char *m_pName;
-	TParameterType m_Type;
-	unsigned m_nMinimum;
-	unsigned m_nMaximum;
-	unsigned m_nStep;
-	unsigned m_nDefault;
-	const char *m_pHelp;
+	// return TRUE and the new value in *pValue, if the value has changed
+	static boolean Down (const TParameterInfo &rInfo, unsigned *pValue);
+	static boolean Up (const TParameterInfo &rInfo, unsigned *pValue);
 
-	unsigned m_nValue;
+	static const char *GetString (const TParameterInfo &rInfo, unsigned nValue,
+				      CString *pBuffer);
 
-	CString m_String;
+	static boolean IsEditable (const TParameterInfo &rInfo);
+	static const char *GetEditString (const TParameterInfo &rInfo, unsigned nValue,
+					  CString *pBuffer);
+	// returns FALSE if the string is not valid
+	static boolean ParseEditString (const TParameterInfo &rInfo, const char *pString,
+					unsigned *pValue);
 };
 
 #endif
@@ -0,0 +1,93 @@
+//
+// partmap.cpp
+//
+// MiniSynth Pi - A virtual analogue synthesizer for Raspberry Pi
+// Copyright (C) 2017-2023  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "partmap.h"
+#include <circle/string.h>
+#include <assert.h>
+
+CPartMap::CPartMap (FATFS *pFileSystem)
+:	m_Properties (DRIVE "/parts.txt", pFileSystem),
+	m_usEnabledParts (0)
+{
+	for (unsigned nPart = 0; nPart < PARTS; nPart++)
+	{
+		m_nPatch[nPart] = PATCHES;
+		m_nChannel[nPart] = 0;
+	}
+}
+
+CPartMap::~CPartMap (void)
+{
+}
+
+boolean CPartMap::Load (void)
+{
+	boolean bResult = m_Properties.Load ();
+	if (!bResult)
+	{
+		m_Properties.RemoveAll ();
+	}
+
+	// part 0 is the active patch and is not configured here
+	for (unsigned nPart = 1; nPart < PARTS; nPart++)
+	{
+		CString Name;
+		Name.Format ("Part%uPatch", nPart);
+		unsigned nPatch = m_Properties.GetNumber (Name, PATCHES);
+
+		Name.Format ("Part%uChannel", nPart);
+		unsigned nChannel = m_Properties.GetNumber (Name, 0);
+
+		if (   nPatch < PATCHES
+		    && 1 <= nChannel && nChannel <= 16)
+		{
+			m_nPatch[nPart] = nPatch;
+			m_nChannel[nPart] = nChannel;
+
+			m_usEnabledParts |= 1 << nPart;
+		}
+	}
+
+	return bResult;
+}
+
+u16 CPartMap::GetEnabledParts (void) const
+{
+	return m_usEnabledParts;
+}
+
+unsigned CPartMap::GetPatch (unsigned nPart) const
+{
+	assert (1 <= nPart && nPart < PARTS);
+	return m_nPatch[nPart];
+}
+
+void CPartMap::SetPatch (unsigned nPart, unsigned nPatch)
+{
+	assert (1 <= nPart && nPart < PARTS);
+	assert (m_usEnabledParts & (1 << nPart));
+	assert (nPatch < PATCHES);
+	m_nPatch[nPart] = nPatch;
+}
+
+unsigned CPartMap::GetChannel (unsigned nPart) const
+{
+	assert (1 <= nPart && nPart < PARTS);
+	return m_nChannel[nPart];
+}
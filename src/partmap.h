@@ -0,0 +1,57 @@
+//
+// partmap.h
+//
+// Assigns patches and MIDI channels to the multi-timbral parts
+//
+// MiniSynth Pi - A virtual analogue synthesizer for Raspberry Pi
+// Copyright (C) 2017-2023  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _partmap_h
+#define _partmap_h
+
+#include <fatfs/ff.h>
+#include <circle/types.h>
+#include <Properties/propertiesfatfsfile.h>
+#include "config.h"
+
+// Part 0 always plays the active patch on the MIDI channel set in this patch.
+// Parts 1..PARTS-1 are enabled by assigning a patch and a MIDI channel (1-16) in
+// the file parts.txt (e.g. "Part1Patch=5" and "Part1Channel=2").
+
+class CPartMap
+{
+public:
+	CPartMap (FATFS *pFileSystem);
+	~CPartMap (void);
+
+	boolean Load (void);
+
+	u16 GetEnabledParts (void) const;		// bit mask, without part 0
+
+	// for enabled parts 1..PARTS-1 only
+	unsigned GetPatch (unsigned nPart) const;
+	void SetPatch (unsigned nPart, unsigned nPatch);
+	unsigned GetChannel (unsigned nPart) const;	// 1-16
+
+private:
+	CPropertiesFatFsFile m_Properties;
+
+	unsigned m_nPatch[PARTS];
+	unsigned m_nChannel[PARTS];
+	u16 m_usEnabledParts;
+};
+
+#endif
@@ -19,19 +19,10 @@
 //
 #include "patch.h"
 #include "oscillator.h"
+#include <circle/util.h>
 #include <assert.h>
 
-static const struct
-{
-	const char	*pName;
-	TParameterType	 Type;
-	unsigned	 nMinimum;
-	unsigned	 nMaximum;
-	unsigned	 nStep;
-	unsigned	 nDefault;
-	const char	*pHelp;
-}
-ParameterList[] =		// must match TSynthParameter
+static constexpr TParameterInfo ParameterList[] =	// must match TSynthParameter
 {
 	// Name, Type, Minimum, Maximum, Step, Default, Help string
 
@@ -97,24 +88,15 @@ CPatch::CPatch (const char *pFileName, FATFS *pFileSystem)
 {
 	for (unsigned i = 0; i < SynthParameterUnknown; i++)
 	{
-		m_pParameter[i] = new CParameter (ParameterList[i].pName,
-						  ParameterList[i].Type,
-						  ParameterList[i].nMinimum,
-						  ParameterList[i].nMaximum,
-						  ParameterList[i].nStep,
-						  ParameterList[i].nDefault,
-						  ParameterList[i].pHelp);
-		assert (m_pParameter[i] != 0);
+		assert (CParameter::IsValid (ParameterList[i], ParameterList[i].nDefault));
+		m_usParameter[i] = ParameterList[i].nDefault;
 	}
+
+	m_Snapshot.Compile (this);
 }
 
 CPatch::~CPatch (void)
 {
-	for (unsigned i = 0; i < SynthParameterUnknown; i++)
-	{
-		delete m_pParameter[i];
-		m_pParameter[i] = 0;
-	}
 }
 
 boolean CPatch::Load (void)
@@ -132,125 +114,156 @@ boolean CPatch::Load (void)
 
 	for (unsigned i = 0; i < SynthParameterUnknown; i++)
 	{
-		assert (m_pParameter[i] != 0);
-		m_pParameter[i]->Set (m_Properties.GetNumber (m_pParameter[i]->GetName (),
-							      m_pParameter[i]->GetDefault ()));
+		Set ((TSynthParameter) i, m_Properties.GetNumber (ParameterList[i].pName,
+								   ParameterList[i].nDefault));
 	}
 
 	if (m_Properties.GetNumber ("Version", 1) == 1)		// correct v1 parameters
 	{
 		// decrease VCF cutoff frequency, because v1 VCF LFO depth had this influence
-		m_pParameter[VCFCutoffFrequency]->Set (  m_pParameter[VCFCutoffFrequency]->Get ()
-						       - m_pParameter[VCFModulationVolume]->Get ());
+		Set (VCFCutoffFrequency,   m_usParameter[VCFCutoffFrequency]
+					 - m_usParameter[VCFModulationVolume]);
 		// reset VCF LFO frequency and depth
-		m_pParameter[LFOVCFFrequency]->Set (ParameterList[LFOVCFFrequency].nDefault);
-		m_pParameter[VCFModulationVolume]->Set (ParameterList[VCFModulationVolume].nDefault);
+		Set (LFOVCFFrequency, ParameterList[LFOVCFFrequency].nDefault);
+		Set (VCFModulationVolume, ParameterList[VCFModulationVolume].nDefault);
 
 		// decrease master volume, because v1 VCA LFO depth had this influence
-		m_pParameter[SynthVolume]->Set (  m_pParameter[SynthVolume]->Get ()
-						- m_pParameter[VCAModulationVolume]->Get ());
+		Set (SynthVolume,   m_usParameter[SynthVolume]
+				  - m_usParameter[VCAModulationVolume]);
 		// reset VCA LFO frequency and depth
-		m_pParameter[LFOVCAFrequency]->Set (ParameterList[LFOVCAFrequency].nDefault);
-		m_pParameter[VCAModulationVolume]->Set (ParameterList[VCAModulationVolume].nDefault);
+		Set (LFOVCAFrequency, ParameterList[LFOVCAFrequency].nDefault);
+		Set (VCAModulationVolume, ParameterList[VCAModulationVolume].nDefault);
 	}
 
+	m_Snapshot.PostAll (this);		// compiled at the beginning of the next chunk
+
 	return bResult;
 }
 
-boolean CPatch::Save (void)
+void CPatch::SetParameter (TSynthParameter Parameter, unsigned nValue)
 {
-	m_Properties.RemoveAll ();
-
-	m_Properties.SetNumber ("Version", 2);
+	Set (Parameter, nValue);
 
-	for (unsigned i = 0; i < PatchPropertyUnknown; i++)
-	{
-		m_Properties.SetString (PropertyList[i].pName, m_PropertyString[i]);
-	}
+	m_Snapshot.Post (this, Parameter);
+}
 
-	for (unsigned i = 0; i < SynthParameterUnknown; i++)
-	{
-		assert (m_pParameter[i] != 0);
-		m_Properties.SetNumber (m_pParameter[i]->GetName (), m_pParameter[i]->Get ());
-	}
+void CPatch::SetParameterRamped (TSynthParameter Parameter, unsigned nValue)
+{
+	Set (Parameter, nValue);
 
-	return m_Properties.Save ();
+	m_Snapshot.UpdateRamped (this, Parameter);
 }
 
-unsigned CPatch::GetParameter (TSynthParameter Parameter) const
+void CPatch::SetMIDIParameter (TSynthParameter Parameter, u8 ucValue)
 {
-	assert (m_pParameter[Parameter] != 0);
-	return m_pParameter[Parameter]->Get ();
+	SetParameter (Parameter, MapMIDIValue (Parameter, ucValue));
 }
 
-void CPatch::SetParameter (TSynthParameter Parameter, unsigned nValue)
+unsigned CPatch::MapMIDIValue (TSynthParameter Parameter, u8 ucValue)
 {
-	assert (m_pParameter[Parameter] != 0);
-	m_pParameter[Parameter]->Set (nValue);
+	return MapValue (Parameter, ucValue, 127);
 }
 
-void CPatch::SetMIDIParameter (TSynthParameter Parameter, u8 ucValue)
+unsigned CPatch::MapValue (TSynthParameter Parameter, unsigned nValue, unsigned nRange)
 {
 	assert (Parameter < SynthParameterUnknown);
+	assert (nRange > 0);
 
-	unsigned nValue = ucValue;
-	nValue *= ParameterList[Parameter].nMaximum - ParameterList[Parameter].nMinimum;
-	nValue = (nValue + 63) / 127;
+	// Pink and Brown noise are selected in the GUI or patch file only, so that the
+	// controller positions of the seven other waveforms do not move
+	unsigned nMaximum = ParameterList[Parameter].nMaximum;
+	if (   ParameterList[Parameter].Type == ParameterWaveform
+	    && nMaximum > WaveformWhiteNoise)
+	{
+		nMaximum = WaveformWhiteNoise;
+	}
+
+	nValue *= nMaximum - ParameterList[Parameter].nMinimum;
+	nValue = (nValue + nRange/2) / nRange;
 	nValue += ParameterList[Parameter].nMinimum;
 
 	if (nValue < ParameterList[Parameter].nMinimum)
 	{
 		nValue = ParameterList[Parameter].nMinimum;
 	}
-	else if (nValue > ParameterList[Parameter].nMaximum)
+	else if (nValue > nMaximum)
 	{
-		nValue = ParameterList[Parameter].nMaximum;
+		nValue = nMaximum;
 	}
 
-	assert (m_pParameter[Parameter] != 0);
-	m_pParameter[Parameter]->Set (nValue);
+	return nValue;
 }
 
 boolean CPatch::ParameterDown (TSynthParameter Parameter)
 {
-	assert (m_pParameter[Parameter] != 0);
-	return m_pParameter[Parameter]->Down ();
+	assert (Parameter < SynthParameterUnknown);
+	unsigned nValue = m_usParameter[Parameter];
+	if (!CParameter::Down (ParameterList[Parameter], &nValue))
+	{
+		return FALSE;
+	}
+
+	m_usParameter[Parameter] = (u16) nValue;
+
+	m_Snapshot.Post (this, Parameter);
+
+	return TRUE;
 }
 
 boolean CPatch::ParameterUp (TSynthParameter Parameter)
 {
-	assert (m_pParameter[Parameter] != 0);
-	return m_pParameter[Parameter]->Up ();
+	assert (Parameter < SynthParameterUnknown);
+	unsigned nValue = m_usParameter[Parameter];
+	if (!CParameter::Up (ParameterList[Parameter], &nValue))
+	{
+		return FALSE;
+	}
+
+	m_usParameter[Parameter] = (u16) nValue;
+
+	m_Snapshot.Post (this, Parameter);
+
+	return TRUE;
 }
 
 const char *CPatch::GetParameterHelp (TSynthParameter Parameter)
 {
-	assert (m_pParameter[Parameter] != 0);
-	return m_pParameter[Parameter]->GetHelp ();
+	assert (Parameter < SynthParameterUnknown);
+	return ParameterList[Parameter].pHelp;
 }
 
 const char *CPatch::GetParameterString (TSynthParameter Parameter)
 {
-	assert (m_pParameter[Parameter] != 0);
-	return m_pParameter[Parameter]->GetString ();
+	assert (Parameter < SynthParameterUnknown);
+	return CParameter::GetString (ParameterList[Parameter], m_usParameter[Parameter],
+				      &m_String);
 }
 
 boolean CPatch::IsParameterEditable (TSynthParameter Parameter) const
 {
-	assert (m_pParameter[Parameter] != 0);
-	return m_pParameter[Parameter]->IsEditable ();
+	assert (Parameter < SynthParameterUnknown);
+	return CParameter::IsEditable (ParameterList[Parameter]);
 }
 
 const char *CPatch::GetParameterEditString (TSynthParameter Parameter)
 {
-	assert (m_pParameter[Parameter] != 0);
-	return m_pParameter[Parameter]->GetEditString ();
+	assert (Parameter < SynthParameterUnknown);
+	return CParameter::GetEditString (ParameterList[Parameter], m_usParameter[Parameter],
+					  &m_String);
 }
 
 void CPatch::SetParameterEditString (TSynthParameter Parameter, const char *pString)
 {
-	assert (m_pParameter[Parameter] != 0);
-	return m_pParameter[Parameter]->SetEditString (pString);
+	assert (Parameter < SynthParameterUnknown);
+	unsigned nValue;
+	if (!CParameter::ParseEditString (ParameterList[Parameter], pString, &nValue))
+	{
+		return;
+	}
+
+	m_usParameter[Parameter] = (u16) nValue;
+
+	m_Snapshot.Post (this, Parameter);
 }
 
 const char *CPatch::GetProperty (TPatchProperty Property) const
@@ -289,3 +302,42 @@ const char *CPatch::GetParameterName (TSynthParameter Parameter)
 	assert (Parameter < SynthParameterUnknown);
 	return ParameterList[Parameter].pName;
 }
+
+CPatchSnapshot *CPatch::GetSnapshot (void)
+{
+	return &m_Snapshot;
+}
+
+void CPatch::Set (TSynthParameter Parameter, unsigned nValue)
+{
+	assert (Parameter < SynthParameterUnknown);
+	if (CParameter::IsValid (ParameterList[Parameter], nValue))
+	{
+		m_usParameter[Parameter] = (u16) nValue;
+	}
+}
+
+void CPatch::GetText (CString *pText) const
+{
+	assert (pText != 0);
+
+	// take a snapshot first, the parameters may be modified from interrupt context
+	u16 usParameter[SynthParameterUnknown];
+	memcpy (usParameter, m_usParameter, sizeof usParameter);
+
+	// the same lines as CPropertiesFatFsFile::Save() writes
+	*pText = "Version=2\n";
+
+	CString Line;
+	for (unsigned i = 0; i < PatchPropertyUnknown; i++)
+	{
+		Line.Format ("%s=%s\n", PropertyList[i].pName, (const char *) m_PropertyString[i]);
+		pText->Append (Line);
+	}
+
+	for (unsigned i = 0; i < SynthParameterUnknown; i++)
+	{
+		Line.Format ("%s=%u\n", ParameterList[i].pName, (unsigned) usParameter[i]);
+		pText->Append (Line);
+	}
+}
@@ -23,57 +23,13 @@
 #define _patch_h
 
 #include "parameter.h"
+#include "synthparameter.h"
+#include "patchsnapshot.h"
 #include <circle/string.h>
 #include <circle/types.h>
 #include <Properties/propertiesfatfsfile.h>
 #include <fatfs/ff.h>
-
-enum TSynthParameter			// the parameters of a patch
-{
-	// VCO
-	LFOVCOWaveform,
-	LFOVCOFrequency,
-
-	VCO1Waveform,
-	VCO1ModulationVolume,
-	VCO1Octave,
-	VCO1FineTune,	
-
-	// VCF
-	LFOVCFWaveform,
-	LFOVCFFrequency,
-
-	VCFCutoffFrequency,
-	VCFResonance,
-
-	EGVCFAttack,
-	EGVCFDecay,
-	EGVCFSustain,
-	EGVCFRelease,
-
-	VCFModulationVolume,
-
-	// VCA
-	LFOVCAWaveform,
-	LFOVCAFrequency,
-
-	EGVCAAttack,
-	EGVCADecay,
-	EGVCASustain,
-	EGVCARelease,
-
-	VCAModulationVolume,
-
-	// Effects
-	ReverbDecay,
-	ReverbVolume,
-
-	// Synth
-	SynthVolume,
-	MIDIChannel,
-
-	SynthParameterUnknown
-};
+#include <assert.h>
 
 enum TPatchProperty			// additional string properties
 {
@@ -91,12 +47,25 @@ public:
 	~CPatch (void);
 
 	boolean Load (void);
-	boolean Save (void);
+	// formats a snapshot of the patch in the format of the patch file, so that it can
+	// be written in parts, use CSynthConfig::SavePatch() to save the patch to its file
+	void GetText (CString *pText) const;
+
+	unsigned GetParameter (TSynthParameter Parameter) const
+	{
+		assert (Parameter < SynthParameterUnknown);
+		return m_usParameter[Parameter];
+	}
 
-	unsigned GetParameter (TSynthParameter Parameter) const;
 	void SetParameter (TSynthParameter Parameter, unsigned nValue);
+	// a continuous value of the snapshot moves to the new value with a short ramp,
+	// modifies the snapshot directly and must be called from the render path
+	void SetParameterRamped (TSynthParameter Parameter, unsigned nValue);
 
 	void SetMIDIParameter (TSynthParameter Parameter, u8 ucValue);
+	static unsigned MapMIDIValue (TSynthParameter Parameter, u8 ucValue);
+	// maps a controller value 0..nRange to the range of the parameter
+	static unsigned MapValue (TSynthParameter Parameter, unsigned nValue, unsigned nRange);
 
 	boolean ParameterDown (TSynthParameter Parameter);	// returns TRUE if value has changed
 	boolean ParameterUp (TSynthParameter Parameter);	// returns TRUE if value has changed
@@ -116,12 +85,22 @@ public:
 
 	static const char *GetParameterName (TSynthParameter Parameter);
 
+	// returns the compiled parameters, which are kept up-to-date on each modification
+	CPatchSnapshot *GetSnapshot (void);
+
+private:
+	void Set (TSynthParameter Parameter, unsigned nValue);	// ignores invalid values
+
 private:
 	CPropertiesFatFsFile m_Properties;
 
-	CParameter *m_pParameter[SynthParameterUnknown];
+	u16 m_usParameter[SynthParameterUnknown];	// described by ParameterList[]
+
+	CString m_String;				// for the parameter strings
 
 	CString m_PropertyString[PatchPropertyUnknown];
+
+	CPatchSnapshot m_Snapshot;
 };
 
 #endif
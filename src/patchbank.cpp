@@ -0,0 +1,210 @@
+//
+// patchbank.cpp
+//
+// MiniSynth Pi - A virtual analogue synthesizer for Raspberry Pi
+// Copyright (C) 2017-2023  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "patchbank.h"
+#include <circle/util.h>
+#include <assert.h>
+
+#define BANK_SIZE	(sizeof (TPatchBankHeader) + PATCHES * sizeof (TPatchBankRecord))
+
+CPatchBank::CPatchBank (FATFS *pFileSystem)
+:	m_pFileSystem (pFileSystem),
+	m_pBuffer (new u8[BANK_SIZE]),
+	m_bDirty (FALSE)
+{
+	assert (m_pBuffer != 0);
+	memset (m_pBuffer, 0, BANK_SIZE);
+
+	m_pHeader = (TPatchBankHeader *) m_pBuffer;
+	m_pRecord = (TPatchBankRecord *) (m_pBuffer + sizeof *m_pHeader);
+
+	for (unsigned i = 0; i < PATCHES; i++)
+	{
+		m_bValid[i] = FALSE;
+	}
+}
+
+CPatchBank::~CPatchBank (void)
+{
+	delete [] m_pBuffer;
+	m_pBuffer = 0;
+
+	m_pFileSystem = 0;
+}
+
+boolean CPatchBank::Load (const char *pFileName)
+{
+	assert (pFileName != 0);
+	assert (m_pFileSystem != 0);
+
+	FIL File;
+	if (f_open (&File, pFileName, FA_READ | FA_OPEN_EXISTING) != FR_OK)
+	{
+		return FALSE;
+	}
+
+	assert (m_pBuffer != 0);
+	unsigned nBytesRead;
+	boolean bOK =    f_read (&File, m_pBuffer, BANK_SIZE, &nBytesRead) == FR_OK
+		      && nBytesRead == BANK_SIZE;
+
+	f_close (&File);
+
+	if (   !bOK
+	    || m_pHeader->nMagic != PATCH_BANK_MAGIC
+	    || m_pHeader->usVersion != PATCH_BANK_VERSION
+	    || m_pHeader->usPatches != PATCHES
+	    || m_pHeader->usParameters != SynthParameterUnknown
+	    || m_pHeader->usRecordSize != sizeof (TPatchBankRecord)
+	    || m_pHeader->nChecksum != CRC32 (m_pRecord, PATCHES * sizeof (TPatchBankRecord)))
+	{
+		memset (m_pBuffer, 0, BANK_SIZE);
+
+		return FALSE;
+	}
+
+	for (unsigned i = 0; i < PATCHES; i++)
+	{
+		m_bValid[i] = TRUE;
+	}
+
+	return TRUE;
+}
+
+const u8 *CPatchBank::GetImage (unsigned *pnSize)
+{
+	assert (pnSize != 0);
+
+	if (!m_bDirty)
+	{
+		return 0;
+	}
+
+	for (unsigned i = 0; i < PATCHES; i++)
+	{
+		if (!m_bValid[i])		// the bank must be complete
+		{
+			return 0;
+		}
+	}
+
+	m_pHeader->nMagic = PATCH_BANK_MAGIC;
+	m_pHeader->usVersion = PATCH_BANK_VERSION;
+	m_pHeader->usPatches = PATCHES;
+	m_pHeader->usParameters = SynthParameterUnknown;
+	m_pHeader->usRecordSize = sizeof (TPatchBankRecord);
+	m_pHeader->nChecksum = CRC32 (m_pRecord, PATCHES * sizeof (TPatchBankRecord));
+
+	// a record, which is set while the image is written, sets this again
+	m_bDirty = FALSE;
+
+	*pnSize = BANK_SIZE;
+
+	return m_pBuffer;
+}
+
+void CPatchBank::SetDirty (void)
+{
+	m_bDirty = TRUE;
+}
+
+boolean CPatchBank::GetPatch (unsigned nPatch, CPatch *pPatch, const FILINFO *pTextFileInfo) const
+{
+	assert (nPatch < PATCHES);
+	assert (pPatch != 0);
+	assert (pTextFileInfo != 0);
+
+	const TPatchBankRecord *pRecord = &m_pRecord[nPatch];
+
+	if (   !m_bValid[nPatch]
+	    || pRecord->nTextFileTime != GetTextFileTime (pTextFileInfo)
+	    || pRecord->nTextFileSize != pTextFileInfo->fsize)
+	{
+		return FALSE;
+	}
+
+	for (unsigned i = 0; i < SynthParameterUnknown; i++)
+	{
+		pPatch->SetParameter ((TSynthParameter) i, pRecord->usParameter[i]);
+	}
+
+	for (unsigned i = 0; i < PatchPropertyUnknown; i++)
+	{
+		char Property[PATCH_PROPERTY_SIZE];
+		strncpy (Property, pRecord->Property[i], sizeof Property);
+		Property[sizeof Property - 1] = '\0';
+
+		pPatch->SetProperty ((TPatchProperty) i, Property);
+	}
+
+	return TRUE;
+}
+
+void CPatchBank::SetPatch (unsigned nPatch, const CPatch *pPatch, const FILINFO *pTextFileInfo)
+{
+	assert (nPatch < PATCHES);
+	assert (pPatch != 0);
+	assert (pTextFileInfo != 0);
+
+	TPatchBankRecord *pRecord = &m_pRecord[nPatch];
+	memset (pRecord, 0, sizeof *pRecord);
+
+	pRecord->nTextFileTime = GetTextFileTime (pTextFileInfo);
+	pRecord->nTextFileSize = pTextFileInfo->fsize;
+
+	for (unsigned i = 0; i < SynthParameterUnknown; i++)
+	{
+		pRecord->usParameter[i] = (u16) pPatch->GetParameter ((TSynthParameter) i);
+	}
+
+	for (unsigned i = 0; i < PatchPropertyUnknown; i++)
+	{
+		assert (CPatch::GetPropertyMaxLength ((TPatchProperty) i) < PATCH_PROPERTY_SIZE);
+		strncpy (pRecord->Property[i], pPatch->GetProperty ((TPatchProperty) i),
+			 PATCH_PROPERTY_SIZE-1);
+	}
+
+	m_bValid[nPatch] = TRUE;
+	m_bDirty = TRUE;
+}
+
+u32 CPatchBank::GetTextFileTime (const FILINFO *pTextFileInfo)
+{
+	assert (pTextFileInfo != 0);
+	return (u32) pTextFileInfo->fdate << 16 | pTextFileInfo->ftime;
+}
+
+u32 CPatchBank::CRC32 (const void *pBuffer, unsigned nLength)
+{
+	assert (pBuffer != 0);
+	const u8 *p = (const u8 *) pBuffer;
+
+	u32 nCRC = 0xFFFFFFFF;
+	while (nLength--)
+	{
+		nCRC ^= *p++;
+
+		for (unsigned i = 0; i < 8; i++)
+		{
+			nCRC = (nCRC >> 1) ^ (0xEDB88320 & -(nCRC & 1));
+		}
+	}
+
+	return ~nCRC;
+}
@@ -0,0 +1,98 @@
+//
+// patchbank.h
+//
+// Binary image of all patches, which can be loaded with a single read
+//
+// MiniSynth Pi - A virtual analogue synthesizer for Raspberry Pi
+// Copyright (C) 2017-2023  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _patchbank_h
+#define _patchbank_h
+
+#include <fatfs/ff.h>
+#include <circle/macros.h>
+#include <circle/types.h>
+#include "patch.h"
+#include "config.h"
+
+#define PATCH_BANK_MAGIC	0x4250534D	// "MSPB"
+#define PATCH_BANK_VERSION	1
+
+#define PATCH_PROPERTY_SIZE	48		// including terminating null
+
+struct TPatchBankHeader
+{
+	u32	nMagic;
+	u16	usVersion;
+	u16	usPatches;
+	u16	usParameters;
+	u16	usRecordSize;
+	u32	nChecksum;			// CRC32 of all records
+}
+PACKED;
+
+struct TPatchBankRecord
+{
+	u32	nTextFileTime;			// fdate << 16 | ftime of the text file (0 if missing)
+	u32	nTextFileSize;
+	u16	usParameter[SynthParameterUnknown];
+	char	Property[PatchPropertyUnknown][PATCH_PROPERTY_SIZE];
+}
+PACKED;
+
+// The patch bank is a cache of the text patch files. Each record keeps the time and
+// size of the text file, it was generated from. If a text file has been modified
+// (e.g. on a PC), the record is not up-to-date any more and must be regenerated.
+// The image of the bank is kept in memory, so that the patches can be taken from it
+// one by one, when they are needed.
+
+class CPatchBank
+{
+public:
+	CPatchBank (FATFS *pFileSystem);
+	~CPatchBank (void);
+
+	// reads the bank with a single read, returns FALSE if it is missing or invalid
+	boolean Load (const char *pFileName);
+
+	// returns the image of the bank, which has to be written, if a record has been
+	// modified and all records are valid, otherwise 0, the bank counts as written then
+	const u8 *GetImage (unsigned *pnSize);
+	// the image returned by GetImage() could not be written
+	void SetDirty (void);
+
+	// returns FALSE if the record is not up-to-date with the text file
+	boolean GetPatch (unsigned nPatch, CPatch *pPatch, const FILINFO *pTextFileInfo) const;
+
+	void SetPatch (unsigned nPatch, const CPatch *pPatch, const FILINFO *pTextFileInfo);
+
+private:
+	static u32 GetTextFileTime (const FILINFO *pTextFileInfo);
+
+	static u32 CRC32 (const void *pBuffer, unsigned nLength);
+
+private:
+	FATFS *m_pFileSystem;
+
+	u8 *m_pBuffer;
+	TPatchBankHeader *m_pHeader;
+	TPatchBankRecord *m_pRecord;		// PATCHES records
+
+	boolean m_bValid[PATCHES];		// record has been loaded or set
+	boolean m_bDirty;			// must be written
+};
+
+#endif
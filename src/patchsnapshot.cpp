@@ -0,0 +1,409 @@
+//
+// patchsnapshot.cpp
+//
+// MiniSynth Pi - A virtual analogue synthesizer for Raspberry Pi
+// Copyright (C) 2017-2023  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "patchsnapshot.h"
+#include "patch.h"
+#include "fastmath.h"
+#include "config.h"
+#include <circle/synchronize.h>
+#include <assert.h>
+
+CPatchSnapshot::CPatchSnapshot (void)
+:	m_pPatch (0),
+	m_nPostedMask (0),
+	m_nRampMask (0)
+{
+	SetDefaults ();
+}
+
+CPatchSnapshot::~CPatchSnapshot (void)
+{
+}
+
+void CPatchSnapshot::Compile (const CPatch *pPatch)
+{
+	SetDefaults ();			// the sample rate may have been changed
+
+	for (unsigned i = 0; i < SynthParameterUnknown; i++)
+	{
+		Update (pPatch, (TSynthParameter) i);
+	}
+}
+
+void CPatchSnapshot::SetDefaults (void)
+{
+	const u32 nIncrement20Hz = COscillator::GetPhaseIncrement (20.0f);
+	const TOscillatorParameters LFODefault =
+	{
+		WaveformSine, 20.0f, nIncrement20Hz, 1.0f, 0.0f, nIncrement20Hz
+#ifdef FIXED_POINT_DSP
+		, Q16_ONE, 0
+#endif
+	};
+
+	LFOVCO = LFODefault;
+	VCO = LFODefault;		// frequency is given by the MIDI note
+	VCO2 = LFODefault;		// runs at the pitch frequency with sine waveform for now
+	LFOVCF = LFODefault;
+	LFOVCA = LFODefault;
+}
+
+void CPatchSnapshot::Update (const CPatch *pPatch, TSynthParameter Parameter)
+{
+	assert (pPatch != 0);
+	unsigned nValue = pPatch->GetParameter (Parameter);
+
+	StopRamp (Parameter);
+
+	switch (Parameter)
+	{
+	// VCO
+	case LFOVCOWaveform:
+		LFOVCO.Waveform = (TWaveform) nValue;
+		break;
+
+	case LFOVCOFrequency:
+		LFOVCO.fFrequency = nValue;
+		LFOVCO.nPhaseIncrement = COscillator::GetPhaseIncrement (LFOVCO.fFrequency);
+		break;
+
+	case VCO1Waveform:
+		VCO.Waveform = (TWaveform) nValue;
+		break;
+
+	case VCO1ModulationVolume:
+		VCO.fModulationVolume = nValue / 100.0f;
+		break;
+
+	case VCO1Octave:
+		StopRamp (VCO1FineTune);	// same value
+		// fall through
+
+	case VCO1FineTune:
+		VCO.fPitchFactor = COscillator::GetPitchFactor (
+					pPatch->GetParameter (VCO1FineTune) / 100.0f - 1.0f,
+					static_cast<int>(pPatch->GetParameter (VCO1Octave)) - 3);
+		break;
+
+	// TODO: Add VCOs 2, 3, 4
+
+	// VCF
+	case LFOVCFWaveform:
+		LFOVCF.Waveform = (TWaveform) nValue;
+		break;
+
+	case LFOVCFFrequency:
+		LFOVCF.fFrequency = nValue / 10.0f;
+		LFOVCF.nPhaseIncrement = COscillator::GetPhaseIncrement (LFOVCF.fFrequency);
+		break;
+
+	case VCFCutoffFrequency:
+		VCF.fCutoffFrequency = nValue;
+		break;
+
+	case VCFResonance:
+		VCF.fQ = CFilter::GetQ (nValue);
+		break;
+
+	case EGVCFAttack:
+		EGVCF.fAttackIncrement = CEnvelopeGenerator::GetIncrement (nValue);
+		break;
+
+	case EGVCFDecay:
+		EGVCF.fDecayIncrement = CEnvelopeGenerator::GetIncrement (nValue);
+		break;
+
+	case EGVCFSustain:
+		EGVCF.fSustainLevel = nValue / 100.0f;
+		break;
+
+	case EGVCFRelease:
+		EGVCF.fReleaseIncrement = CEnvelopeGenerator::GetIncrement (nValue);
+		break;
+
+	case VCFModulationVolume:
+		VCF.fModulationVolume = nValue / 100.0f;
+		break;
+
+	// VCA
+	case LFOVCAWaveform:
+		LFOVCA.Waveform = (TWaveform) nValue;
+		break;
+
+	case LFOVCAFrequency:
+		LFOVCA.fFrequency = nValue / 10.0f;
+		LFOVCA.nPhaseIncrement = COscillator::GetPhaseIncrement (LFOVCA.fFrequency);
+		break;
+
+	case EGVCAAttack:
+		EGVCA.fAttackIncrement = CEnvelopeGenerator::GetIncrement (nValue);
+		break;
+
+	case EGVCADecay:
+		EGVCA.fDecayIncrement = CEnvelopeGenerator::GetIncrement (nValue);
+		break;
+
+	case EGVCASustain:
+		EGVCA.fSustainLevel = nValue / 100.0f;
+		break;
+
+	case EGVCARelease:
+		EGVCA.fReleaseIncrement = CEnvelopeGenerator::GetIncrement (nValue);
+		break;
+
+	case VCAModulationVolume:
+		VCA.fModulationVolume = nValue / 100.0f;
+		break;
+
+	// Effects
+	case ReverbDecay:
+		Reverb.fDecay = nValue / 100.0f;
+		Reverb.fDecayDiffusion2 = CReverbModule::GetDecayDiffusion2 (Reverb.fDecay);
+		break;
+
+	case ReverbVolume:
+		Reverb.fWetDryRatio = nValue / 100.0f;
+		break;
+
+	// Synth
+	case SynthVolume:
+		fVolume = FastPow (nValue / 100.0f, 3.3f); // apply some curve
+		break;
+
+	case MIDIChannel:
+		break;
+
+	default:
+		assert (0);
+		break;
+	}
+
+#ifdef FIXED_POINT_DSP
+	UpdateFixed (Parameter);
+#endif
+}
+
+void CPatchSnapshot::UpdateRamped (const CPatch *pPatch, TSynthParameter Parameter)
+{
+	float *pValue = GetRampValue (Parameter);
+	if (pValue == 0)
+	{
+		Update (pPatch, Parameter);
+
+		return;
+	}
+
+	float fStartValue = *pValue;
+
+	Update (pPatch, Parameter);
+
+	m_fRampTarget[Parameter] = *pValue;
+	m_fRampIncrement[Parameter] = (*pValue - fStartValue) / RampSteps;
+	m_nRampStepsLeft[Parameter] = RampSteps;
+
+	*pValue = fStartValue;
+#ifdef FIXED_POINT_DSP
+	UpdateFixed (Parameter);
+#endif
+
+	m_nRampMask |= 1 << Parameter;
+
+	// a posted value of the parameter is older, ApplyPosted() would stop the ramp
+	m_nPostedMask &= ~(1 << Parameter);
+}
+
+void CPatchSnapshot::NextRampStep (void)
+{
+	for (u32 nMask = m_nRampMask; nMask != 0; nMask &= nMask-1)
+	{
+		TSynthParameter Parameter = (TSynthParameter) __builtin_ctz (nMask);
+
+		float *pValue = GetRampValue (Parameter);
+		assert (pValue != 0);
+
+		if (--m_nRampStepsLeft[Parameter] > 0)
+		{
+			*pValue += m_fRampIncrement[Parameter];
+		}
+		else
+		{
+			*pValue = m_fRampTarget[Parameter];
+
+			m_nRampMask &= ~(1 << Parameter);
+		}
+
+#ifdef FIXED_POINT_DSP
+		UpdateFixed (Parameter);
+#endif
+	}
+}
+
+void CPatchSnapshot::FinishRamps (void)
+{
+	for (u32 nMask = m_nRampMask; nMask != 0; nMask &= nMask-1)
+	{
+		TSynthParameter Parameter = (TSynthParameter) __builtin_ctz (nMask);
+
+		float *pValue = GetRampValue (Parameter);
+		assert (pValue != 0);
+
+		*pValue = m_fRampTarget[Parameter];
+
+#ifdef FIXED_POINT_DSP
+		UpdateFixed (Parameter);
+#endif
+	}
+
+	m_nRampMask = 0;
+}
+
+void CPatchSnapshot::Post (const CPatch *pPatch, TSynthParameter Parameter)
+{
+	assert (pPatch != 0);
+	assert (Parameter < SynthParameterUnknown);
+
+	EnterCritical (IRQ_LEVEL);		// ApplyPosted() runs in IRQ context
+
+	m_pPatch = pPatch;
+	m_nPostedMask |= 1 << Parameter;
+
+	LeaveCritical ();
+}
+
+void CPatchSnapshot::PostAll (const CPatch *pPatch)
+{
+	assert (pPatch != 0);
+	assert (SynthParameterUnknown <= 32);
+
+	EnterCritical (IRQ_LEVEL);
+
+	m_pPatch = pPatch;
+	m_nPostedMask = ~0U >> (32 - SynthParameterUnknown);
+
+	LeaveCritical ();
+}
+
+void CPatchSnapshot::ApplyPosted (void)
+{
+	assert (m_pPatch != 0);
+
+	for (u32 nMask = m_nPostedMask; nMask != 0; nMask &= nMask-1)
+	{
+		Update (m_pPatch, (TSynthParameter) __builtin_ctz (nMask));
+	}
+
+	m_nPostedMask = 0;
+}
+
+float *CPatchSnapshot::GetRampValue (TSynthParameter Parameter)
+{
+	switch (Parameter)
+	{
+	case VCO1ModulationVolume:	return &VCO.fModulationVolume;
+	case VCO1FineTune:		return &VCO.fPitchFactor;
+	case VCFCutoffFrequency:	return &VCF.fCutoffFrequency;
+	case VCFResonance:		return &VCF.fQ;
+	case EGVCFSustain:		return &EGVCF.fSustainLevel;
+	case VCFModulationVolume:	return &VCF.fModulationVolume;
+	case EGVCASustain:		return &EGVCA.fSustainLevel;
+	case VCAModulationVolume:	return &VCA.fModulationVolume;
+	case ReverbVolume:		return &Reverb.fWetDryRatio;
+	case SynthVolume:		return &fVolume;
+
+	default:
+		return 0;
+	}
+}
+
+void CPatchSnapshot::StopRamp (TSynthParameter Parameter)
+{
+	assert (Parameter < SynthParameterUnknown);
+	assert (SynthParameterUnknown <= 32);
+
+	m_nRampMask &= ~(1 << Parameter);
+}
+
+#ifdef FIXED_POINT_DSP
+
+void CPatchSnapshot::UpdateFixed (TSynthParameter Parameter)
+{
+	switch (Parameter)
+	{
+	// VCO
+	case VCO1ModulationVolume:
+		VCO.nModulationVolume = Q15FromFloat (VCO.fModulationVolume);
+		break;
+
+	case VCO1Octave:
+	case VCO1FineTune:
+		VCO.nPitchFactor = Q16FromFloat (VCO.fPitchFactor);
+		break;
+
+	// VCF
+	case VCFCutoffFrequency:
+		VCF.nCutoffFrequency = Q16FromFloat (VCF.fCutoffFrequency);
+		break;
+
+	case EGVCFAttack:
+		EGVCF.nAttackIncrement = Q30FromFloat (EGVCF.fAttackIncrement);
+		break;
+
+	case EGVCFDecay:
+		EGVCF.nDecayIncrement = Q30FromFloat (EGVCF.fDecayIncrement);
+		break;
+
+	case EGVCFSustain:
+		EGVCF.nSustainLevel = Q15FromFloat (EGVCF.fSustainLevel);
+		break;
+
+	case EGVCFRelease:
+		EGVCF.nReleaseIncrement = Q30FromFloat (EGVCF.fReleaseIncrement);
+		break;
+
+	case VCFModulationVolume:
+		VCF.nModulationVolume = Q15FromFloat (VCF.fModulationVolume);
+		break;
+
+	// VCA
+	case EGVCAAttack:
+		EGVCA.nAttackIncrement = Q30FromFloat (EGVCA.fAttackIncrement);
+		break;
+
+	case EGVCADecay:
+		EGVCA.nDecayIncrement = Q30FromFloat (EGVCA.fDecayIncrement);
+		break;
+
+	case EGVCASustain:
+		EGVCA.nSustainLevel = Q15FromFloat (EGVCA.fSustainLevel);
+		break;
+
+	case EGVCARelease:
+		EGVCA.nReleaseIncrement = Q30FromFloat (EGVCA.fReleaseIncrement);
+		break;
+
+	case VCAModulationVolume:
+		VCA.nModulationVolume = Q15FromFloat (VCA.fModulationVolume);
+		break;
+
+	default:				// not used by the voices or no derived value
+		break;
+	}
+}
+
+#endif
@@ -0,0 +1,119 @@
+//
+// patchsnapshot.h
+//
+// Parameters of a patch, compiled into the form used by the synthesizer modules
+//
+// MiniSynth Pi - A virtual analogue synthesizer for Raspberry Pi
+// Copyright (C) 2017-2023  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _patchsnapshot_h
+#define _patchsnapshot_h
+
+#include "oscillator.h"
+#include "filter.h"
+#include "envelopegenerator.h"
+#include "amplifier.h"
+#include "reverbmodule.h"
+#include "synthparameter.h"
+#include <circle/types.h>
+
+class CPatch;
+
+// All derived values (frequencies, Q, envelope increments, ...) are calculated
+// here once, when a parameter of the patch has been modified. Update() only
+// recalculates the values, which depend on the given parameter. The modules of the
+// voices reference their part of the snapshot, so that selecting another patch
+// only means to exchange a pointer. The render path accesses the snapshot read-only,
+// except that it advances the ramps of continuous parameters (cutoff, volume, ...),
+// which are started by UpdateRamped() to avoid zipper noise.
+//
+// A snapshot, which may be in use by the voices, must be modified at the beginning
+// of a chunk only. Therefore the main loop does not update it directly, but posts
+// the modified parameters, which are applied by ApplyPosted() from GetChunk().
+// This way the ramp state is accessed from the render path only too.
+
+class CPatchSnapshot
+{
+public:
+	CPatchSnapshot (void);
+	~CPatchSnapshot (void);
+
+	// modify the snapshot directly, if it is not in use or from the render path
+	void Compile (const CPatch *pPatch);				// all parameters
+	void Update (const CPatch *pPatch, TSynthParameter Parameter);	// one parameter
+
+	// same as Update(), but a continuous value moves to the new value in RampSteps
+	void UpdateRamped (const CPatch *pPatch, TSynthParameter Parameter);
+
+	boolean IsRamping (void) const		{ return m_nRampMask != 0; }
+	void NextRampStep (void);		// call at control rate
+	void FinishRamps (void);		// set all ramping values to their target
+
+	static const unsigned RampSteps = 16;
+
+	// the values of the parameter(s) in the patch have been modified in the main loop
+	void Post (const CPatch *pPatch, TSynthParameter Parameter);
+	void PostAll (const CPatch *pPatch);
+
+	boolean IsPosted (void) const		{ return m_nPostedMask != 0; }
+	void ApplyPosted (void);		// call at the beginning of a chunk
+
+public:
+	// VCO
+	TOscillatorParameters	LFOVCO;
+	TOscillatorParameters	VCO;
+	TOscillatorParameters	VCO2;		// not configurable yet
+
+	// VCF
+	TOscillatorParameters	LFOVCF;
+	TEnvelopeParameters	EGVCF;
+	TFilterParameters	VCF;
+
+	// VCA
+	TOscillatorParameters	LFOVCA;
+	TEnvelopeParameters	EGVCA;
+	TAmplifierParameters	VCA;
+
+	// Effects
+	TReverbParameters	Reverb;
+
+	// Synth
+	float			fVolume;
+
+private:
+	// sets the values, which do not depend on a patch parameter, but on the sample rate
+	void SetDefaults (void);
+
+	float *GetRampValue (TSynthParameter Parameter);	// 0 if not continuous
+	void StopRamp (TSynthParameter Parameter);
+
+#ifdef FIXED_POINT_DSP
+	// derives the fixed-point values of the voice modules from the float values
+	void UpdateFixed (TSynthParameter Parameter);
+#endif
+
+private:
+	const CPatch *m_pPatch;				// of the posted parameters
+	volatile u32 m_nPostedMask;			// bit set for each posted parameter
+
+	u32 m_nRampMask;				// bit set for each ramping parameter
+	unsigned m_nRampStepsLeft[SynthParameterUnknown];
+	float m_fRampIncrement[SynthParameterUnknown];
+	float m_fRampTarget[SynthParameterUnknown];
+}
+__attribute__ ((aligned (64)));		// max. cache line size
+
+#endif
@@ -127,7 +127,8 @@ void CPCKeyboard::KeyStatusHandlerRaw (unsigned char ucModifiers, const unsigned
 			u8 ucKeyNumber = GetKeyNumber (ucKeyCode);
 			if (ucKeyNumber != 0)
 			{
-				s_pThis->m_pSynthesizer->NoteOn (ucKeyNumber);
+				s_pThis->m_pSynthesizer->NoteOn (ucKeyNumber, VELOCITY_DEFAULT, 0,
+								 NoteSourcePCKeyboard);
 			}
 		}
 	}
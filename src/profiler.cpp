@@ -0,0 +1,178 @@
+//
+// profiler.cpp
+//
+// MiniSynth Pi - A virtual analogue synthesizer for Raspberry Pi
+// Copyright (C) 2017-2023  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "profiler.h"
+
+#ifdef PROFILE_STAGES
+
+#include <circle/logger.h>
+#include <circle/string.h>
+#include <assert.h>
+
+static const char *StageName[ProfileStageUnknown] =
+{
+	"LFOs", "VCOs", "Mixer", "EGs", "VCF", "VCA",
+	"input", "tank", "output"
+};
+
+CProfiler *CProfiler::s_pThis = 0;
+
+CProfiler::CProfiler (void)
+{
+	for (unsigned nCore = 0; nCore < PROFILE_CORES; nCore++)
+	{
+		for (unsigned nStage = 0; nStage < ProfileStageUnknown; nStage++)
+		{
+			m_Counters[nCore].nCycles[nStage] = 0;
+		}
+
+		for (unsigned nUnit = 0; nUnit < ProfileUnitUnknown; nUnit++)
+		{
+			m_Counters[nCore].nUnits[nUnit] = 0;
+		}
+	}
+
+	for (unsigned nStage = 0; nStage < ProfileStageUnknown; nStage++)
+	{
+		m_nLastCycles[nStage] = 0;
+	}
+
+	for (unsigned nUnit = 0; nUnit < ProfileUnitUnknown; nUnit++)
+	{
+		m_nLastUnits[nUnit] = 0;
+	}
+
+	EnableCycleCounter ();				// on core 0
+
+	assert (s_pThis == 0);
+	s_pThis = this;
+}
+
+CProfiler::~CProfiler (void)
+{
+	s_pThis = 0;
+}
+
+void CProfiler::EnableCycleCounter (void)
+{
+#if AARCH == 64
+	u64 nPMCR;
+	asm volatile ("mrs %0, pmcr_el0" : "=r" (nPMCR));
+	asm volatile ("msr pmcr_el0, %0" : : "r" (nPMCR | 1));		// enable counters
+	asm volatile ("msr pmccfiltr_el0, %0" : : "r" ((u64) 0));	// count in all ELs
+	asm volatile ("msr pmcntenset_el0, %0" : : "r" ((u64) 1 << 31));	// cycle counter
+#elif RASPPI == 1
+	u32 nPMNC;
+	asm volatile ("mrc p15, 0, %0, c15, c12, 0" : "=r" (nPMNC));
+	asm volatile ("mcr p15, 0, %0, c15, c12, 0" : : "r" (nPMNC | 1));	// enable counters
+#else
+	u32 nPMCR;
+	asm volatile ("mrc p15, 0, %0, c9, c12, 0" : "=r" (nPMCR));
+	asm volatile ("mcr p15, 0, %0, c9, c12, 0" : : "r" (nPMCR | 1));	// enable counters
+	asm volatile ("mcr p15, 0, %0, c9, c12, 1" : : "r" (1U << 31));	// cycle counter
+#endif
+}
+
+void CProfiler::Dump (const char *pSource)
+{
+	u64 nCycles[ProfileStageUnknown];
+	for (unsigned nStage = 0; nStage < ProfileStageUnknown; nStage++)
+	{
+		nCycles[nStage] = 0;
+		for (unsigned nCore = 0; nCore < PROFILE_CORES; nCore++)
+		{
+			nCycles[nStage] += m_Counters[nCore].nCycles[nStage];
+		}
+
+		u64 nTotal = nCycles[nStage];
+		nCycles[nStage] -= m_nLastCycles[nStage];
+		m_nLastCycles[nStage] = nTotal;
+	}
+
+	u32 nUnits[ProfileUnitUnknown];
+	for (unsigned nUnit = 0; nUnit < ProfileUnitUnknown; nUnit++)
+	{
+		nUnits[nUnit] = 0;
+		for (unsigned nCore = 0; nCore < PROFILE_CORES; nCore++)
+		{
+			nUnits[nUnit] += m_Counters[nCore].nUnits[nUnit];
+		}
+
+		u32 nTotal = nUnits[nUnit];
+		nUnits[nUnit] -= m_nLastUnits[nUnit];
+		m_nLastUnits[nUnit] = nTotal;
+	}
+
+	// voice stages per voice sample first, then reverb stages per sample
+	static const struct
+	{
+		const char *pTitle;
+		const char *pUnitName;
+		TProfileUnit Unit;
+		unsigned nFirstStage;
+		unsigned nLastStage;
+	}
+	Lines[] =
+	{
+		{"Voice cycles per voice sample:", "voice samples", ProfileUnitVoiceSample,
+		 ProfileStageLFOs, ProfileStageVCA},
+		{"Reverb cycles per sample:", "samples", ProfileUnitSample,
+		 ProfileStageReverbInput, ProfileStageReverbOutput}
+	};
+
+	for (unsigned nLine = 0; nLine < sizeof Lines / sizeof Lines[0]; nLine++)
+	{
+		u32 nCount = nUnits[Lines[nLine].Unit];
+		if (nCount == 0)
+		{
+			continue;
+		}
+
+		CString Line (Lines[nLine].pTitle);
+		u64 nSum = 0;
+		for (unsigned nStage = Lines[nLine].nFirstStage;
+		     nStage <= Lines[nLine].nLastStage; nStage++)
+		{
+			unsigned nTenths = (unsigned) (nCycles[nStage] * 10 / nCount);
+
+			CString Item;
+			Item.Format (" %s %u.%u", StageName[nStage], nTenths / 10, nTenths % 10);
+			Line.Append (Item);
+
+			nSum += nCycles[nStage];
+		}
+
+		unsigned nTenths = (unsigned) (nSum * 10 / nCount);
+
+		CString Item;
+		Item.Format (", total %u.%u (%u %s)", nTenths / 10, nTenths % 10,
+			     nCount, Lines[nLine].pUnitName);
+		Line.Append (Item);
+
+		CLogger::Get ()->Write (pSource, LogNotice, "%s", (const char *) Line);
+	}
+}
+
+CProfiler *CProfiler::Get (void)
+{
+	assert (s_pThis != 0);
+	return s_pThis;
+}
+
+#endif
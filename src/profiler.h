@@ -0,0 +1,146 @@
+//
+// profiler.h
+//
+// Cycle counter profiling of the stages of the voices and the reverb
+//
+// MiniSynth Pi - A virtual analogue synthesizer for Raspberry Pi
+// Copyright (C) 2017-2023  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _profiler_h
+#define _profiler_h
+
+#include "config.h"
+
+enum TProfileStage
+{
+	ProfileStageLFOs,			// per voice sample
+	ProfileStageVCOs,
+	ProfileStageMixer,
+	ProfileStageEGs,
+	ProfileStageVCF,
+	ProfileStageVCA,
+	ProfileStageReverbInput,		// per sample
+	ProfileStageReverbTank,
+	ProfileStageReverbOutput,
+	ProfileStageUnknown
+};
+
+enum TProfileUnit
+{
+	ProfileUnitVoiceSample,
+	ProfileUnitSample,
+	ProfileUnitUnknown
+};
+
+// PROFILE_BEGIN() starts the measurement of one unit of work, each following
+// PROFILE_STAGE() adds the cycles since the previous call to the given stage.
+// Both must be used in the same block.
+
+#ifdef PROFILE_STAGES
+	#define PROFILE_BEGIN(unit)						\
+		CProfiler::TCounters *pProfileCounters = CProfiler::Get ()->GetCounters ();	\
+		pProfileCounters->nUnits[unit]++;				\
+		u32 nProfileCycles = CProfiler::ReadCycleCounter ()
+	#define PROFILE_STAGE(stage)						\
+		nProfileCycles = pProfileCounters->Add (stage, nProfileCycles)
+#else
+	#define PROFILE_BEGIN(unit)	((void) 0)
+	#define PROFILE_STAGE(stage)	((void) 0)
+#endif
+
+#ifdef PROFILE_STAGES
+
+#include <circle/synchronize.h>
+#include <circle/types.h>
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	#include <circle/multicore.h>
+	#define PROFILE_CORES	CORES
+#else
+	#define PROFILE_CORES	1
+#endif
+
+// Each core accumulates the cycles in its own counters, so that no locking is
+// needed. Dump() runs on core 0 and reads the counters of the other cores while
+// they may be updated, which can falsify a single report slightly.
+
+class CProfiler
+{
+public:
+	struct TCounters
+	{
+		u64 nCycles[ProfileStageUnknown];
+		u32 nUnits[ProfileUnitUnknown];
+
+		u32 Add (TProfileStage Stage, u32 nStartCycles)
+		{
+			u32 nCycles = ReadCycleCounter ();
+			this->nCycles[Stage] += nCycles - nStartCycles;
+
+			return nCycles;
+		}
+	}
+	__attribute__ ((aligned (DATA_CACHE_LINE_SIZE_MAX)));
+
+public:
+	CProfiler (void);
+	~CProfiler (void);
+
+	// enables the cycle counter of the calling core, call on each core once
+	static void EnableCycleCounter (void);
+
+	static u32 ReadCycleCounter (void)
+	{
+		u32 nCycles;
+#if AARCH == 64
+		u64 nValue;
+		asm volatile ("mrs %0, pmccntr_el0" : "=r" (nValue));
+		nCycles = (u32) nValue;
+#elif RASPPI == 1
+		asm volatile ("mrc p15, 0, %0, c15, c12, 1" : "=r" (nCycles));
+#else
+		asm volatile ("mrc p15, 0, %0, c9, c13, 0" : "=r" (nCycles));
+#endif
+		return nCycles;
+	}
+
+	TCounters *GetCounters (void)			// of the calling core
+	{
+#ifdef ARM_ALLOW_MULTI_CORE
+		return &m_Counters[CMultiCoreSupport::ThisCore ()];
+#else
+		return &m_Counters[0];
+#endif
+	}
+
+	// writes the cycles per unit of each stage since the last call to the logger
+	void Dump (const char *pSource);
+
+	static CProfiler *Get (void);
+
+private:
+	TCounters m_Counters[PROFILE_CORES];
+
+	// sums of all cores at the last Dump()
+	u64 m_nLastCycles[ProfileStageUnknown];
+	u32 m_nLastUnits[ProfileUnitUnknown];
+
+	static CProfiler *s_pThis;
+};
+
+#endif
+
+#endif
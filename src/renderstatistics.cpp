@@ -0,0 +1,257 @@
+//
+// renderstatistics.cpp
+//
+// MiniSynth Pi - A virtual analogue synthesizer for Raspberry Pi
+// Copyright (C) 2017-2023  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "renderstatistics.h"
+#include <circle/logger.h>
+#include <circle/string.h>
+#include <circle/timer.h>
+#include <assert.h>
+
+CRenderStatistics::CRenderStatistics (void)
+{
+	Reset ();
+}
+
+CRenderStatistics::~CRenderStatistics (void)
+{
+}
+
+void CRenderStatistics::Reset (void)
+{
+	m_nChunks = 0;
+	m_nUnderruns = 0;
+
+	for (unsigned nCore = 0; nCore < STATISTICS_CORES; nCore++)
+	{
+		for (unsigned nBucket = 0; nBucket < Buckets; nBucket++)
+		{
+			m_nHistogram[nCore][nBucket] = 0;
+		}
+
+		m_nMaxTicks[nCore] = 0;
+		m_nMaxPercent[nCore] = 0;
+	}
+
+	for (unsigned nVoices = 0; nVoices <= VOICES; nVoices++)
+	{
+		m_nVoiceHistogram[nVoices] = 0;
+	}
+
+	m_nPeakVoices = 0;
+	m_nVoiceSteals = 0;
+}
+
+void CRenderStatistics::AddRenderTime (unsigned nCore, unsigned nTicks, unsigned nDeadlineTicks)
+{
+	assert (nCore < STATISTICS_CORES);
+	assert (nDeadlineTicks > 0);
+
+	unsigned nPercent = nTicks * 100 / nDeadlineTicks;
+
+	m_nHistogram[nCore][GetBucket (nPercent)]++;
+
+	if (nTicks > m_nMaxTicks[nCore])
+	{
+		m_nMaxTicks[nCore] = nTicks;
+	}
+
+	if (nPercent > m_nMaxPercent[nCore])
+	{
+		m_nMaxPercent[nCore] = nPercent;
+	}
+
+	if (   nCore == 0
+	    && nTicks > nDeadlineTicks)
+	{
+		m_nUnderruns++;
+	}
+}
+
+void CRenderStatistics::AddActiveVoices (unsigned nVoices)
+{
+	assert (nVoices <= VOICES);
+
+	m_nVoiceHistogram[nVoices]++;
+
+	if (nVoices > m_nPeakVoices)
+	{
+		m_nPeakVoices = nVoices;
+	}
+
+	m_nChunks++;
+}
+
+void CRenderStatistics::AddVoiceSteals (unsigned nSteals)
+{
+	m_nVoiceSteals += nSteals;
+}
+
+unsigned CRenderStatistics::GetChunkCount (void) const
+{
+	return m_nChunks;
+}
+
+unsigned CRenderStatistics::GetUnderrunCount (void) const
+{
+	return m_nUnderruns;
+}
+
+unsigned CRenderStatistics::GetMaxRenderTicks (unsigned nCore) const
+{
+	assert (nCore < STATISTICS_CORES);
+	return m_nMaxTicks[nCore];
+}
+
+unsigned CRenderStatistics::GetMaxRenderPercent (unsigned nCore) const
+{
+	assert (nCore < STATISTICS_CORES);
+	return m_nMaxPercent[nCore];
+}
+
+unsigned CRenderStatistics::GetPeakVoices (void) const
+{
+	return m_nPeakVoices;
+}
+
+unsigned CRenderStatistics::GetVoiceSteals (void) const
+{
+	return m_nVoiceSteals;
+}
+
+unsigned CRenderStatistics::GetRenderPercentile (unsigned nCore, unsigned nPercent) const
+{
+	assert (nCore < STATISTICS_CORES);
+	assert (nPercent <= 100);
+
+	unsigned nCount = 0;
+	for (unsigned nBucket = 0; nBucket < Buckets; nBucket++)
+	{
+		nCount += m_nHistogram[nCore][nBucket];
+	}
+
+	if (nCount == 0)
+	{
+		return 0;
+	}
+
+	// number of chunks, which must be below the percentile (rounded up)
+	unsigned nLimit = ((u64) nCount * nPercent + 99) / 100;
+
+	unsigned nChunks = 0;
+	for (unsigned nBucket = 0; nBucket < Buckets-1; nBucket++)
+	{
+		nChunks += m_nHistogram[nCore][nBucket];
+		if (nChunks >= nLimit)
+		{
+			unsigned nUpperPercent = GetBucketPercent (nBucket+1);
+
+			return   nUpperPercent < m_nMaxPercent[nCore]
+			       ? nUpperPercent : m_nMaxPercent[nCore];
+		}
+	}
+
+	return m_nMaxPercent[nCore];
+}
+
+void CRenderStatistics::Dump (const char *pSource) const
+{
+	CLogger *pLogger = CLogger::Get ();
+	assert (pLogger != 0);
+
+	unsigned nVoiceSum = 0;
+	for (unsigned nVoices = 1; nVoices <= VOICES; nVoices++)
+	{
+		nVoiceSum += nVoices * m_nVoiceHistogram[nVoices];
+	}
+
+	pLogger->Write (pSource, LogNotice,
+			"%u chunks, %u underruns, %u voices peak, %u.%02u voices average, "
+			"%u steals",
+			m_nChunks, m_nUnderruns, m_nPeakVoices,
+			m_nChunks > 0 ? nVoiceSum / m_nChunks : 0,
+			m_nChunks > 0 ? nVoiceSum * 100 / m_nChunks % 100 : 0,
+			m_nVoiceSteals);
+
+	// only the buckets, which are in use, are listed as "percent:chunks"
+	for (unsigned nCore = 0; nCore < STATISTICS_CORES; nCore++)
+	{
+		CString Line;
+		Line.Format ("Core %u: max %u us (%u%%),", nCore,
+			     m_nMaxTicks[nCore] * (1000000 / CLOCKHZ), m_nMaxPercent[nCore]);
+
+		for (unsigned nBucket = 0; nBucket < Buckets; nBucket++)
+		{
+			if (m_nHistogram[nCore][nBucket] != 0)
+			{
+				CString Item;
+				Item.Format (" %u%%:%u", GetBucketPercent (nBucket),
+					     m_nHistogram[nCore][nBucket]);
+				Line.Append (Item);
+			}
+		}
+
+		pLogger->Write (pSource, LogNotice, "%s", (const char *) Line);
+	}
+
+	CString Line ("Voices:");
+	for (unsigned nVoices = 0; nVoices <= VOICES; nVoices++)
+	{
+		if (m_nVoiceHistogram[nVoices] != 0)
+		{
+			CString Item;
+			Item.Format (" %u:%u", nVoices, m_nVoiceHistogram[nVoices]);
+			Line.Append (Item);
+		}
+	}
+
+	pLogger->Write (pSource, LogNotice, "%s", (const char *) Line);
+}
+
+unsigned CRenderStatistics::GetBucketPercent (unsigned nBucket)
+{
+	assert (nBucket < Buckets);
+
+	if (nBucket <= 1)
+	{
+		return nBucket;
+	}
+
+	unsigned nOctave = nBucket / 2;
+	unsigned nPercent = 1 << nOctave;
+
+	if (nBucket & 1)
+	{
+		nPercent += nPercent / 2;
+	}
+
+	return nPercent;
+}
+
+unsigned CRenderStatistics::GetBucket (unsigned nPercent)
+{
+	if (nPercent <= 1)
+	{
+		return nPercent;
+	}
+
+	unsigned nOctave = 31 - __builtin_clz (nPercent);	// nPercent >= 2^nOctave
+	unsigned nBucket = 2*nOctave + ((nPercent >> (nOctave-1)) & 1);
+
+	return nBucket < Buckets ? nBucket : Buckets-1;
+}
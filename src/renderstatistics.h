@@ -0,0 +1,86 @@
+//
+// renderstatistics.h
+//
+// Render time histogram, underruns and voice usage of the audio chunks
+//
+// MiniSynth Pi - A virtual analogue synthesizer for Raspberry Pi
+// Copyright (C) 2017-2023  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _renderstatistics_h
+#define _renderstatistics_h
+
+#include <circle/types.h>
+#include "voicemanager.h"
+#include "config.h"
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	#define STATISTICS_CORES	CORES
+#else
+	#define STATISTICS_CORES	1
+#endif
+
+// The render time of each chunk is taken in percent of the chunk period (the
+// deadline) and counted in a histogram with two buckets per octave (<1%, 1%, 2%,
+// 3%, 4%, 6%, 8%, 12%, ... 192%, >=256%). For core 0 this is the time spent in
+// GetChunk(), for the secondary cores the time they have been busy with their
+// voices in this chunk. A chunk, which took longer than its period on core 0, is
+// counted as underrun.
+
+class CRenderStatistics
+{
+public:
+	CRenderStatistics (void);
+	~CRenderStatistics (void);
+
+	void Reset (void);
+
+	void AddRenderTime (unsigned nCore, unsigned nTicks, unsigned nDeadlineTicks);
+	void AddActiveVoices (unsigned nVoices);	// call once per chunk
+	void AddVoiceSteals (unsigned nSteals);
+
+	unsigned GetChunkCount (void) const;
+	unsigned GetUnderrunCount (void) const;
+	unsigned GetMaxRenderTicks (unsigned nCore) const;
+	unsigned GetMaxRenderPercent (unsigned nCore) const;
+	unsigned GetPeakVoices (void) const;
+	unsigned GetVoiceSteals (void) const;
+
+	// upper limit of the bucket, which contains the percentile, in percent of the deadline
+	unsigned GetRenderPercentile (unsigned nCore, unsigned nPercent) const;
+
+	// writes the histograms to the logger
+	void Dump (const char *pSource) const;
+
+	static const unsigned Buckets = 17;
+	static unsigned GetBucketPercent (unsigned nBucket);	// lower limit
+
+private:
+	static unsigned GetBucket (unsigned nPercent);
+
+private:
+	unsigned m_nChunks;
+	unsigned m_nUnderruns;
+
+	unsigned m_nHistogram[STATISTICS_CORES][Buckets];
+	unsigned m_nMaxTicks[STATISTICS_CORES];
+	unsigned m_nMaxPercent[STATISTICS_CORES];
+
+	unsigned m_nVoiceHistogram[VOICES+1];		// chunks per active voice count
+	unsigned m_nPeakVoices;
+	unsigned m_nVoiceSteals;
+};
+
+#endif
@@ -21,7 +21,20 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include "reverbmodule.h"
+#include "profiler.h"
+#include "samplerate.h"
 #include <math.h>
+#include <assert.h>
+
+// The delay lengths of the Dattorro paper (given for 29761 Hz) have always been
+// used as samples at 48 kHz. They are converted from this rate to the current
+// sample rate, so that the reverb times are the same as at 48 kHz before.
+#define DELAY_SAMPLE_RATE	48000
+
+static unsigned ScaleDelay (unsigned nSamples)
+{
+	return ((u64) nSamples * CSampleRate::Get () + DELAY_SAMPLE_RATE/2) / DELAY_SAMPLE_RATE;
+}
 
 CReverbAttenuator::CReverbAttenuator (float fDamping)
 :	m_fDamping (fDamping),
@@ -108,65 +121,88 @@ CReverbModule::CReverbModule (void)
 	m_fWetDryRatio (0.25f),
 
 	m_BandwidthAttenuator (1.0f-Bandwidth),
-	m_InputDiffuser13_14 (InputDiffusion1, 142),
-	m_InputDiffuser19_20 (InputDiffusion1, 107),
-	m_InputDiffuser15_16 (InputDiffusion2, 379),
-	m_InputDiffuser21_22 (InputDiffusion2, 277),
-
-	m_DecayDiffuser23_24 (-DecayDiffusion1, 672, &m_LFO23_24, Excursion),
-	m_Delay30 (4453),
+	m_InputDiffuser13_14 (InputDiffusion1, ScaleDelay (142)),
+	m_InputDiffuser19_20 (InputDiffusion1, ScaleDelay (107)),
+	m_InputDiffuser15_16 (InputDiffusion2, ScaleDelay (379)),
+	m_InputDiffuser21_22 (InputDiffusion2, ScaleDelay (277)),
+
+	m_DecayDiffuser23_24 (-DecayDiffusion1, ScaleDelay (672),
+			      &m_LFO23_24, ScaleDelay (Excursion)),
+	m_Delay30 (ScaleDelay (4453)),
 	m_Attenuator30 (Damping),
-	m_DecayDiffuser31_33 (m_fDecayDiffusion2, 1800),
-	m_Delay39 (3720),
+	m_DecayDiffuser31_33 (m_fDecayDiffusion2, ScaleDelay (1800)),
+	m_Delay39 (ScaleDelay (3720)),
 
-	m_DecayDiffuser46_48 (-DecayDiffusion1, 908, &m_LFO46_48, Excursion),
-	m_Delay54 (4217),
+	m_DecayDiffuser46_48 (-DecayDiffusion1, ScaleDelay (908),
+			      &m_LFO46_48, ScaleDelay (Excursion)),
+	m_Delay54 (ScaleDelay (4217)),
 	m_Attenuator54 (Damping),
-	m_DecayDiffuser55_59 (m_fDecayDiffusion2, 2656),
-	m_Delay63 (3163),
-
-	m_DelayL48_54_1 (266),
-	m_DelayL48_54_2 (2974),
-	m_DelayL55_59 (1913),
-	m_DelayL59_63 (1996),
-	m_DelayL24_30 (1990),
-	m_DelayL31_33 (187),
-	m_DelayL33_39 (1066),
+	m_DecayDiffuser55_59 (m_fDecayDiffusion2, ScaleDelay (2656)),
+	m_Delay63 (ScaleDelay (3163)),
+
+	m_DelayL48_54_1 (ScaleDelay (266)),
+	m_DelayL48_54_2 (ScaleDelay (2974)),
+	m_DelayL55_59 (ScaleDelay (1913)),
+	m_DelayL59_63 (ScaleDelay (1996)),
+	m_DelayL24_30 (ScaleDelay (1990)),
+	m_DelayL31_33 (ScaleDelay (187)),
+	m_DelayL33_39 (ScaleDelay (1066)),
 	m_fOutputLevelLeft (0.0f),
 
-	m_DelayR24_30_1 (353),
-	m_DelayR24_30_2 (3627),
-	m_DelayR31_33 (1228),
-	m_DelayR33_39 (2673),
-	m_DelayR48_54 (2111),
-	m_DelayR55_59 (335),
-	m_DelayR59_63 (121),
-	m_fOutputLevelRight (0.0f)
+	m_DelayR24_30_1 (ScaleDelay (353)),
+	m_DelayR24_30_2 (ScaleDelay (3627)),
+	m_DelayR31_33 (ScaleDelay (1228)),
+	m_DelayR33_39 (ScaleDelay (2673)),
+	m_DelayR48_54 (ScaleDelay (2111)),
+	m_DelayR55_59 (ScaleDelay (335)),
+	m_DelayR59_63 (ScaleDelay (121)),
+	m_fOutputLevelRight (0.0f),
+
+	m_nTailSamples (ScaleDelay (TailSamples)),
+	m_nSilentSamples (0)
 {
-	m_LFO23_24.SetWaveform (WaveformSine);
-	m_LFO23_24.SetFrequency (LFOFrequency23_24);
-
-	m_LFO46_48.SetWaveform (WaveformSine);
-	m_LFO46_48.SetFrequency (LFOFrequency46_48);
+	m_LFOParameters23_24.Waveform = WaveformSine;
+	m_LFOParameters23_24.fFrequency = LFOFrequency23_24;
+	m_LFOParameters23_24.nPhaseIncrement = COscillator::GetPhaseIncrement (LFOFrequency23_24);
+	m_LFOParameters23_24.fPitchFactor = 1.0f;
+	m_LFOParameters23_24.fModulationVolume = 0.0f;
+	m_LFOParameters23_24.nModulationIncrement = 0;
+	m_LFO23_24.SetParameters (&m_LFOParameters23_24);
+
+	m_LFOParameters46_48.Waveform = WaveformSine;
+	m_LFOParameters46_48.fFrequency = LFOFrequency46_48;
+	m_LFOParameters46_48.nPhaseIncrement = COscillator::GetPhaseIncrement (LFOFrequency46_48);
+	m_LFOParameters46_48.fPitchFactor = 1.0f;
+	m_LFOParameters46_48.fModulationVolume = 0.0f;
+	m_LFOParameters46_48.nModulationIncrement = 0;
+	m_LFO46_48.SetParameters (&m_LFOParameters46_48);
 }
 
-void CReverbModule::SetDecay (float fDecay)
+void CReverbModule::SetParameters (const TReverbParameters *pParameters)
 {
-	m_fDecay = fDecay;
+	assert (pParameters != 0);
+
+	m_fDecay = pParameters->fDecay;
+	m_fWetDryRatio = pParameters->fWetDryRatio;
 
-	m_fDecayDiffusion2 = ceilf (floorf ((m_fDecay + 0.15f) * 4.0f) / 2.0f) / 2.0f;
+	if (m_fDecayDiffusion2 != pParameters->fDecayDiffusion2)
+	{
+		m_fDecayDiffusion2 = pParameters->fDecayDiffusion2;
 
-	m_DecayDiffuser31_33.SetDiffusion (m_fDecayDiffusion2);
-	m_DecayDiffuser55_59.SetDiffusion (m_fDecayDiffusion2);
+		m_DecayDiffuser31_33.SetDiffusion (m_fDecayDiffusion2);
+		m_DecayDiffuser55_59.SetDiffusion (m_fDecayDiffusion2);
+	}
 }
 
-void CReverbModule::SetWetDryRatio (float fWetDryRatio)
+float CReverbModule::GetDecayDiffusion2 (float fDecay)
 {
-	m_fWetDryRatio = fWetDryRatio;
+	return ceilf (floorf ((fDecay + 0.15f) * 4.0f) / 2.0f) / 2.0f;
 }
 
 void CReverbModule::NextSample (float fInputLevel)
 {
+	PROFILE_BEGIN (ProfileUnitSample);
+
 	m_BandwidthAttenuator.NextSample (fInputLevel);
 
 	m_InputDiffuser13_14.NextSample (m_BandwidthAttenuator.GetOutputLevel ());
@@ -174,6 +210,8 @@ void CReverbModule::NextSample (float fInputLevel)
 	m_InputDiffuser15_16.NextSample (m_InputDiffuser19_20.GetOutputLevel ());
 	m_InputDiffuser21_22.NextSample (m_InputDiffuser15_16.GetOutputLevel ());
 
+	PROFILE_STAGE (ProfileStageReverbInput);
+
 	m_LFO23_24.NextSample ();
 	m_DecayDiffuser23_24.NextSample (  m_InputDiffuser21_22.GetOutputLevel ()
 					 + m_Delay63.GetOutputLevel ()*m_fDecay);
@@ -190,6 +228,8 @@ void CReverbModule::NextSample (float fInputLevel)
 	m_DecayDiffuser55_59.NextSample (m_Attenuator54.GetOutputLevel ()*m_fDecay);
 	m_Delay63.NextSample (m_DecayDiffuser55_59.GetOutputLevel ());
 
+	PROFILE_STAGE (ProfileStageReverbTank);
+
 	m_DelayL48_54_1.NextSample (m_DecayDiffuser46_48.GetOutputLevel ());
 	m_DelayL48_54_2.NextSample (m_Delay54.GetOutputLevel ());
 	m_DelayL55_59.NextSample (m_DecayDiffuser55_59.GetOutputLevel ());
@@ -226,4 +266,22 @@ void CReverbModule::NextSample (float fInputLevel)
 	fAccu -= m_DelayR59_63.GetOutputLevel ();
 	fAccu *= 0.6f;
 	m_fOutputLevelRight = fInputLevel*(1.0f-m_fWetDryRatio) + fAccu*m_fWetDryRatio;
+
+	// each sample in the tank passes the outputs of m_Delay39 and m_Delay63 once
+	// within m_nTailSamples, so the tail is gone, if these were quiet for so long
+	if (   fInputLevel == 0.0f
+	    && fabsf (m_Delay39.GetOutputLevel ()) < SilenceLevel
+	    && fabsf (m_Delay63.GetOutputLevel ()) < SilenceLevel)
+	{
+		if (m_nSilentSamples < m_nTailSamples)
+		{
+			m_nSilentSamples++;
+		}
+	}
+	else
+	{
+		m_nSilentSamples = 0;
+	}
+
+	PROFILE_STAGE (ProfileStageReverbOutput);
 }
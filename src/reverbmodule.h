@@ -25,6 +25,7 @@
 
 #include "synthmodule.h"
 #include "oscillator.h"
+#include <circle/types.h>
 
 class CReverbAttenuator
 {
@@ -79,18 +80,31 @@ private:
 	float m_fOutputLevel;
 };
 
+struct TReverbParameters
+{
+	float	fDecay;				// [0.0, 1.0)
+	float	fDecayDiffusion2;		// derived from fDecay
+	float	fWetDryRatio;			// [0.0, 1.0]
+};
+
 class CReverbModule
 {
 public:
 	CReverbModule (void);
 
-	void SetDecay (float fDecay);
-	void SetWetDryRatio (float fWetDryRatio);
+	// the parameters are copied
+	void SetParameters (const TReverbParameters *pParameters);
 
 	void NextSample (float fInputLevel);
 	float GetOutputLevelLeft (void) const	{ return m_fOutputLevelLeft; }
 	float GetOutputLevelRight (void) const	{ return m_fOutputLevelRight; }
 
+	// returns TRUE, if there was no input for a while and the tail has decayed
+	boolean IsSilent (void) const		{ return m_nSilentSamples >= m_nTailSamples; }
+
+	// helper to derive the parameters
+	static float GetDecayDiffusion2 (float fDecay);
+
 private:
 	const unsigned Excursion = 16;
 	const float DecayDiffusion1 = 0.7f;
@@ -100,6 +114,8 @@ private:
 	const float Damping = 0.0005f;
 	const float LFOFrequency23_24 = 0.5f;
 	const float LFOFrequency46_48 = 0.3f;
+	const float SilenceLevel = 0.00001f;
+	const unsigned TailSamples = 22000;	// > sum of the tank delays (at 48 kHz)
 
 private:
 	float m_fDecay;
@@ -112,6 +128,7 @@ private:
 	CReverbDiffuser m_InputDiffuser15_16;
 	CReverbDiffuser m_InputDiffuser21_22;
 
+	TOscillatorParameters m_LFOParameters23_24;
 	COscillator m_LFO23_24;
 	CReverbDiffuser m_DecayDiffuser23_24;
 	CReverbDelay m_Delay30;
@@ -119,6 +136,7 @@ private:
 	CReverbDiffuser m_DecayDiffuser31_33;
 	CReverbDelay m_Delay39;
 
+	TOscillatorParameters m_LFOParameters46_48;
 	COscillator m_LFO46_48;
 	CReverbDiffuser m_DecayDiffuser46_48;
 	CReverbDelay m_Delay54;
@@ -143,6 +161,9 @@ private:
 	CReverbDelay m_DelayR55_59;
 	CReverbDelay m_DelayR59_63;
 	float m_fOutputLevelRight;
+
+	unsigned m_nTailSamples;
+	unsigned m_nSilentSamples;
 };
 
 #endif
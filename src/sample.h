@@ -0,0 +1,144 @@
+//
+// sample.h
+//
+// Sample types of the voice modules
+//
+// MiniSynth Pi - A virtual analogue synthesizer for Raspberry Pi
+// Copyright (C) 2017-2023  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _sample_h
+#define _sample_h
+
+#include <circle/types.h>
+#include "config.h"
+
+// The modules of a voice are class templates, which take the sample type as
+// parameter. The float implementation is used by default. With FIXED_POINT_DSP
+// the voices use TQ15 samples instead, which do not need the VFP in the render
+// path. A TQ15 value is a Q15 fixed-point number (1.0 == 1 << 15), which is kept
+// in a 32-bit integer, so that intermediate results have enough headroom. The
+// oscillators, mixers and envelopes output [-1.0, 1.0) (or [0.0, 1.0)). The filter
+// and the amplifier saturate to [-4.0, 4.0), because the resonance of the filter
+// can exceed 1.0 like in the float implementation. The final output is saturated
+// after the voices have been mixed. Increments, which need more precision, are Q30
+// (TQ30) or Q16 (TQ16) numbers.
+
+typedef s32 TQ15;
+typedef u32 TQ16;
+typedef u32 TQ30;
+
+#define Q15_ONE		(1 << 15)
+#define Q15_MAX		(Q15_ONE - 1)
+#define Q15_MIN		(-Q15_ONE)
+
+#define Q15_WIDE_MAX	(4 * Q15_ONE - 1)	// with headroom for the resonance
+#define Q15_WIDE_MIN	(-4 * Q15_ONE)
+
+#define Q16_ONE		(1U << 16)
+#define Q30_ONE		(1U << 30)
+
+#ifdef FIXED_POINT_DSP
+	typedef TQ15 TVoiceSample;
+#else
+	typedef float TVoiceSample;
+#endif
+
+inline TQ15 Q15Saturate (s32 nValue)
+{
+#if AARCH == 32
+	s32 nResult;
+	asm ("ssat %0, #16, %1" : "=r" (nResult) : "r" (nValue));
+
+	return nResult;
+#else
+	return nValue > Q15_MAX ? Q15_MAX : (nValue < Q15_MIN ? Q15_MIN : nValue);
+#endif
+}
+
+inline TQ15 Q15SaturateWide (s32 nValue)
+{
+#if AARCH == 32
+	s32 nResult;
+	asm ("ssat %0, #18, %1" : "=r" (nResult) : "r" (nValue));
+
+	return nResult;
+#else
+	return nValue > Q15_WIDE_MAX ? Q15_WIDE_MAX : (nValue < Q15_WIDE_MIN ? Q15_WIDE_MIN : nValue);
+#endif
+}
+
+// one factor must be in [-1.0, 1.0], the other in [-2.0, 2.0), the product is not saturated
+inline TQ15 Q15Multiply (TQ15 nValue1, TQ15 nValue2)
+{
+	return (nValue1 * nValue2) >> 15;
+}
+
+inline TQ15 Q15FromFloat (float fValue)
+{
+	if (fValue >= 1.0f)
+	{
+		return Q15_MAX;
+	}
+
+	if (fValue <= -1.0f)
+	{
+		return Q15_MIN;
+	}
+
+	return (TQ15) (fValue * Q15_ONE);
+}
+
+inline float Q15ToFloat (TQ15 nValue)
+{
+	return nValue * (1.0f / Q15_ONE);
+}
+
+inline TQ16 Q16FromFloat (float fValue)		// fValue must be in [0.0, 65536.0)
+{
+	return (TQ16) (fValue * Q16_ONE + 0.5f);
+}
+
+inline TQ30 Q30FromFloat (float fValue)		// fValue must be in [0.0, 4.0)
+{
+	return (TQ30) (fValue * Q30_ONE + 0.5f);
+}
+
+// conversion of a sample of the given type from and to float
+
+template <typename TSample> TSample SampleFromFloat (float fValue);
+template <typename TSample> float SampleToFloat (TSample Value);
+
+template <> inline float SampleFromFloat<float> (float fValue)
+{
+	return fValue;
+}
+
+template <> inline float SampleToFloat<float> (float fValue)
+{
+	return fValue;
+}
+
+template <> inline TQ15 SampleFromFloat<TQ15> (float fValue)
+{
+	return Q15FromFloat (fValue);
+}
+
+template <> inline float SampleToFloat<TQ15> (TQ15 nValue)
+{
+	return Q15ToFloat (nValue);
+}
+
+#endif
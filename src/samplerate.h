@@ -0,0 +1,51 @@
+//
+// samplerate.h
+//
+// Sample rate of the synthesizer, which is selected at startup
+//
+// MiniSynth Pi - A virtual analogue synthesizer for Raspberry Pi
+// Copyright (C) 2017-2023  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _samplerate_h
+#define _samplerate_h
+
+#include <circle/types.h>
+#include "config.h"
+
+#define SAMPLE_RATE_MIN		22050
+#define SAMPLE_RATE_MAX		96000
+
+// The sample rate is SAMPLE_RATE_DEFAULT, or is given with the option
+// "samplerate=hz" in the file cmdline.txt. It must be set, before the synthesizer
+// (sound device, voices, reverb) is created and the patches are loaded. All values,
+// which depend on the sample rate (phase increments, increments, filter coefficients,
+// delay lengths), are derived from Get() then. The static tables of the modules are
+// rebuilt, when the next module is created, or with UpdateTables() of CFilter and
+// COscillator.
+
+class CSampleRate
+{
+public:
+	static void Set (unsigned nSampleRate);
+	static unsigned Get (void)			{ return s_nSampleRate; }
+
+	static boolean IsValid (unsigned nSampleRate);
+
+private:
+	static unsigned s_nSampleRate;
+};
+
+#endif
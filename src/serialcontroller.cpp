@@ -18,34 +18,115 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include "serialcontroller.h"
+#include "minisynth.h"
+#include "synthparameter.h"
+#include "patch.h"
 #include <circle/sysconfig.h>
-#include <circle/logger.h>
-#include <circle/string.h>
 #include <assert.h>
 
 #define CONTROLLER_BAUD 115200		// Set here the Baud Rate of the controller!
 
-static const char FromSerialController[] = "serial_ctrl";
+// A frame consists of five bytes:
+//	0x80			start
+//	0aaaaaaa		address of the parameter (see AddressMap[])
+//	0vvvvvvv		value bits 13-7
+//	0vvvvvvv		value bits 6-0
+//	110000pp		stop, bit 0 is the even parity of (value ^ address)
+// The 14-bit value 0..16383 is scaled to the range of the parameter.
+//
+// A batch frame sets several parameters, which are applied in the same chunk:
+//	0x81			batch start
+//	0nnnnnnn		number of values (1..MaxBatchSize)
+//	n * 0aaaaaaa 0vvvvvvv 0vvvvvvv
+//	0000000c 0ccccccc	CRC-8 (polynomial 0x07) of the count and all n * 3 bytes
+//	0xC0			stop
 
 const u8 StartSequence = 0x80;
+const u8 BatchStartSequence = 0x81;
 const u8 StopSequence = 0xC0;
 
+static const unsigned MaxControlValue = 0x3FFF;
+
+static const TSynthParameter AddressMap[] =
+{
+	LFOVCOWaveform,			// 0
+	LFOVCOFrequency,
+	VCO1Waveform,
+	VCO1ModulationVolume,
+	VCO1Octave,
+	VCO1FineTune,
+	LFOVCFWaveform,
+	LFOVCFFrequency,
+	VCFCutoffFrequency,		// 8
+	VCFResonance,
+	EGVCFAttack,
+	EGVCFDecay,
+	EGVCFSustain,
+	EGVCFRelease,
+	VCFModulationVolume,
+	LFOVCAWaveform,
+	LFOVCAFrequency,		// 16
+	EGVCAAttack,
+	EGVCADecay,
+	EGVCASustain,
+	EGVCARelease,
+	VCAModulationVolume,
+	ReverbDecay,
+	ReverbVolume,
+	SynthVolume,			// 24
+	MIDIChannel
+};
+
+static const unsigned Addresses = sizeof AddressMap / sizeof AddressMap[0];
+
+// parity of a byte (1 if the number of set bits is odd)
+#define P2(n)	n, n^1, n^1, n
+#define P4(n)	P2 (n), P2 (n^1), P2 (n^1), P2 (n)
+#define P6(n)	P4 (n), P4 (n^1), P4 (n^1), P4 (n)
+
+static const u8 ParityTable[256] = { P6 (0), P6 (1), P6 (1), P6 (0) };
+
+static inline u8 GetParity (u16 usValue)
+{
+	return ParityTable[usValue & 0xFF] ^ ParityTable[usValue >> 8];
+}
+
+static u8 CRCTable[256];
+
 CSerialController::CSerialController (CMiniSynthesizer *pSynthesizer, CInterruptSystem *pInterrupt)
-:
+:	m_pSynthesizer (pSynthesizer),
 #if RASPPI <= 3 && defined (USE_USB_FIQ)
 	m_Serial (pInterrupt, FALSE),
 #else
 	m_Serial (pInterrupt, TRUE),
 #endif
 	m_nSerialState (START),
-	m_uControlAddress(0),
-	m_uControlValue(0)
+	m_uControlAddress (0),
+	m_uControlValue (0),
+	m_nBatchSize (0),
+	m_nBatchCount (0),
+	m_uchBatchCRC (0),
+	m_uchReceivedCRC (0),
+	m_nFrames (0),
+	m_nErrors (0),
+	m_nParityErrors (0)
 {
+	for (unsigned i = 0; i < 256; i++)
+	{
+		u8 uchCRC = i;
+		for (unsigned nBit = 0; nBit < 8; nBit++)
+		{
+			uchCRC = uchCRC & 0x80 ? (uchCRC << 1) ^ 0x07 : uchCRC << 1;
+		}
+
+		CRCTable[i] = uchCRC;
+	}
 }
 
 CSerialController::~CSerialController (void)
 {
 	m_nSerialState = SERIAL_UNKNOWN;
+	m_pSynthesizer = 0;
 }
 
 boolean CSerialController::Initialize (void)
@@ -53,105 +134,204 @@ boolean CSerialController::Initialize (void)
 	return m_Serial.Initialize (CONTROLLER_BAUD);
 }
 
-void nibbleToHex(u8 nibble, char *string) {
-	nibble &= 0b00001111;
-	if (nibble < 10) {
-		string[0] = '0' + nibble;
-	} else {
-		string[0] = 'A' + nibble - 10;
+void CSerialController::Process (void)
+{
+	// Read all serial data, which has been received since the last call
+	u8 Buffer[100];
+	int nResult;
+	while ((nResult = m_Serial.Read (Buffer, sizeof Buffer)) > 0)
+	{
+		// Process Serial messages
+		for (int i = 0; i < nResult; i++)
+		{
+			ProcessByte (Buffer[i]);
+		}
 	}
 }
 
-void byteToHex(u8 byte, char *string) {
-	nibbleToHex((byte & 0b11110000) >> 4, string); 
-	nibbleToHex(byte & 0b00001111, string+1); 
-}
+void CSerialController::ProcessByte (u8 uchData)
+{
+	assert (m_pSynthesizer != 0);
 
-void bufferToHex(u8 *Buffer, int bufLen, char *bufferHex) {
-	for (int i = 0; i < bufLen; i++) {
-		byteToHex(Buffer[i], bufferHex+(i*2));
+	// If first bit is set (it is a control message), where data or the stop
+	// sequence is expected, there was an error, restart
+	if (   (uchData & 0x80)
+	    && m_nSerialState != START
+	    && (   (   m_nSerialState != READ_STOP
+		    && m_nSerialState != BATCH_READ_STOP)
+		|| (uchData & 0xC0) != StopSequence))
+	{
+		m_nErrors++;
+		m_nSerialState = START;
+
+		if (   uchData != StartSequence		// a new frame may start here
+		    && uchData != BatchStartSequence)
+		{
+			return;
+		}
 	}
-}
 
-bool evaluateParity(u16 valueToCheck, u8 parityBit) {
-	u8 parity, bit;
-    for (bit=0, parity=0; bit < 16; bit++) {
-        parity ^= (valueToCheck & (1<<bit)) ? 1 : 0;
-    }
-	parityBit &= 0x01;
-    return parity == parityBit;
-}
+	switch (m_nSerialState)
+	{
+	case START:
+		if (uchData == StartSequence)
+		{
+			m_nSerialState = READ_ADDRESS;
+			m_uControlAddress = 0;
+			m_uControlValue = 0;
+		}
+		else if (uchData == BatchStartSequence)
+		{
+			m_nSerialState = BATCH_READ_COUNT;
+		}
+		else
+		{
+			m_nErrors++;
+		}
+		break;
 
+	case READ_ADDRESS:
+	case BATCH_READ_ADDRESS:
+		m_uControlAddress = uchData;
+		m_nSerialState = m_nSerialState == READ_ADDRESS ? READ_VALUE1 : BATCH_READ_VALUE1;
+		break;
 
-void CSerialController::Process (void)
-{
-	// Read serial data
-	u8 Buffer[100];
-	int nResult = m_Serial.Read (Buffer, sizeof Buffer);
-	if (nResult <= 0)
-	{
-		return;
-	}
+	case READ_VALUE1:
+	case BATCH_READ_VALUE1:
+		m_uControlValue = uchData << 7;
+		m_nSerialState = m_nSerialState == READ_VALUE1 ? READ_VALUE2 : BATCH_READ_VALUE2;
+		break;
 
-	// For debugging: Print hex dump of serial
-	//char bufferHex[201];
-	//CLogger::Get ()->Write (FromSerialController, LogDebug, bufferHex);
+	case READ_VALUE2:
+		m_uControlValue |= uchData;
+		m_nSerialState = READ_STOP;
+		break;
 
-	// Process Serial messages
-	for (int i = 0; i < nResult; i++)
-	{
-		u8 uchData = Buffer[i];
-		
-		switch (m_nSerialState)
+	case READ_STOP:
+		m_nSerialState = START;
+
+		// If the stop sequence is incorrect there was an error, restart
+		if ((uchData & 0xC0) != StopSequence)
 		{
-		case START:
-			if (uchData == StartSequence) {
-				m_nSerialState = READ_ADDRESS;
-				m_uControlAddress = 0;
-				m_uControlValue = 0;
-			} else {
-				CLogger::Get ()->Write (FromSerialController, LogDebug, "error start");
-			}
+			m_nErrors++;
 			break;
-		case READ_ADDRESS:
-			// If first bit is set (it is a control message) there was an error, restart
-			if (uchData & (0b10000000)) {
-				m_nSerialState = START;
-				break;
-			}
-			m_uControlAddress = uchData;
-			m_nSerialState = READ_VALUE1;
-			break;
-		case READ_VALUE1:
-			if (uchData & 0b10000000) {
-				m_nSerialState = START;
-				break;
-			}
-			m_uControlValue = uchData << 7;
-			m_nSerialState = READ_VALUE2;
+		}
+
+		if (GetParity (m_uControlValue ^ m_uControlAddress) != (uchData & 0x01))
+		{
+			m_nParityErrors++;
 			break;
-		case READ_VALUE2:
-			if (uchData & 0b10000000) {
-				m_nSerialState = START;
-				break;
-			}
-			m_uControlValue |= uchData;
-			m_nSerialState = READ_STOP;
+		}
+
+		if (m_uControlAddress >= Addresses)
+		{
+			m_nErrors++;
 			break;
-		case READ_STOP:
-			// If the stop sequence is incorrect there was an error, restart
-			if ((uchData & 0b11000000) == StopSequence) {
-				if (evaluateParity(m_uControlValue ^ ((u16) m_uControlAddress), uchData & 0x01)) {
-					CString buf;
-					buf.Format("Reached STOP: Address %x Value %x", m_uControlAddress, m_uControlValue);
-					CLogger::Get ()->Write (FromSerialController, LogDebug, buf);
-				}
-			}
+		}
+
+		m_pSynthesizer->ParameterChange (AddressMap[m_uControlAddress],
+			CPatch::MapValue (AddressMap[m_uControlAddress],
+					  m_uControlValue, MaxControlValue));
+
+		m_nFrames++;
+		break;
+
+	case BATCH_READ_COUNT:
+		if (uchData == 0 || uchData > MaxBatchSize)
+		{
+			m_nErrors++;
 			m_nSerialState = START;
 			break;
-		default:
-			assert (0);
+		}
+		m_nBatchSize = uchData;
+		m_nBatchCount = 0;
+		m_uchBatchCRC = UpdateCRC (0, uchData);
+		m_nSerialState = BATCH_READ_ADDRESS;
+		break;
+
+	case BATCH_READ_VALUE2:
+		m_uControlValue |= uchData;
+
+		m_uchBatchCRC = UpdateCRC (m_uchBatchCRC, m_uControlAddress);
+		m_uchBatchCRC = UpdateCRC (m_uchBatchCRC, m_uControlValue >> 7);
+		m_uchBatchCRC = UpdateCRC (m_uchBatchCRC, uchData);
+
+		// unknown addresses are checked, after the whole batch is valid
+		assert (m_nBatchCount < MaxBatchSize);
+		m_BatchParameter[m_nBatchCount] =   m_uControlAddress < Addresses
+						  ? AddressMap[m_uControlAddress]
+						  : SynthParameterUnknown;
+		m_nBatchValue[m_nBatchCount] = m_uControlValue;
+
+		m_nSerialState = ++m_nBatchCount < m_nBatchSize ? BATCH_READ_ADDRESS
+								: BATCH_READ_CRC1;
+		break;
+
+	case BATCH_READ_CRC1:
+		m_uchReceivedCRC = uchData << 7;
+		m_nSerialState = BATCH_READ_CRC2;
+		break;
+
+	case BATCH_READ_CRC2:
+		m_uchReceivedCRC |= uchData;
+		m_nSerialState = BATCH_READ_STOP;
+		break;
+
+	case BATCH_READ_STOP:
+		m_nSerialState = START;
+
+		if (uchData != StopSequence)
+		{
+			m_nErrors++;
 			break;
 		}
+
+		if (m_uchReceivedCRC != m_uchBatchCRC)
+		{
+			m_nParityErrors++;
+			break;
+		}
+
+		for (unsigned i = 0; i < m_nBatchCount; i++)
+		{
+			if (m_BatchParameter[i] >= SynthParameterUnknown)
+			{
+				m_nErrors++;
+				return;
+			}
+
+			m_nBatchValue[i] = CPatch::MapValue (m_BatchParameter[i], m_nBatchValue[i],
+							     MaxControlValue);
+		}
+
+		// the whole batch gets applied at the beginning of the same chunk
+		m_pSynthesizer->ParameterChanges (m_BatchParameter, m_nBatchValue, m_nBatchCount);
+
+		m_nFrames++;
+		break;
+
+	default:
+		assert (0);
+		break;
 	}
 }
+
+u8 CSerialController::UpdateCRC (u8 uchCRC, u8 uchData)
+{
+	return CRCTable[uchCRC ^ uchData];
+}
+
+unsigned CSerialController::GetFrameCount (void) const
+{
+	return m_nFrames;
+}
+
+unsigned CSerialController::GetErrorCount (void) const
+{
+	return m_nErrors;
+}
+
+unsigned CSerialController::GetParityErrorCount (void) const
+{
+	return m_nParityErrors;
+}
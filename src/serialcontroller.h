@@ -23,6 +23,7 @@
 #include <circle/interrupt.h>
 #include <circle/serial.h>
 #include <circle/types.h>
+#include "synthparameter.h"
 
 class CMiniSynthesizer;
 
@@ -32,6 +33,13 @@ enum SerialState {
 	READ_VALUE1,
 	READ_VALUE2,
 	READ_STOP,
+	BATCH_READ_COUNT,
+	BATCH_READ_ADDRESS,
+	BATCH_READ_VALUE1,
+	BATCH_READ_VALUE2,
+	BATCH_READ_CRC1,
+	BATCH_READ_CRC2,
+	BATCH_READ_STOP,
 	SERIAL_UNKNOWN
 };
 
@@ -45,11 +53,36 @@ public:
 
 	void Process (void);
 
+	// statistics since boot
+	unsigned GetFrameCount (void) const;		// frames, which have been applied
+	unsigned GetErrorCount (void) const;		// framing errors and unknown addresses
+	unsigned GetParityErrorCount (void) const;	// including CRC errors of batches
+
+private:
+	void ProcessByte (u8 uchData);
+
+	static u8 UpdateCRC (u8 uchCRC, u8 uchData);
+
 private:
+	CMiniSynthesizer *m_pSynthesizer;
+
 	CSerialDevice m_Serial;
 	SerialState m_nSerialState;
 	u8 m_uControlAddress;
 	u16 m_uControlValue;
+
+	// a batch of parameter values, which is applied at once
+	static const unsigned MaxBatchSize = 64;
+	unsigned m_nBatchSize;
+	unsigned m_nBatchCount;				// received values
+	TSynthParameter m_BatchParameter[MaxBatchSize];
+	unsigned m_nBatchValue[MaxBatchSize];
+	u8 m_uchBatchCRC;
+	u8 m_uchReceivedCRC;
+
+	unsigned m_nFrames;
+	unsigned m_nErrors;
+	unsigned m_nParityErrors;
 };
 
 #endif
@@ -23,19 +23,18 @@
 
 CSerialMIDIDevice::CSerialMIDIDevice (CMiniSynthesizer *pSynthesizer, CInterruptSystem *pInterrupt,
 				      CSynthConfig *pConfig)
-:	CMIDIDevice (pSynthesizer, pConfig),
+:	CMIDIDevice (pSynthesizer, pConfig, NoteSourceSerialMIDI),
 #if RASPPI <= 3 && defined (USE_USB_FIQ)
 	m_Serial (pInterrupt, FALSE),
 #else
 	m_Serial (pInterrupt, TRUE),
 #endif
-	m_nSerialState (0)
+	m_Parser (MessageHandler, this)
 {
 }
 
 CSerialMIDIDevice::~CSerialMIDIDevice (void)
 {
-	m_nSerialState = 255;
 }
 
 boolean CSerialMIDIDevice::Initialize (void)
@@ -45,54 +44,21 @@ boolean CSerialMIDIDevice::Initialize (void)
 
 void CSerialMIDIDevice::Process (void)
 {
-	// Read serial MIDI data
+	// Read all serial MIDI data, which has been received since the last call
 	u8 Buffer[100];
-	int nResult = m_Serial.Read (Buffer, sizeof Buffer);
-	if (nResult <= 0)
+	int nResult;
+	while ((nResult = m_Serial.Read (Buffer, sizeof Buffer)) > 0)
 	{
-		return;
+		// Process MIDI messages
+		// See: https://www.midi.org/specifications/item/table-1-summary-of-midi-message
+		m_Parser.Parse (Buffer, nResult);
 	}
+}
 
-	// Process MIDI messages
-	// See: https://www.midi.org/specifications/item/table-1-summary-of-midi-message
-	for (int i = 0; i < nResult; i++)
-	{
-		u8 uchData = Buffer[i];
-
-		switch (m_nSerialState)
-		{
-		case 0:
-		MIDIRestart:
-			if (   (uchData & 0x80) == 0x80		// status byte, all channels
-			    && (uchData & 0xF0) != 0xF0)	// ignore system messages
-			{
-				m_SerialMessage[m_nSerialState++] = uchData;
-			}
-			break;
-
-		case 1:
-		case 2:
-			if (uchData & 0x80)			// got status when parameter expected
-			{
-				m_nSerialState = 0;
-
-				goto MIDIRestart;
-			}
-
-			m_SerialMessage[m_nSerialState++] = uchData;
-
-			if (   (m_SerialMessage[0] & 0xE0) == 0xC0
-			    || m_nSerialState == 3)		// message is complete
-			{
-				MIDIMessageHandler (m_SerialMessage, m_nSerialState);
-
-				m_nSerialState = 0;
-			}
-			break;
+void CSerialMIDIDevice::MessageHandler (const u8 *pMessage, size_t nLength, void *pParam)
+{
+	CSerialMIDIDevice *pThis = (CSerialMIDIDevice *) pParam;
+	assert (pThis != 0);
 
-		default:
-			assert (0);
-			break;
-		}
-	}
+	pThis->MIDIMessageHandler (pMessage, nLength);
 }
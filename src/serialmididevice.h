@@ -21,6 +21,7 @@
 #define _serialmididevice_h
 
 #include "mididevice.h"
+#include "midiparser.h"
 #include <circle/interrupt.h>
 #include <circle/serial.h>
 #include <circle/types.h>
@@ -39,9 +40,11 @@ public:
 	void Process (void);
 
 private:
-	CSerialDevice m_Serial;
-	unsigned m_nSerialState;
-	u8 m_SerialMessage[3];
+	static void MessageHandler (const u8 *pMessage, size_t nLength, void *pParam);
+
+private:
+	CSerialDevice m_Serial;			// received data is buffered by its IRQ handler
+	CMIDIParser m_Parser;
 };
 
 #endif
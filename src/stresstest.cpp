@@ -0,0 +1,433 @@
+//
+// stresstest.cpp
+//
+// MiniSynth Pi - A virtual analogue synthesizer for Raspberry Pi
+// Copyright (C) 2017-2023  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "stresstest.h"
+
+#ifdef STRESS_TEST
+
+#include "minisynth.h"
+#include "renderstatistics.h"
+#include "midiccmap.h"
+#include "patch.h"
+#include <circle/logger.h>
+#include <circle/timer.h>
+#include <assert.h>
+
+#define MIDI_NOTE_OFF		0b1000
+#define MIDI_NOTE_ON		0b1001
+#define MIDI_CONTROL_CHANGE	0b1011
+#define MIDI_PROGRAM_CHANGE	0b1100
+
+#define SETTLE_MSECS		500		// for the release of the previous pattern
+
+#define RETRIGGER_KEY		60
+#define CHORD_ROOT_KEY		36
+#define SWEEP_STEPS		(2*127)		// 0..127..1
+
+static const char FromStressTest[] = "stress";
+
+static const char *PatternName[StressPatternUnknown] =
+{
+	"chords", "retrigger", "CC sweep", "program storm"
+};
+
+static const unsigned StepMicros[StressPatternUnknown] =
+{
+	200000, 2000, 1000, 20000
+};
+
+CStressTest::CStressTest (CMiniSynthesizer *pSynthesizer, CSynthConfig *pConfig,
+			  unsigned nPatternSecs)
+:	CMIDIDevice (pSynthesizer, pConfig, NoteSourceStressTest),
+	m_pSynthesizer (pSynthesizer),
+	m_pConfig (pConfig),
+	m_nPatternTicks (nPatternSecs * CLOCKHZ),
+	m_State (StateFinished),
+	m_nStartPatch (pConfig->GetActivePatchNumber ()),
+	m_nPatch (0),
+	m_ucChannel (0),
+	m_Pattern (StressPatternChords),
+	m_nStateTicks (0),
+	m_nNextStepTicks (0),
+	m_nStep (0),
+	m_nHeldKeys (0),
+	m_ucCC (0),
+	m_SweptParameter (SynthParameterUnknown),
+	m_nSavedValue (0),
+	m_nStormProgram (0),
+	m_nTotalUnderruns (0)
+{
+	assert (nPatternSecs > 0);
+
+	m_ucChannel = GetReceiveChannel (pConfig->GetActivePatch ());
+
+	CLogger::Get ()->Write (FromStressTest, LogNotice,
+				"Starting stress test (%u patches, %u s per pattern)",
+				PATCHES, nPatternSecs);
+
+	StartPatch (0);
+}
+
+CStressTest::~CStressTest (void)
+{
+	m_pSynthesizer = 0;
+	m_pConfig = 0;
+}
+
+void CStressTest::Process (void)
+{
+	assert (m_pConfig != 0);
+	assert (m_pSynthesizer != 0);
+
+	unsigned nTicks = CTimer::GetClockTicks ();
+
+	switch (m_State)
+	{
+	case StateLoadPatch:
+		if (m_pConfig->GetActivePatchNumber () == m_nPatch)
+		{
+			m_State = StateSettle;
+			m_nStateTicks = nTicks;
+		}
+		break;
+
+	case StateSettle:
+		if (nTicks - m_nStateTicks >= SETTLE_MSECS * (CLOCKHZ / 1000))
+		{
+			CRenderStatistics Statistics;
+			m_pSynthesizer->GetStatistics (&Statistics, TRUE);
+
+			StartPattern (nTicks);
+		}
+		break;
+
+	case StatePattern:
+		if (nTicks - m_nStateTicks >= m_nPatternTicks)
+		{
+			EndPattern ();
+		}
+		else if ((int) (nTicks - m_nNextStepTicks) >= 0)
+		{
+			StepPattern ();
+			m_nStep++;
+
+			// do not try to catch up, if the main loop has been blocked
+			m_nNextStepTicks += StepMicros[m_Pattern] / (1000000 / CLOCKHZ);
+			if ((int) (nTicks - m_nNextStepTicks) > 0)
+			{
+				m_nNextStepTicks = nTicks;
+			}
+		}
+		break;
+
+	case StateFinished:
+		break;
+	}
+}
+
+boolean CStressTest::IsFinished (void) const
+{
+	return m_State == StateFinished;
+}
+
+const char *CStressTest::GetPatternName (TStressPattern Pattern)
+{
+	assert (Pattern < StressPatternUnknown);
+	return PatternName[Pattern];
+}
+
+void CStressTest::StartPatch (unsigned nPatch)
+{
+	assert (nPatch < PATCHES);
+	m_nPatch = nPatch;
+	m_Pattern = StressPatternChords;
+
+	// loads the patch now, so that the program change can be applied at once
+	assert (m_pConfig != 0);
+	CPatch *pPatch = m_pConfig->GetPatch (nPatch);
+	assert (pPatch != 0);
+
+	SendProgramChange ((u8) nPatch);		// on the channel of the previous patch
+
+	m_ucChannel = GetReceiveChannel (pPatch);
+
+	m_State = StateLoadPatch;
+}
+
+void CStressTest::StartPattern (unsigned nTicks)
+{
+	m_State = StatePattern;
+	m_nStateTicks = nTicks;
+	m_nNextStepTicks = nTicks;
+	m_nStep = 0;
+
+	switch (m_Pattern)
+	{
+	case StressPatternCCSweep:
+		PlayChord (CHORD_ROOT_KEY);
+
+		m_ucCC = 0;
+		if (FindNextCC ())
+		{
+			BeginSweep ();
+		}
+		break;
+
+	case StressPatternProgramStorm:
+		PlayChord (CHORD_ROOT_KEY);
+
+		m_nStormProgram = m_nPatch;
+		break;
+
+	default:
+		break;
+	}
+}
+
+void CStressTest::StepPattern (void)
+{
+	switch (m_Pattern)
+	{
+	case StressPatternChords:
+		ReleaseChord ();
+		PlayChord (CHORD_ROOT_KEY + m_nStep*5 % 24);
+		break;
+
+	case StressPatternRetrigger:
+		if (m_nStep & 1)
+		{
+			SendNoteOff (RETRIGGER_KEY);
+		}
+		else
+		{
+			SendNoteOn (RETRIGGER_KEY);
+		}
+		break;
+
+	case StressPatternCCSweep:
+		if (m_ucCC != 0)			// otherwise no MIDI CC is mapped
+		{
+			unsigned nPos = m_nStep % SWEEP_STEPS;
+			if (   nPos == 0
+			    && m_nStep > 0)
+			{
+				EndSweep ();
+
+				if (!FindNextCC ())
+				{
+					m_ucCC = 0;		// start over
+					FindNextCC ();
+				}
+
+				BeginSweep ();
+			}
+
+			SendControlChange (m_ucCC, nPos <= 127 ? nPos : SWEEP_STEPS - nPos);
+		}
+		break;
+
+	case StressPatternProgramStorm:
+		m_nStormProgram = GetNextStormProgram ();
+		SendProgramChange ((u8) m_nStormProgram);
+		break;
+
+	default:
+		assert (0);
+		break;
+	}
+}
+
+void CStressTest::EndPattern (void)
+{
+	ReleaseChord ();
+
+	switch (m_Pattern)
+	{
+	case StressPatternRetrigger:
+		SendNoteOff (RETRIGGER_KEY);
+		break;
+
+	case StressPatternCCSweep:
+		if (m_ucCC != 0)
+		{
+			EndSweep ();
+		}
+		break;
+
+	case StressPatternProgramStorm:
+		SendProgramChange ((u8) m_nPatch);	// is loaded, applied at once
+		break;
+
+	default:
+		break;
+	}
+
+	assert (m_pSynthesizer != 0);
+	CRenderStatistics Statistics;
+	m_pSynthesizer->GetStatistics (&Statistics, TRUE);
+
+	m_nTotalUnderruns += Statistics.GetUnderrunCount ();
+
+	CLogger::Get ()->Write (FromStressTest, LogNotice,
+				"Patch %u, %s: %u chunks, %u underruns, render p50 %u%% "
+				"p99 %u%% max %u%%, %u voices peak, %u steals",
+				m_nPatch, PatternName[m_Pattern],
+				Statistics.GetChunkCount (), Statistics.GetUnderrunCount (),
+				Statistics.GetRenderPercentile (0, 50),
+				Statistics.GetRenderPercentile (0, 99),
+				Statistics.GetMaxRenderPercent (0),
+				Statistics.GetPeakVoices (), Statistics.GetVoiceSteals ());
+
+	m_Pattern = (TStressPattern) (m_Pattern + 1);
+	if (m_Pattern < StressPatternUnknown)
+	{
+		m_State = StateSettle;
+		m_nStateTicks = CTimer::GetClockTicks ();
+	}
+	else if (m_nPatch+1 < PATCHES)
+	{
+		StartPatch (m_nPatch+1);
+	}
+	else
+	{
+		SendProgramChange ((u8) m_nStartPatch);
+
+		CLogger::Get ()->Write (FromStressTest, LogNotice,
+					"Stress test completed, %u underruns", m_nTotalUnderruns);
+
+		m_State = StateFinished;
+	}
+}
+
+void CStressTest::PlayChord (u8 ucRootKey)
+{
+	assert (m_nHeldKeys == 0);
+
+	// minor thirds, so that all voices are used
+	for (unsigned i = 0; i < VOICES; i++)
+	{
+		u8 ucKeyNumber = ucRootKey + 3*i;
+		assert (ucKeyNumber <= 127);
+
+		SendNoteOn (ucKeyNumber);
+		m_ucHeldKeys[m_nHeldKeys++] = ucKeyNumber;
+	}
+}
+
+void CStressTest::ReleaseChord (void)
+{
+	while (m_nHeldKeys > 0)
+	{
+		SendNoteOff (m_ucHeldKeys[--m_nHeldKeys]);
+	}
+}
+
+void CStressTest::BeginSweep (void)
+{
+	assert (m_pConfig != 0);
+	assert (m_SweptParameter < SynthParameterUnknown);
+	m_nSavedValue = m_pConfig->GetActivePatch ()->GetParameter (m_SweptParameter);
+}
+
+void CStressTest::EndSweep (void)
+{
+	assert (m_pSynthesizer != 0);
+	assert (m_SweptParameter < SynthParameterUnknown);
+	m_pSynthesizer->ParameterChange (m_SweptParameter, m_nSavedValue);
+}
+
+boolean CStressTest::FindNextCC (void)
+{
+	assert (m_pConfig != 0);
+
+	for (unsigned nCC = m_ucCC < MIDICC_MIN ? MIDICC_MIN : m_ucCC+1; nCC <= MIDICC_MAX; nCC++)
+	{
+		TSynthParameter Parameter = m_pConfig->MapMIDICC ((u8) nCC);
+
+		// sweeping the MIDI channel would disconnect the stress test
+		if (   Parameter < SynthParameterUnknown
+		    && Parameter != MIDIChannel)
+		{
+			m_ucCC = (u8) nCC;
+			m_SweptParameter = Parameter;
+
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+unsigned CStressTest::GetNextStormProgram (void)
+{
+	assert (m_pConfig != 0);
+
+	// the patch must be loaded and receive on the channel of the tested patch
+	unsigned nPatch = m_nStormProgram;
+	do
+	{
+		nPatch = (nPatch + 1) % PATCHES;
+		if (m_pConfig->IsPatchLoaded (nPatch))
+		{
+			unsigned nChannel = m_pConfig->GetPatch (nPatch)->GetParameter (MIDIChannel);
+			if (   nChannel == 0
+			    || nChannel == m_ucChannel+1u)
+			{
+				break;
+			}
+		}
+	}
+	while (nPatch != m_nStormProgram);
+
+	return nPatch;
+}
+
+u8 CStressTest::GetReceiveChannel (CPatch *pPatch)
+{
+	assert (pPatch != 0);
+	unsigned nChannel = pPatch->GetParameter (MIDIChannel);
+
+	return nChannel != 0 ? (u8) (nChannel-1) : 0;	// Omni mode receives on all
+}
+
+void CStressTest::SendNoteOn (u8 ucKeyNumber)
+{
+	u8 Message[] = {(u8) (MIDI_NOTE_ON << 4 | m_ucChannel), ucKeyNumber, VELOCITY_DEFAULT};
+	MIDIMessageHandler (Message, sizeof Message);
+}
+
+void CStressTest::SendNoteOff (u8 ucKeyNumber)
+{
+	u8 Message[] = {(u8) (MIDI_NOTE_OFF << 4 | m_ucChannel), ucKeyNumber, 0};
+	MIDIMessageHandler (Message, sizeof Message);
+}
+
+void CStressTest::SendControlChange (u8 ucFunction, u8 ucValue)
+{
+	u8 Message[] = {(u8) (MIDI_CONTROL_CHANGE << 4 | m_ucChannel), ucFunction, ucValue};
+	MIDIMessageHandler (Message, sizeof Message);
+}
+
+void CStressTest::SendProgramChange (u8 ucProgram)
+{
+	u8 Message[] = {(u8) (MIDI_PROGRAM_CHANGE << 4 | m_ucChannel), ucProgram, 0};
+	MIDIMessageHandler (Message, 2);		// the handler reads the third byte
+}
+
+#endif
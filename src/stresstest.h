@@ -0,0 +1,128 @@
+//
+// stresstest.h
+//
+// Synthetic load generator, which plays test patterns on each patch
+//
+// MiniSynth Pi - A virtual analogue synthesizer for Raspberry Pi
+// Copyright (C) 2017-2023  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _stresstest_h
+#define _stresstest_h
+
+#include "config.h"
+
+#ifdef STRESS_TEST
+
+#include "mididevice.h"
+#include "synthconfig.h"
+#include "synthparameter.h"
+#include "voicemanager.h"
+#include "patch.h"
+#include <circle/types.h>
+
+class CMiniSynthesizer;
+
+enum TStressPattern
+{
+	StressPatternChords,			// chords of VOICES keys, changed every 200 ms
+	StressPatternRetrigger,			// one key, struck every 4 ms
+	StressPatternCCSweep,			// each mapped MIDI CC swept up and down
+	StressPatternProgramStorm,		// program change every 20 ms
+	StressPatternUnknown
+};
+
+// The stress test injects MIDI messages through the normal CMIDIDevice path, on
+// the MIDI channel of the tested patch, as if they were received from a keyboard.
+// Each patch of the bank is activated with a program change and each pattern is
+// played for the given time. The render statistics are reset before and logged
+// after each pattern (underruns, render time percentiles of core 0 in percent of
+// the chunk period, voice steals). The parameters, which are modified by the CC
+// sweep, are restored afterwards. The test is started with the option
+// "stresstest=seconds" in the file cmdline.txt and runs once.
+
+class CStressTest : public CMIDIDevice
+{
+public:
+	CStressTest (CMiniSynthesizer *pSynthesizer, CSynthConfig *pConfig, unsigned nPatternSecs);
+	~CStressTest (void);
+
+	void Process (void);				// call from the main loop
+
+	boolean IsFinished (void) const;
+
+	static const char *GetPatternName (TStressPattern Pattern);
+
+private:
+	void StartPatch (unsigned nPatch);
+	void StartPattern (unsigned nTicks);
+	void StepPattern (void);
+	void EndPattern (void);
+
+	void PlayChord (u8 ucRootKey);
+	void ReleaseChord (void);
+
+	void BeginSweep (void);
+	void EndSweep (void);
+	boolean FindNextCC (void);			// sets m_ucCC, returns FALSE if none left
+
+	unsigned GetNextStormProgram (void);
+
+	static u8 GetReceiveChannel (CPatch *pPatch);
+
+	void SendNoteOn (u8 ucKeyNumber);
+	void SendNoteOff (u8 ucKeyNumber);
+	void SendControlChange (u8 ucFunction, u8 ucValue);
+	void SendProgramChange (u8 ucProgram);
+
+private:
+	CMiniSynthesizer *m_pSynthesizer;
+	CSynthConfig *m_pConfig;
+
+	unsigned m_nPatternTicks;
+
+	enum TState
+	{
+		StateLoadPatch,				// waiting for the program change
+		StateSettle,				// waiting for the previous pattern to decay
+		StatePattern,
+		StateFinished
+	};
+
+	TState m_State;
+	unsigned m_nStartPatch;				// active before the test
+
+	unsigned m_nPatch;				// tested patch
+	u8 m_ucChannel;					// of this patch
+	TStressPattern m_Pattern;
+	unsigned m_nStateTicks;				// start of the state
+	unsigned m_nNextStepTicks;
+	unsigned m_nStep;
+
+	u8 m_ucHeldKeys[VOICES];			// keys of the current chord
+	unsigned m_nHeldKeys;
+
+	u8 m_ucCC;					// swept MIDI CC
+	TSynthParameter m_SweptParameter;
+	unsigned m_nSavedValue;				// of the swept parameter
+
+	unsigned m_nStormProgram;			// last program of the storm
+
+	unsigned m_nTotalUnderruns;
+};
+
+#endif
+
+#endif
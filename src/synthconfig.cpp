@@ -19,18 +19,39 @@
 //
 #include "synthconfig.h"
 #include "config.h"
-#include <circle/string.h>
+#include <circle/timer.h>
+#include <circle/logger.h>
+#include <circle/util.h>
 #include <assert.h>
 
+#define FILE_WRITE_CHUNK_SIZE	512			// bytes per Process() call
+#define BANK_WRITE_DELAY	(3 * CLOCKHZ)		// coalesce modifications in this time
+
+static const char FromSynthConfig[] = "config";
+
 CSynthConfig::CSynthConfig (FATFS *pFileSystem)
 :	m_pFileSystem (pFileSystem),
 	m_nActivePatch (0),
+	m_PatchBank (pFileSystem),
+	m_nNextPrefetch (0),
+	m_nNextWrite (0),
+	m_WriteStep (FileWriteIdle),
+	m_nWritePatch (PATCHES),
+	m_pWriteBuffer (0),
+	m_nWriteSize (0),
+	m_nWriteOffset (0),
+	m_bBankModified (FALSE),
+	m_nBankModifiedTicks (0),
 	m_VelocityCurve (pFileSystem),
-	m_MIDICCMap (pFileSystem)
+	m_MIDICCMap (pFileSystem),
+	m_PartMap (pFileSystem),
+	m_ZoneMap (pFileSystem),
+	m_Tuning (pFileSystem)
 {
 	for (unsigned i = 0; i < PATCHES; i++)
 	{
 		m_pPatch[i] = 0;
+		m_SaveStatus[i] = PatchSaveIdle;
 	}
 }
 
@@ -47,29 +68,197 @@ boolean CSynthConfig::Load (void)
 {
 	assert (m_pFileSystem != 0);
 
-	const char *pPath = DRIVE "/patches";
-	if (f_stat (pPath, 0) != FR_OK)
+	m_PatchPath = DRIVE "/patches";
+	if (f_stat (m_PatchPath, 0) != FR_OK)
 	{
-		pPath = DRIVE;
+		m_PatchPath = DRIVE;
 	}
 
-	for (unsigned i = 0; i < PATCHES; i++)
+	m_BankFileName.Format ("%s/patches.bin", (const char *) m_PatchPath);
+
+	boolean bOK = m_VelocityCurve.Load ();
+
+	bOK = m_MIDICCMap.Load () && bOK;
+
+	m_PartMap.Load ();			// optional
+	m_ZoneMap.Load ();			// optional
+
+	if (m_Tuning.Load ())			// optional
 	{
-		CString FileName;
-		FileName.Format ("%s/patch%u.txt", pPath, i);
+		COscillator::SetTuning (m_Tuning.GetKeyFrequencies ());
+	}
 
-		assert (m_pPatch[i] == 0);
-		m_pPatch[i] = new CPatch (FileName, m_pFileSystem);
-		assert (m_pPatch[i] != 0);
+	return bOK;
+}
+
+boolean CSynthConfig::LoadPatches (void)
+{
+	unsigned nStartTicks = CTimer::GetClockTicks ();
+
+	boolean bOK = m_PatchBank.Load (m_BankFileName);
+	if (!bOK)
+	{
+		CLogger::Get ()->Write (FromSynthConfig, LogNotice, "No valid patch bank");
 	}
 
-	boolean bOK = m_VelocityCurve.Load ();
+	boolean bFromBank = LoadPatch (0);
 
-	bOK = m_MIDICCMap.Load () && bOK;
+	// the time includes loading the bank
+	CLogger::Get ()->Write (FromSynthConfig, LogNotice, "Patch 0 loaded from %s in %u us",
+				bFromBank ? "binary bank" : "text file",
+				(CTimer::GetClockTicks () - nStartTicks) / (CLOCKHZ / 1000000));
+
+	// the patches of the parts and zones are needed before the first MIDI message
+	nStartTicks = CTimer::GetClockTicks ();
+	unsigned nPatches = 0;
+	unsigned nFromBank = 0;
+
+	for (unsigned nPart = 1; nPart < PARTS; nPart++)
+	{
+		if (   (m_PartMap.GetEnabledParts () & (1 << nPart))
+		    && m_pPatch[m_PartMap.GetPatch (nPart)] == 0)
+		{
+			nFromBank += LoadPatch (m_PartMap.GetPatch (nPart)) ? 1 : 0;
+			nPatches++;
+		}
+	}
+
+	for (unsigned nZone = 0; nZone < ZONES; nZone++)
+	{
+		if (   (m_ZoneMap.GetEnabledZones () & (1 << nZone))
+		    && m_pPatch[m_ZoneMap.GetZone (nZone)->nPatch] == 0)
+		{
+			nFromBank += LoadPatch (m_ZoneMap.GetZone (nZone)->nPatch) ? 1 : 0;
+			nPatches++;
+		}
+	}
+
+	if (nPatches > 0)
+	{
+		CLogger::Get ()->Write (FromSynthConfig, LogNotice,
+					"%u part/zone patches loaded (%u from binary bank, %u from "
+					"text file) in %u us", nPatches, nFromBank, nPatches - nFromBank,
+					(CTimer::GetClockTicks () - nStartTicks) / (CLOCKHZ / 1000000));
+	}
 
 	return bOK;
 }
 
+#ifdef PATCH_LOAD_BENCHMARK
+
+void CSynthConfig::RunPatchLoadBenchmark (void)
+{
+	// Both runs load all patches into temporary objects, as LoadPatch() does it,
+	// including the f_stat() of each text file. The bank run reads the bank once and
+	// takes the records, which are up-to-date. The other records are not counted.
+	CPatchBank PatchBank (m_pFileSystem);
+
+	unsigned nStartTicks = CTimer::GetClockTicks ();
+
+	if (!PatchBank.Load (m_BankFileName))
+	{
+		CLogger::Get ()->Write (FromSynthConfig, LogNotice,
+					"No valid patch bank, boot again to compare");
+
+		return;
+	}
+
+	unsigned nFromBank = 0;
+	for (unsigned nPatch = 0; nPatch < PATCHES; nPatch++)
+	{
+		CString FileName;
+		GetPatchFileName (&FileName, nPatch, "txt");
+
+		FILINFO TextFileInfo;
+		if (f_stat (FileName, &TextFileInfo) != FR_OK)
+		{
+			memset (&TextFileInfo, 0, sizeof TextFileInfo);
+		}
+
+		CPatch *pPatch = new CPatch (FileName, m_pFileSystem);
+		assert (pPatch != 0);
+
+		if (PatchBank.GetPatch (nPatch, pPatch, &TextFileInfo))
+		{
+			nFromBank++;
+		}
+
+		delete pPatch;
+	}
+
+	unsigned nBankTicks = CTimer::GetClockTicks () - nStartTicks;
+
+	nStartTicks = CTimer::GetClockTicks ();
+
+	for (unsigned nPatch = 0; nPatch < PATCHES; nPatch++)
+	{
+		CString FileName;
+		GetPatchFileName (&FileName, nPatch, "txt");
+
+		FILINFO TextFileInfo;
+		f_stat (FileName, &TextFileInfo);
+
+		CPatch *pPatch = new CPatch (FileName, m_pFileSystem);
+		assert (pPatch != 0);
+
+		pPatch->Load ();
+
+		delete pPatch;
+	}
+
+	unsigned nTextTicks = CTimer::GetClockTicks () - nStartTicks;
+
+	CLogger::Get ()->Write (FromSynthConfig, LogNotice,
+				"%u patches: binary bank %u us (%u up-to-date), text files %u us",
+				PATCHES, nBankTicks / (CLOCKHZ / 1000000), nFromBank,
+				nTextTicks / (CLOCKHZ / 1000000));
+}
+
+#endif
+
+void CSynthConfig::Process (void)
+{
+	// saving has priority, the patch bank is written at last, so that modifications
+	// in short succession are written once
+	if (   m_WriteStep == FileWriteIdle
+	    && !StartPatchWrite ()
+	    && !PrefetchPatches ())
+	{
+		StartBankWrite ();
+	}
+
+	if (m_WriteStep != FileWriteIdle)
+	{
+		WriteStep ();
+	}
+}
+
+boolean CSynthConfig::PrefetchPatches (void)
+{
+	if (m_nNextPrefetch >= PATCHES)
+	{
+		return FALSE;
+	}
+
+	while (m_pPatch[m_nNextPrefetch] != 0)
+	{
+		if (++m_nNextPrefetch >= PATCHES)
+		{
+			return FALSE;		// the bank can be written now
+		}
+	}
+
+	LoadPatch (m_nNextPrefetch);
+
+	return TRUE;
+}
+
+boolean CSynthConfig::IsPatchLoaded (unsigned nPatch) const
+{
+	assert (nPatch < PATCHES);
+	return m_pPatch[nPatch] != 0;
+}
+
 unsigned CSynthConfig::GetActivePatchNumber (void) const
 {
 	return m_nActivePatch;
@@ -91,10 +280,110 @@ CPatch *CSynthConfig::GetActivePatch (void)
 CPatch *CSynthConfig::GetPatch (unsigned nPatch)
 {
 	assert (nPatch < PATCHES);
+	if (m_pPatch[nPatch] == 0)
+	{
+		LoadPatch (nPatch);
+	}
+
 	assert (m_pPatch[nPatch] != 0);
 	return m_pPatch[nPatch];
 }
 
+u16 CSynthConfig::GetEnabledParts (void) const
+{
+	return m_PartMap.GetEnabledParts () | 1;
+}
+
+u16 CSynthConfig::GetChannelParts (u8 ucChannel)
+{
+	assert (ucChannel < 16);
+	unsigned nChannel = ucChannel + 1;
+
+	u16 usParts = 0;
+
+	unsigned nActiveChannel = GetActivePatch ()->GetParameter (MIDIChannel);
+	if (   nActiveChannel == 0			// Omni mode
+	    || nActiveChannel == nChannel)
+	{
+		usParts = 1;
+	}
+
+	for (u16 usMask = m_PartMap.GetEnabledParts (); usMask != 0; usMask &= usMask-1)
+	{
+		unsigned nPart = __builtin_ctz (usMask);
+		if (m_PartMap.GetChannel (nPart) == nChannel)
+		{
+			usParts |= 1 << nPart;
+		}
+	}
+
+	return usParts;
+}
+
+unsigned CSynthConfig::GetPartPatchNumber (unsigned nPart) const
+{
+	assert (nPart < PARTS);
+	return nPart == 0 ? m_nActivePatch : m_PartMap.GetPatch (nPart);
+}
+
+void CSynthConfig::SetPartPatchNumber (unsigned nPart, unsigned nPatch)
+{
+	assert (nPart < PARTS);
+	if (nPart == 0)
+	{
+		SetActivePatchNumber (nPatch);
+	}
+	else
+	{
+		m_PartMap.SetPatch (nPart, nPatch);
+	}
+}
+
+CPatch *CSynthConfig::GetPartPatch (unsigned nPart)
+{
+	unsigned nPatch = GetPartPatchNumber (nPart);
+	assert (nPatch < PATCHES);
+	assert (m_pPatch[nPatch] != 0);
+	return m_pPatch[nPatch];
+}
+
+u8 CSynthConfig::GetEnabledZones (void) const
+{
+	return m_ZoneMap.GetEnabledZones ();
+}
+
+u8 CSynthConfig::GetKeyZones (u8 ucKeyNumber, u8 ucVelocity) const
+{
+	return m_ZoneMap.GetZones (ucKeyNumber, ucVelocity);
+}
+
+int CSynthConfig::GetZoneTranspose (unsigned nZone) const
+{
+	return m_ZoneMap.GetZone (nZone)->nTranspose;
+}
+
+CPatch *CSynthConfig::GetZonePatch (unsigned nZone)
+{
+	unsigned nPatch = m_ZoneMap.GetZone (nZone)->nPatch;
+	assert (nPatch < PATCHES);
+	assert (m_pPatch[nPatch] != 0);
+	return m_pPatch[nPatch];
+}
+
+void CSynthConfig::SavePatch (unsigned nPatch)
+{
+	assert (nPatch < PATCHES);
+	assert (m_pPatch[nPatch] != 0);
+
+	m_SaveStatus[nPatch] = PatchSavePending;
+}
+
+TPatchSaveStatus CSynthConfig::GetSaveStatus (unsigned nPatch) const
+{
+	assert (nPatch < PATCHES);
+	return m_SaveStatus[nPatch];
+}
+
 u8 CSynthConfig::MapVelocity (u8 ucVelocity) const
 {
 	return m_VelocityCurve.MapVelocity (ucVelocity);
@@ -104,3 +393,266 @@ TSynthParameter CSynthConfig::MapMIDICC (u8 ucMIDICC) const
 {
 	return m_MIDICCMap.Map (ucMIDICC);
 }
+
+boolean CSynthConfig::LoadPatch (unsigned nPatch)
+{
+	assert (nPatch < PATCHES);
+	assert (m_pPatch[nPatch] == 0);
+	assert (m_pFileSystem != 0);
+
+	CString FileName;
+	GetPatchFileName (&FileName, nPatch, "txt");
+
+	FILINFO TextFileInfo;
+	if (f_stat (FileName, &TextFileInfo) != FR_OK)
+	{
+		// recover from an interrupted WritePatch()
+		CString TempFileName;
+		GetPatchFileName (&TempFileName, nPatch, "tmp");
+		if (   f_stat (TempFileName, 0) != FR_OK
+		    || f_rename (TempFileName, FileName) != FR_OK
+		    || f_stat (FileName, &TextFileInfo) != FR_OK)
+		{
+			memset (&TextFileInfo, 0, sizeof TextFileInfo);
+		}
+	}
+
+	CPatch *pPatch = new CPatch (FileName, m_pFileSystem);
+	assert (pPatch != 0);
+
+	boolean bFromBank = m_PatchBank.GetPatch (nPatch, pPatch, &TextFileInfo);
+	if (!bFromBank)
+	{
+		pPatch->Load ();
+
+		m_PatchBank.SetPatch (nPatch, pPatch, &TextFileInfo);
+
+		m_bBankModified = TRUE;
+		m_nBankModifiedTicks = CTimer::GetClockTicks ();
+	}
+
+	m_pPatch[nPatch] = pPatch;		// publish the completely loaded patch
+
+	return bFromBank;
+}
+
+boolean CSynthConfig::StartPatchWrite (void)
+{
+	assert (m_WriteStep == FileWriteIdle);
+
+	for (unsigned i = 0; i < PATCHES; i++)
+	{
+		unsigned nPatch = m_nNextWrite;
+		if (++m_nNextWrite >= PATCHES)
+		{
+			m_nNextWrite = 0;
+		}
+
+		if (m_SaveStatus[nPatch] != PatchSavePending)
+		{
+			continue;
+		}
+
+		// a new request in the meantime sets the status to pending again
+		m_SaveStatus[nPatch] = PatchSaveWriting;
+
+		assert (m_pPatch[nPatch] != 0);
+		m_pPatch[nPatch]->GetText (&m_WriteText);
+
+		m_nWritePatch = nPatch;
+		m_pWriteBuffer = (const u8 *) (const char *) m_WriteText;
+		m_nWriteSize = m_WriteText.GetLength ();
+		m_nWriteOffset = 0;
+		m_WriteStep = FileWriteOpen;
+
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+boolean CSynthConfig::StartBankWrite (void)
+{
+	assert (m_WriteStep == FileWriteIdle);
+
+	if (   !m_bBankModified
+	    || m_nNextPrefetch < PATCHES
+	    || CTimer::GetClockTicks () - m_nBankModifiedTicks < BANK_WRITE_DELAY)
+	{
+		return FALSE;
+	}
+
+	m_bBankModified = FALSE;
+
+	m_pWriteBuffer = m_PatchBank.GetImage (&m_nWriteSize);
+	if (m_pWriteBuffer == 0)
+	{
+		return FALSE;
+	}
+
+	m_nWritePatch = PATCHES;
+	m_nWriteOffset = 0;
+	m_WriteStep = FileWriteOpen;
+
+	return TRUE;
+}
+
+void CSynthConfig::WriteStep (void)
+{
+	// A patch is written to a temporary file first. FatFs cannot rename to an
+	// existing file, so the old file is removed before. If this gets interrupted,
+	// LoadPatch() takes the temporary file. The patch bank is written directly,
+	// an incomplete bank is detected by its checksum.
+	CString FileName;
+	CString TempFileName;
+	if (m_nWritePatch < PATCHES)
+	{
+		GetPatchFileName (&FileName, m_nWritePatch, "txt");
+		GetPatchFileName (&TempFileName, m_nWritePatch, "tmp");
+	}
+	else
+	{
+		FileName = m_BankFileName;
+		TempFileName = m_BankFileName;
+	}
+
+	unsigned nSize;
+	unsigned nBytesWritten;
+	FRESULT Result;
+	FILINFO TextFileInfo;
+
+	switch (m_WriteStep)
+	{
+	case FileWriteOpen:
+		if (f_open (&m_WriteFile, TempFileName, FA_WRITE | FA_CREATE_ALWAYS) != FR_OK)
+		{
+			EndWrite (FALSE);
+			break;
+		}
+		m_WriteStep = FileWriteData;
+		break;
+
+	case FileWriteData:
+		nSize = m_nWriteSize - m_nWriteOffset;
+		if (nSize > FILE_WRITE_CHUNK_SIZE)
+		{
+			nSize = FILE_WRITE_CHUNK_SIZE;
+		}
+
+		assert (m_pWriteBuffer != 0);
+		if (   f_write (&m_WriteFile, m_pWriteBuffer + m_nWriteOffset, nSize,
+				    &nBytesWritten) != FR_OK
+		    || nBytesWritten != nSize)
+		{
+			f_close (&m_WriteFile);
+			f_unlink (TempFileName);	// do not leave an incomplete file
+
+			EndWrite (FALSE);
+			break;
+		}
+
+		m_nWriteOffset += nSize;
+		if (m_nWriteOffset >= m_nWriteSize)
+		{
+			m_WriteStep = FileWriteClose;
+		}
+		break;
+
+	case FileWriteClose:
+		if (f_close (&m_WriteFile) != FR_OK)
+		{
+			f_unlink (TempFileName);
+
+			EndWrite (FALSE);
+			break;
+		}
+
+		if (m_nWritePatch >= PATCHES)
+		{
+			EndWrite (TRUE);
+			break;
+		}
+		m_WriteStep = FileWriteUnlink;
+		break;
+
+	case FileWriteUnlink:
+		Result = f_unlink (FileName);
+		if (Result != FR_OK && Result != FR_NO_FILE)
+		{
+			EndWrite (FALSE);
+			break;
+		}
+		m_WriteStep = FileWriteRename;
+		break;
+
+	case FileWriteRename:
+		if (f_rename (TempFileName, FileName) != FR_OK)
+		{
+			EndWrite (FALSE);
+			break;
+		}
+		m_WriteStep = FileWriteStat;
+		break;
+
+	case FileWriteStat:
+		// keep the patch bank up-to-date, it is written later
+		if (f_stat (FileName, &TextFileInfo) == FR_OK)
+		{
+			assert (m_pPatch[m_nWritePatch] != 0);
+			m_PatchBank.SetPatch (m_nWritePatch, m_pPatch[m_nWritePatch], &TextFileInfo);
+
+			m_bBankModified = TRUE;
+			m_nBankModifiedTicks = CTimer::GetClockTicks ();
+		}
+
+		EndWrite (TRUE);
+		break;
+
+	default:
+		assert (0);
+		break;
+	}
+}
+
+void CSynthConfig::EndWrite (boolean bOK)
+{
+	m_WriteStep = FileWriteIdle;
+	m_pWriteBuffer = 0;
+
+	if (m_nWritePatch >= PATCHES)
+	{
+		if (!bOK)
+		{
+			m_PatchBank.SetDirty ();	// written with the next modification
+
+			CLogger::Get ()->Write (FromSynthConfig, LogWarning, "Cannot write %s",
+						(const char *) m_BankFileName);
+		}
+
+		return;
+	}
+
+	unsigned nPatch = m_nWritePatch;
+	if (m_SaveStatus[nPatch] == PatchSaveWriting)	// otherwise requested again
+	{
+		m_SaveStatus[nPatch] = bOK ? PatchSaveOK : PatchSaveFailed;
+	}
+
+	if (!bOK)
+	{
+		CLogger::Get ()->Write (FromSynthConfig, LogWarning, "Cannot save patch %u", nPatch);
+	}
+	else
+	{
+		CLogger::Get ()->Write (FromSynthConfig, LogDebug, "Patch %u saved", nPatch);
+	}
+}
+
+void CSynthConfig::GetPatchFileName (CString *pFileName, unsigned nPatch,
+				     const char *pExtension) const
+{
+	assert (pFileName != 0);
+	assert (pExtension != 0);
+
+	pFileName->Format ("%s/patch%u.%s", (const char *) m_PatchPath, nPatch, pExtension);
+}
@@ -23,11 +23,38 @@
 #define _synthconfig_h
 
 #include <fatfs/ff.h>
+#include <circle/string.h>
 #include "patch.h"
+#include "patchbank.h"
 #include "velocitycurve.h"
 #include "midiccmap.h"
+#include "partmap.h"
+#include "zonemap.h"
+#include "tuning.h"
 #include "config.h"
 
+enum TPatchSaveStatus
+{
+	PatchSaveIdle,				// not saved since boot
+	PatchSavePending,			// queued, but not written yet
+	PatchSaveWriting,			// being written by Process()
+	PatchSaveOK,
+	PatchSaveFailed,
+	PatchSaveUnknown
+};
+
+enum TFileWriteStep				// a patch or the patch bank is written
+{
+	FileWriteIdle,
+	FileWriteOpen,
+	FileWriteData,				// FILE_WRITE_CHUNK_SIZE bytes per step
+	FileWriteClose,
+	FileWriteUnlink,			// patch only: remove the old text file,
+	FileWriteRename,			// rename the temporary file
+	FileWriteStat,				// and update the record in the bank
+	FileWriteUnknown
+};
+
 class CSynthConfig
 {
 public:
@@ -37,6 +64,23 @@ public:
 	// loads global configuration only, not the patches
 	boolean Load (void);
 
+	// loads the binary patch bank and patch 0, the other patches are loaded on first
+	// access or by PrefetchPatches(), returns FALSE if the bank is missing or invalid
+	boolean LoadPatches (void);
+
+#ifdef PATCH_LOAD_BENCHMARK
+	// logs the time to load all patches from the patch bank and from the text files
+	void RunPatchLoadBenchmark (void);
+#endif
+
+	// background work, to be called from the main loop: writes queued patches and
+	// the modified patch bank and prefetches patches, which are not loaded yet,
+	// does one write step or loads one patch per call
+	void Process (void);
+
+	// patches, which are not loaded yet, may not be accessed from interrupt context
+	boolean IsPatchLoaded (unsigned nPatch) const;
+
 	// the patch which is currently active
 	unsigned GetActivePatchNumber (void) const;
 	void SetActivePatchNumber (unsigned nPatch);
@@ -44,20 +88,76 @@ public:
 	// get the active patch
 	CPatch *GetActivePatch (void);
 
-	// get patch by number
+	// get patch by number, loads it, if not done yet
 	CPatch *GetPatch (unsigned nPatch);
 
+	// multi-timbral parts, part 0 is the active patch (see partmap.h)
+	u16 GetEnabledParts (void) const;		// bit mask, including part 0
+	u16 GetChannelParts (u8 ucChannel);		// parts listening on MIDI channel (0-15)
+	unsigned GetPartPatchNumber (unsigned nPart) const;
+	void SetPartPatchNumber (unsigned nPart, unsigned nPatch);
+	CPatch *GetPartPatch (unsigned nPart);		// patch must have been loaded
+
+	// keyboard split and layer zones of part 0 (see zonemap.h)
+	u8 GetEnabledZones (void) const;		// bit mask
+	u8 GetKeyZones (u8 ucKeyNumber, u8 ucVelocity) const;	// bit mask, O(1)
+	int GetZoneTranspose (unsigned nZone) const;
+	CPatch *GetZonePatch (unsigned nZone);		// patch must have been loaded
+
+	// queues the patch to be written in Process(), repeated requests are coalesced
+	void SavePatch (unsigned nPatch);
+	TPatchSaveStatus GetSaveStatus (unsigned nPatch) const;
+
 	u8 MapVelocity (u8 ucVelocity) const;
 	TSynthParameter MapMIDICC (u8 ucMIDICC) const;
 
+private:
+	// from patch bank, if up-to-date, or text file, returns TRUE if from the bank
+	boolean LoadPatch (unsigned nPatch);
+
+	// loads the next patch, which is not loaded yet,
+	// returns FALSE if there is nothing to do any more
+	boolean PrefetchPatches (void);
+
+	// starts writing the next queued patch, returns FALSE if there is nothing to do
+	boolean StartPatchWrite (void);
+	// starts writing the patch bank, if it has been modified, all patches are loaded
+	// and it has not been modified for BANK_WRITE_DELAY, returns FALSE otherwise
+	boolean StartBankWrite (void);
+	void WriteStep (void);			// does the next step of the started write
+	void EndWrite (boolean bOK);
+
+	void GetPatchFileName (CString *pFileName, unsigned nPatch, const char *pExtension) const;
+
 private:
 	FATFS *m_pFileSystem;
 
-	CPatch *m_pPatch[PATCHES];
+	CString m_PatchPath;
+	CString m_BankFileName;
+	CPatch * volatile m_pPatch[PATCHES];	// 0 if not loaded yet
 	unsigned m_nActivePatch;
+	CPatchBank m_PatchBank;
+	unsigned m_nNextPrefetch;
+
+	volatile TPatchSaveStatus m_SaveStatus[PATCHES];
+	unsigned m_nNextWrite;
+
+	TFileWriteStep m_WriteStep;
+	unsigned m_nWritePatch;			// PATCHES for the patch bank
+	FIL m_WriteFile;
+	CString m_WriteText;			// of the patch
+	const u8 *m_pWriteBuffer;
+	unsigned m_nWriteSize;
+	unsigned m_nWriteOffset;
+
+	boolean m_bBankModified;		// since the bank write has been started
+	unsigned m_nBankModifiedTicks;
 
 	CVelocityCurve m_VelocityCurve;
 	CMIDICCMap m_MIDICCMap;
+	CPartMap m_PartMap;
+	CZoneMap m_ZoneMap;
+	CTuning m_Tuning;
 };
 
 #endif
@@ -22,12 +22,17 @@
 #ifndef _synthmodule_h
 #define _synthmodule_h
 
-class CSynthModule
+#include "sample.h"
+
+template <typename TSample>
+class CSynthModuleT
 {
 public:
-	virtual ~CSynthModule (void) {}
+	virtual ~CSynthModuleT (void) {}
 
-	virtual float GetOutputLevel (void) const = 0;	// returns [-1.0, 1.0]
+	virtual TSample GetOutputLevel (void) const = 0;	// returns [-1.0, 1.0]
 };
 
+typedef CSynthModuleT<float> CSynthModule;
+
 #endif
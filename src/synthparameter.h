@@ -0,0 +1,72 @@
+//
+// synthparameter.h
+//
+// The parameters of a patch
+//
+// MiniSynth Pi - A virtual analogue synthesizer for Raspberry Pi
+// Copyright (C) 2017-2023  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _synthparameter_h
+#define _synthparameter_h
+
+enum TSynthParameter			// the parameters of a patch
+{
+	// VCO
+	LFOVCOWaveform,
+	LFOVCOFrequency,
+
+	VCO1Waveform,
+	VCO1ModulationVolume,
+	VCO1Octave,
+	VCO1FineTune,	
+
+	// VCF
+	LFOVCFWaveform,
+	LFOVCFFrequency,
+
+	VCFCutoffFrequency,
+	VCFResonance,
+
+	EGVCFAttack,
+	EGVCFDecay,
+	EGVCFSustain,
+	EGVCFRelease,
+
+	VCFModulationVolume,
+
+	// VCA
+	LFOVCAWaveform,
+	LFOVCAFrequency,
+
+	EGVCAAttack,
+	EGVCADecay,
+	EGVCASustain,
+	EGVCARelease,
+
+	VCAModulationVolume,
+
+	// Effects
+	ReverbDecay,
+	ReverbVolume,
+
+	// Synth
+	SynthVolume,
+	MIDIChannel,
+
+	SynthParameterUnknown
+};
+
+#endif
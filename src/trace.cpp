@@ -0,0 +1,177 @@
+//
+// trace.cpp
+//
+// MiniSynth Pi - A virtual analogue synthesizer for Raspberry Pi
+// Copyright (C) 2017-2023  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "trace.h"
+
+#ifdef TRACE_EVENTS
+
+#include <circle/logger.h>
+#include <assert.h>
+
+#define TRACE_FILE	DRIVE "/trace.bin"
+#define TRACE_VERSION	1
+
+static const char FromTrace[] = "trace";
+
+CTrace *CTrace::s_pThis = 0;
+
+CTrace::CTrace (void)
+:	m_bFileOpen (FALSE),
+	m_nLastSyncTicks (0)
+{
+	// the rings are too big for the stack, on which the kernel object lives
+	m_pRing = new TRing[TRACE_CORES];
+	assert (m_pRing != 0);
+
+	for (unsigned nCore = 0; nCore < TRACE_CORES; nCore++)
+	{
+		m_pRing[nCore].nIn = 0;
+		m_pRing[nCore].nOut = 0;
+		m_pRing[nCore].nDropped = 0;
+		m_pRing[nCore].nDroppedReported = 0;
+	}
+
+	assert (s_pThis == 0);
+	s_pThis = this;
+}
+
+CTrace::~CTrace (void)
+{
+	if (m_bFileOpen)
+	{
+		f_close (&m_File);
+		m_bFileOpen = FALSE;
+	}
+
+	s_pThis = 0;
+
+	delete [] m_pRing;
+	m_pRing = 0;
+}
+
+boolean CTrace::Initialize (void)
+{
+	assert (!m_bFileOpen);
+	if (f_open (&m_File, TRACE_FILE, FA_WRITE | FA_CREATE_ALWAYS) != FR_OK)
+	{
+		CLogger::Get ()->Write (FromTrace, LogError, "Cannot create %s", TRACE_FILE);
+
+		return FALSE;
+	}
+
+	m_bFileOpen = TRUE;
+
+	struct
+	{
+		char Magic[4];
+		u16 usVersion;
+		u16 usRecordSize;
+		u32 nTicksPerSecond;
+		u32 nReserved;
+	}
+	Header = {{'M', 'S', 'T', 'R'}, TRACE_VERSION, sizeof (TTraceRecord), CLOCKHZ, 0};
+
+	WriteFile (&Header, sizeof Header);
+
+	m_nLastSyncTicks = CTimer::GetClockTicks ();
+
+	return m_bFileOpen;
+}
+
+void CTrace::Process (void)
+{
+	if (!m_bFileOpen)
+	{
+		return;
+	}
+
+	for (unsigned nCore = 0; nCore < TRACE_CORES; nCore++)
+	{
+		TRing *pRing = &m_pRing[nCore];
+
+		unsigned nIn = pRing->nIn;
+		DataMemBarrier ();			// read the records published up to nIn
+
+		unsigned nOut = pRing->nOut;
+		if (nIn < nOut)				// wrapped around, write the end first
+		{
+			WriteFile (&pRing->Record[nOut], (RingSize-nOut) * sizeof (TTraceRecord));
+			nOut = 0;
+		}
+
+		if (nOut < nIn)
+		{
+			WriteFile (&pRing->Record[nOut], (nIn-nOut) * sizeof (TTraceRecord));
+		}
+
+		DataMemBarrier ();			// records have been copied, before they are released
+
+		pRing->nOut = nIn;
+
+		unsigned nDropped = pRing->nDropped;
+		if (nDropped != pRing->nDroppedReported)
+		{
+			TTraceRecord Record;
+			Record.nTicks = CTimer::GetClockTicks ();
+			Record.ucEvent = (u8) (TraceEventsDropped | nCore << 4);
+			Record.ucParam = (u8) nCore;
+			Record.usArg = (u16) (nDropped - pRing->nDroppedReported);
+
+			WriteFile (&Record, sizeof Record);
+
+			pRing->nDroppedReported = nDropped;
+		}
+	}
+
+	// FatFs buffers the data, make it persistent once per second
+	unsigned nTicks = CTimer::GetClockTicks ();
+	if (   m_bFileOpen
+	    && nTicks - m_nLastSyncTicks >= CLOCKHZ)
+	{
+		f_sync (&m_File);
+
+		m_nLastSyncTicks = nTicks;
+	}
+}
+
+CTrace *CTrace::Get (void)
+{
+	assert (s_pThis != 0);
+	return s_pThis;
+}
+
+void CTrace::WriteFile (const void *pBuffer, unsigned nLength)
+{
+	if (!m_bFileOpen)			// after a write error
+	{
+		return;
+	}
+
+	unsigned nBytesWritten;
+	if (   f_write (&m_File, pBuffer, nLength, &nBytesWritten) != FR_OK
+	    || nBytesWritten != nLength)
+	{
+		CLogger::Get ()->Write (FromTrace, LogError, "Cannot write %s", TRACE_FILE);
+
+		f_close (&m_File);
+		m_bFileOpen = FALSE;
+	}
+}
+
+#endif
@@ -0,0 +1,150 @@
+//
+// trace.h
+//
+// Lock-free event trace of the real-time path, written to the SD card
+//
+// MiniSynth Pi - A virtual analogue synthesizer for Raspberry Pi
+// Copyright (C) 2017-2023  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _trace_h
+#define _trace_h
+
+#include "config.h"
+
+enum TTraceEvent				// parameter, argument
+{
+	TraceChunkStart,			// -, chunk size (samples)
+	TraceChunkEnd,				// 1 if silent, -
+	TraceNoteOn,				// part, key | velocity << 8
+	TraceNoteOff,				// part, key
+	TraceVoiceAllocate,			// voice, key | part << 8
+	TraceVoiceSteal,			// voice, key | part << 8
+	TraceVoiceRetire,			// voice, -
+	TraceCoreKick,				// number of kicked cores, -
+	TraceCoreComplete,			// core, -
+	TracePatchChange,			// part, -
+	TraceEventsDropped,			// core, count (inserted by CTrace::Process())
+	TraceEventUnknown
+};
+
+#ifdef TRACE_EVENTS
+	#define TRACE(event, param, arg)	CTrace::Get ()->Write (event, param, arg)
+#else
+	#define TRACE(event, param, arg)	((void) 0)
+#endif
+
+#ifdef TRACE_EVENTS
+
+#include <fatfs/ff.h>
+#include <circle/timer.h>
+#include <circle/synchronize.h>
+#include <circle/types.h>
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	#include <circle/multicore.h>
+	#define TRACE_CORES	CORES
+#else
+	#define TRACE_CORES	1
+#endif
+
+// Each core writes its events into an own ring buffer, without any locking. On
+// core 0 TRACE() is used with IRQs disabled (GlobalLock()) only, so that there is
+// exactly one producer per ring. Process() is the only consumer and appends the
+// records from the main loop to the file trace.bin, which starts with a 16 byte
+// header ("MSTR", u16 version, u16 record size, u32 ticks per second, u32 0),
+// followed by the records of all cores (not sorted by time). Events are dropped
+// and counted, when a ring is full. The file can be converted with the script
+// tools/trace2json.py into a JSON trace for chrome://tracing or Perfetto.
+
+class CTrace
+{
+public:
+	CTrace (void);
+	~CTrace (void);
+
+	boolean Initialize (void);			// creates the trace file
+
+	// call with TRACE() from the real-time path
+	void Write (TTraceEvent Event, u8 ucParam, u16 usArg)
+	{
+#ifdef ARM_ALLOW_MULTI_CORE
+		unsigned nCore = CMultiCoreSupport::ThisCore ();
+#else
+		unsigned nCore = 0;
+#endif
+		TRing *pRing = &m_pRing[nCore];
+
+		unsigned nIn = pRing->nIn;
+		unsigned nNextIn = (nIn+1) % RingSize;
+		if (nNextIn == pRing->nOut)
+		{
+			pRing->nDropped++;
+
+			return;
+		}
+
+		TTraceRecord *pRecord = &pRing->Record[nIn];
+		pRecord->nTicks = CTimer::GetClockTicks ();
+		pRecord->ucEvent = (u8) (Event | nCore << 4);
+		pRecord->ucParam = ucParam;
+		pRecord->usArg = usArg;
+
+		DataMemBarrier ();			// record must be valid, before it is published
+
+		pRing->nIn = nNextIn;
+	}
+
+	void Process (void);				// call from the main loop
+
+	static CTrace *Get (void);
+
+private:
+	void WriteFile (const void *pBuffer, unsigned nLength);
+
+private:
+	struct TTraceRecord
+	{
+		u32 nTicks;				// CTimer::GetClockTicks()
+		u8 ucEvent;				// TTraceEvent | core << 4
+		u8 ucParam;
+		u16 usArg;
+	};
+
+	static const unsigned RingSize = 4096;		// records per core
+
+	struct TRing
+	{
+		volatile unsigned nIn;			// written by the producing core only
+		volatile unsigned nDropped;
+		unsigned nDroppedReported;		// accessed by Process() only
+		volatile unsigned nOut			// written by Process() only
+			__attribute__ ((aligned (DATA_CACHE_LINE_SIZE_MAX)));
+		TTraceRecord Record[RingSize];
+	}
+	__attribute__ ((aligned (DATA_CACHE_LINE_SIZE_MAX)));
+
+	FIL m_File;
+	boolean m_bFileOpen;
+	unsigned m_nLastSyncTicks;
+
+	TRing *m_pRing;					// one ring per core
+
+	static CTrace *s_pThis;
+};
+
+#endif
+
+#endif
@@ -0,0 +1,496 @@
+//
+// tuning.cpp
+//
+// MiniSynth Pi - A virtual analogue synthesizer for Raspberry Pi
+// Copyright (C) 2017-2023  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "tuning.h"
+#include "math.h"
+#include <circle/logger.h>
+#include <circle/string.h>
+#include <assert.h>
+
+#define MAX_FILE_SIZE	0x4000
+
+static const char FromTuning[] = "tuning";
+
+CTuning::CTuning (FATFS *pFileSystem)
+:	m_Properties (DRIVE "/tuning.txt", pFileSystem)
+{
+	SetDefaultScale ();
+	SetDefaultMapping (440.0f);
+
+	// keys, which are not mapped, keep these values
+	for (unsigned nKey = 0; nKey < TUNING_KEYS; nKey++)
+	{
+		m_fKeyFrequency[nKey] = 440.0f * exp2f (((int) nKey - 69) / 12.0f);
+	}
+}
+
+CTuning::~CTuning (void)
+{
+}
+
+boolean CTuning::Load (void)
+{
+	if (!m_Properties.Load ())
+	{
+		return FALSE;
+	}
+
+	unsigned nReferenceFrequency = m_Properties.GetNumber ("ReferenceFrequency", 440);
+	if (nReferenceFrequency < 100 || nReferenceFrequency > 1000)
+	{
+		CLogger::Get ()->Write (FromTuning, LogWarning, "Invalid reference frequency: %u Hz",
+					nReferenceFrequency);
+
+		return FALSE;
+	}
+
+	SetDefaultMapping ((float) nReferenceFrequency);
+
+	const char *pFileName = m_Properties.GetString ("ScaleFile", "");
+	if (   *pFileName != '\0'
+	    && !LoadScale (pFileName))
+	{
+		CLogger::Get ()->Write (FromTuning, LogWarning, "Invalid scale file: %s", pFileName);
+
+		return FALSE;
+	}
+
+	pFileName = m_Properties.GetString ("MappingFile", "");
+	if (   *pFileName != '\0'
+	    && !LoadMapping (pFileName))
+	{
+		CLogger::Get ()->Write (FromTuning, LogWarning, "Invalid mapping file: %s", pFileName);
+
+		return FALSE;
+	}
+
+	int nReferenceDegree;
+	if (!GetDegree (m_nReferenceKey, &nReferenceDegree))
+	{
+		CLogger::Get ()->Write (FromTuning, LogWarning, "Reference key %u is not mapped",
+					m_nReferenceKey);
+
+		return FALSE;
+	}
+
+	float fReferenceCents = GetCents (nReferenceDegree);
+
+	for (unsigned nKey = 0; nKey < TUNING_KEYS; nKey++)
+	{
+		int nDegree;
+		if (GetDegree (nKey, &nDegree))
+		{
+			m_fKeyFrequency[nKey] =   m_fReferenceFrequency
+						* exp2f ((GetCents (nDegree) - fReferenceCents) / 1200.0f);
+		}
+	}
+
+	CLogger::Get ()->Write (FromTuning, LogNotice, "Tuning loaded (%u degrees, key %u = %u Hz)",
+				m_nDegrees, m_nReferenceKey, (unsigned) (m_fReferenceFrequency + 0.5f));
+
+	return TRUE;
+}
+
+const float *CTuning::GetKeyFrequencies (void) const
+{
+	return m_fKeyFrequency;
+}
+
+boolean CTuning::LoadScale (const char *pFileName)
+{
+	CString Path;
+	Path.Format ("%s/%s", DRIVE, pFileName);
+
+	char *pBuffer = ReadFile (Path);
+	if (pBuffer == 0)
+	{
+		return FALSE;
+	}
+
+	// description line, number of notes, one line per note (cents or ratio)
+	char *pNext = pBuffer;
+	int nDegrees = 0;
+	boolean bOK =    GetNextLine (&pNext) != 0
+		      && ParseNumber (GetNextLine (&pNext), &nDegrees)
+		      && 0 < nDegrees && nDegrees <= TUNING_MAX_DEGREES;
+
+	for (int i = 0; bOK && i < nDegrees; i++)
+	{
+		bOK = ParsePitch (GetNextLine (&pNext), &m_fCents[i]);
+	}
+
+	delete [] pBuffer;
+
+	if (!bOK)
+	{
+		SetDefaultScale ();
+
+		return FALSE;
+	}
+
+	m_nDegrees = (unsigned) nDegrees;
+
+	return TRUE;
+}
+
+boolean CTuning::LoadMapping (const char *pFileName)
+{
+	CString Path;
+	Path.Format ("%s/%s", DRIVE, pFileName);
+
+	char *pBuffer = ReadFile (Path);
+	if (pBuffer == 0)
+	{
+		return FALSE;
+	}
+
+	// map size, first key, last key, middle key, reference key, reference frequency,
+	// formal octave degree, one line per map entry (scale degree or "x")
+	char *pNext = pBuffer;
+	int nValue[7];
+	boolean bOK = TRUE;
+	for (unsigned i = 0; bOK && i < 7; i++)
+	{
+		if (i == 5)
+		{
+			bOK = ParseFloat (GetNextLine (&pNext), &m_fReferenceFrequency);
+		}
+		else
+		{
+			bOK = ParseNumber (GetNextLine (&pNext), &nValue[i]);
+		}
+	}
+
+	bOK =    bOK
+	      && 0 <= nValue[0] && nValue[0] <= TUNING_MAX_MAP_SIZE
+	      && 0 <= nValue[1] && nValue[1] <= nValue[2] && nValue[2] < TUNING_KEYS
+	      && 0 <= nValue[3] && nValue[3] < TUNING_KEYS
+	      && 0 <= nValue[4] && nValue[4] < TUNING_KEYS
+	      && m_fReferenceFrequency > 0.0f
+	      && 0 <= nValue[6];
+
+	for (int i = 0; bOK && i < nValue[0]; i++)
+	{
+		// missing entries at the end are not mapped
+		char *pLine = GetNextLine (&pNext);
+		if (   pLine == 0
+		    || *pLine == 'x')
+		{
+			m_nMap[i] = -1;
+		}
+		else
+		{
+			bOK = ParseNumber (pLine, &m_nMap[i]) && m_nMap[i] >= 0;
+		}
+	}
+
+	delete [] pBuffer;
+
+	if (!bOK)
+	{
+		SetDefaultMapping (440.0f);
+
+		return FALSE;
+	}
+
+	m_nMapSize = nValue[0];
+	m_nFirstKey = nValue[1];
+	m_nLastKey = nValue[2];
+	m_nMiddleKey = nValue[3];
+	m_nReferenceKey = nValue[4];
+	m_nOctaveDegree = nValue[6] > 0 ? nValue[6] : m_nDegrees;
+
+	return TRUE;
+}
+
+void CTuning::SetDefaultScale (void)
+{
+	m_nDegrees = 12;
+	for (unsigned i = 0; i < m_nDegrees; i++)
+	{
+		m_fCents[i] = 100.0f * (i+1);
+	}
+}
+
+void CTuning::SetDefaultMapping (float fReferenceFrequency)
+{
+	m_nMapSize = 0;
+	m_nFirstKey = 0;
+	m_nLastKey = TUNING_KEYS-1;
+	m_nMiddleKey = 60;
+	m_nReferenceKey = 69;
+	m_fReferenceFrequency = fReferenceFrequency;
+	m_nOctaveDegree = 12;
+}
+
+boolean CTuning::GetDegree (unsigned nKey, int *pDegree) const
+{
+	assert (pDegree != 0);
+
+	if (nKey < m_nFirstKey || nKey > m_nLastKey)
+	{
+		return FALSE;
+	}
+
+	int nOffset = (int) nKey - (int) m_nMiddleKey;
+	if (m_nMapSize == 0)
+	{
+		*pDegree = nOffset;
+
+		return TRUE;
+	}
+
+	int nPattern = nOffset / (int) m_nMapSize;
+	int nIndex = nOffset % (int) m_nMapSize;
+	if (nIndex < 0)
+	{
+		nIndex += m_nMapSize;
+		nPattern--;
+	}
+
+	if (m_nMap[nIndex] < 0)
+	{
+		return FALSE;
+	}
+
+	*pDegree = nPattern * (int) m_nOctaveDegree + m_nMap[nIndex];
+
+	return TRUE;
+}
+
+float CTuning::GetCents (int nDegree) const
+{
+	assert (m_nDegrees > 0);
+
+	int nPeriod = nDegree / (int) m_nDegrees;
+	int nIndex = nDegree % (int) m_nDegrees;
+	if (nIndex < 0)
+	{
+		nIndex += m_nDegrees;
+		nPeriod--;
+	}
+
+	float fCents = nPeriod * m_fCents[m_nDegrees-1];
+	if (nIndex > 0)
+	{
+		fCents += m_fCents[nIndex-1];
+	}
+
+	return fCents;
+}
+
+char *CTuning::ReadFile (const char *pFileName)
+{
+	assert (pFileName != 0);
+
+	FIL File;
+	if (f_open (&File, pFileName, FA_READ | FA_OPEN_EXISTING) != FR_OK)
+	{
+		return 0;
+	}
+
+	char *pBuffer = 0;
+
+	unsigned nSize = f_size (&File);
+	if (nSize <= MAX_FILE_SIZE)
+	{
+		pBuffer = new char[nSize+1];
+		assert (pBuffer != 0);
+
+		unsigned nBytesRead;
+		if (   f_read (&File, pBuffer, nSize, &nBytesRead) == FR_OK
+		    && nBytesRead == nSize)
+		{
+			pBuffer[nSize] = '\0';
+		}
+		else
+		{
+			delete [] pBuffer;
+			pBuffer = 0;
+		}
+	}
+
+	f_close (&File);
+
+	return pBuffer;
+}
+
+char *CTuning::GetNextLine (char **ppNext)
+{
+	assert (ppNext != 0);
+
+	while (**ppNext != '\0')
+	{
+		char *pLine = *ppNext;
+
+		char *p = pLine;
+		while (*p != '\0' && *p != '\n')
+		{
+			p++;
+		}
+
+		*ppNext = *p != '\0' ? p+1 : p;
+
+		*p = '\0';
+		if (p > pLine && p[-1] == '\r')
+		{
+			p[-1] = '\0';
+		}
+
+		if (*pLine != '!')			// comment
+		{
+			return pLine;
+		}
+	}
+
+	return 0;
+}
+
+// cents contain a period, otherwise it is a ratio ("3/2") or an integer ("2")
+boolean CTuning::ParsePitch (const char *pString, float *pCents)
+{
+	assert (pCents != 0);
+
+	if (pString == 0)
+	{
+		return FALSE;
+	}
+
+	while (*pString == ' ' || *pString == '\t')
+	{
+		pString++;
+	}
+
+	for (const char *p = pString; *p != '\0' && *p != ' ' && *p != '\t'; p++)
+	{
+		if (*p == '.')
+		{
+			return ParseFloat (pString, pCents);
+		}
+	}
+
+	float fNumerator = 0.0f;
+	for (; '0' <= *pString && *pString <= '9'; pString++)
+	{
+		fNumerator = fNumerator * 10.0f + (*pString - '0');
+	}
+
+	float fDenominator = 1.0f;
+	if (*pString == '/')
+	{
+		fDenominator = 0.0f;
+		for (pString++; '0' <= *pString && *pString <= '9'; pString++)
+		{
+			fDenominator = fDenominator * 10.0f + (*pString - '0');
+		}
+	}
+
+	if (   fNumerator <= 0.0f
+	    || fDenominator <= 0.0f)
+	{
+		return FALSE;
+	}
+
+	*pCents = 1200.0f * log2f (fNumerator / fDenominator);
+
+	return TRUE;
+}
+
+boolean CTuning::ParseFloat (const char *pString, float *pValue)
+{
+	assert (pValue != 0);
+
+	if (pString == 0)
+	{
+		return FALSE;
+	}
+
+	while (*pString == ' ' || *pString == '\t')
+	{
+		pString++;
+	}
+
+	boolean bNegative = *pString == '-';
+	if (bNegative || *pString == '+')
+	{
+		pString++;
+	}
+
+	unsigned nDigits = 0;
+	float fValue = 0.0f;
+	for (; '0' <= *pString && *pString <= '9'; pString++, nDigits++)
+	{
+		fValue = fValue * 10.0f + (*pString - '0');
+	}
+
+	if (*pString == '.')
+	{
+		float fScale = 0.1f;
+		for (pString++; '0' <= *pString && *pString <= '9'; pString++, nDigits++)
+		{
+			fValue += (*pString - '0') * fScale;
+			fScale *= 0.1f;
+		}
+	}
+
+	if (nDigits == 0)
+	{
+		return FALSE;
+	}
+
+	*pValue = bNegative ? -fValue : fValue;
+
+	return TRUE;
+}
+
+boolean CTuning::ParseNumber (const char *pString, int *pValue)
+{
+	assert (pValue != 0);
+
+	if (pString == 0)
+	{
+		return FALSE;
+	}
+
+	while (*pString == ' ' || *pString == '\t')
+	{
+		pString++;
+	}
+
+	boolean bNegative = *pString == '-';
+	if (bNegative || *pString == '+')
+	{
+		pString++;
+	}
+
+	if (!('0' <= *pString && *pString <= '9'))
+	{
+		return FALSE;
+	}
+
+	int nValue = 0;
+	for (; '0' <= *pString && *pString <= '9'; pString++)
+	{
+		nValue = nValue * 10 + (*pString - '0');
+	}
+
+	*pValue = bNegative ? -nValue : nValue;
+
+	return TRUE;
+}
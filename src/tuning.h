@@ -0,0 +1,91 @@
+//
+// tuning.h
+//
+// Tuning of the MIDI keys, loaded from Scala scale and keyboard mapping files
+//
+// MiniSynth Pi - A virtual analogue synthesizer for Raspberry Pi
+// Copyright (C) 2017-2023  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _tuning_h
+#define _tuning_h
+
+#include <fatfs/ff.h>
+#include <circle/types.h>
+#include <Properties/propertiesfatfsfile.h>
+#include "config.h"
+
+#define TUNING_KEYS		128			// MIDI key numbers
+#define TUNING_MAX_DEGREES	128			// of a scale
+#define TUNING_MAX_MAP_SIZE	128			// of a keyboard mapping
+
+// The tuning is defined in the optional file tuning.txt. It can shift the reference
+// frequency of A4 (e.g. "ReferenceFrequency=432", in Hz) or select a scale in Scala
+// format (e.g. "ScaleFile=meantone.scl") and optionally a Scala keyboard mapping
+// (e.g. "MappingFile=meantone.kbm") in the root directory of the SD card. Without a
+// keyboard mapping, the scale is mapped linearly with degree 0 on key 60 and key 69
+// is tuned to the reference frequency. Otherwise the reference key and frequency are
+// taken from the mapping file. Load() computes the frequencies of all keys, which are
+// compiled into the phase increments of the oscillators with COscillator::SetTuning().
+// Keys, which are not mapped, keep the frequency of equal temperament.
+
+class CTuning
+{
+public:
+	CTuning (FATFS *pFileSystem);
+	~CTuning (void);
+
+	// returns FALSE, if tuning.txt does not exist or a file is invalid
+	boolean Load (void);
+
+	const float *GetKeyFrequencies (void) const;	// TUNING_KEYS values in Hz
+
+private:
+	boolean LoadScale (const char *pFileName);
+	boolean LoadMapping (const char *pFileName);
+
+	void SetDefaultScale (void);			// equal temperament
+	void SetDefaultMapping (float fReferenceFrequency);
+
+	boolean GetDegree (unsigned nKey, int *pDegree) const;	// FALSE if not mapped
+	float GetCents (int nDegree) const;		// of a scale degree
+
+	static char *ReadFile (const char *pFileName);	// returns 0 on error, free with delete []
+	static char *GetNextLine (char **ppNext);	// skips comments, returns 0 at the end
+	static boolean ParsePitch (const char *pString, float *pCents);
+	static boolean ParseFloat (const char *pString, float *pValue);
+	static boolean ParseNumber (const char *pString, int *pValue);
+
+private:
+	CPropertiesFatFsFile m_Properties;
+
+	// scale
+	float m_fCents[TUNING_MAX_DEGREES];		// of degrees 1..n, the last is the period
+	unsigned m_nDegrees;
+
+	// keyboard mapping
+	unsigned m_nMapSize;				// 0 for linear mapping
+	unsigned m_nFirstKey;
+	unsigned m_nLastKey;
+	unsigned m_nMiddleKey;				// scale degree 0 is mapped to this key
+	unsigned m_nReferenceKey;
+	float m_fReferenceFrequency;			// of the reference key in Hz
+	unsigned m_nOctaveDegree;			// formal octave of the mapping
+	int m_nMap[TUNING_MAX_MAP_SIZE];		// scale degrees, -1 if not mapped
+
+	float m_fKeyFrequency[TUNING_KEYS];
+};
+
+#endif
@@ -18,11 +18,11 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include "voice.h"
+#include "profiler.h"
 #include <assert.h>
 
-
-
-CVoice::CVoice (void)
+template <typename TSample>
+CVoiceT<TSample>::CVoiceT (void)
 :	m_VCO (&m_LFO_VCO),
 	m_VCO2 (&m_LFO_VCO),
 	m_VCO_Mixer (&m_VCO, &m_VCO2),
@@ -32,70 +32,54 @@ CVoice::CVoice (void)
 {
 }
 
-CVoice::~CVoice (void)
+template <typename TSample>
+CVoiceT<TSample>::~CVoiceT (void)
 {
 }
 
-void CVoice::SetPatch (CPatch *pPatch)
+template <typename TSample>
+void CVoiceT<TSample>::SetPatch (const CPatchSnapshot *pSnapshot)
 {
-	assert (pPatch != 0);
+	assert (pSnapshot != 0);
 
 	// VCO
-	m_LFO_VCO.SetWaveform ((TWaveform) pPatch->GetParameter (LFOVCOWaveform));
-	m_LFO_VCO.SetFrequency (pPatch->GetParameter (LFOVCOFrequency));
-
-	m_VCO.SetWaveform ((TWaveform) pPatch->GetParameter (VCO1Waveform));
-	m_VCO.SetModulationVolume (pPatch->GetParameter (VCO1ModulationVolume) / 100.0);
-	m_VCO.SetOctave (static_cast<int>(pPatch->GetParameter (VCO1Octave)) - 3);
-	m_VCO.SetDetune (pPatch->GetParameter (VCO1FineTune) / 100.0 - 1.0);
-
-	// TODO: Add VCOs 2, 3, 4
+	m_LFO_VCO.SetParameters (&pSnapshot->LFOVCO);
+	m_VCO.SetParameters (&pSnapshot->VCO);
+	m_VCO2.SetParameters (&pSnapshot->VCO2);
 
 	// VCF
-	m_LFO_VCF.SetWaveform ((TWaveform) pPatch->GetParameter (LFOVCFWaveform));
-	m_LFO_VCF.SetFrequency (pPatch->GetParameter (LFOVCFFrequency) / 10.0);
-
-	m_VCF.SetCutoffFrequency (pPatch->GetParameter (VCFCutoffFrequency));
-	m_VCF.SetResonance (pPatch->GetParameter (VCFResonance));
-
-	m_EG_VCF.SetAttack (pPatch->GetParameter (EGVCFAttack));
-	m_EG_VCF.SetDecay (pPatch->GetParameter (EGVCFDecay));
-	m_EG_VCF.SetSustain (pPatch->GetParameter (EGVCFSustain) / 100.0);
-	m_EG_VCF.SetRelease (pPatch->GetParameter (EGVCFRelease));
-
-	m_VCF.SetModulationVolume (pPatch->GetParameter (VCFModulationVolume) / 100.0);
+	m_LFO_VCF.SetParameters (&pSnapshot->LFOVCF);
+	m_EG_VCF.SetParameters (&pSnapshot->EGVCF);
+	m_VCF.SetParameters (&pSnapshot->VCF);
 
 	// VCA
-	m_LFO_VCA.SetWaveform ((TWaveform) pPatch->GetParameter (LFOVCAWaveform));
-	m_LFO_VCA.SetFrequency (pPatch->GetParameter (LFOVCAFrequency) / 10.0);
-
-	m_EG_VCA.SetAttack (pPatch->GetParameter (EGVCAAttack)); 
-	m_EG_VCA.SetDecay (pPatch->GetParameter (EGVCADecay));
-	m_EG_VCA.SetSustain (pPatch->GetParameter (EGVCASustain) / 100.0);
-	m_EG_VCA.SetRelease (pPatch->GetParameter (EGVCARelease));
-
-	m_VCA.SetModulationVolume (pPatch->GetParameter (VCAModulationVolume) / 100.0);
+	m_LFO_VCA.SetParameters (&pSnapshot->LFOVCA);
+	m_EG_VCA.SetParameters (&pSnapshot->EGVCA);
+	m_VCA.SetParameters (&pSnapshot->VCA);
 }
 
-void CVoice::NoteOn (u8 ucKeyNumber, u8 ucVelocity)
+template <typename TSample>
+void CVoiceT<TSample>::NoteOn (u8 ucKeyNumber, u8 ucVelocity)
 {
 	m_ucKeyNumber = ucKeyNumber;
 	m_VCO.SetMIDINote (m_ucKeyNumber);
 	m_VCO2.SetMIDINote (m_ucKeyNumber);
 
 	assert (1 <= ucVelocity && ucVelocity <= 127);
-	float fVelocityLevel = ucVelocity / 127.0;
+	float fVelocityLevel = ucVelocity / 127.0f;
 	m_EG_VCF.NoteOn (fVelocityLevel);
 	m_EG_VCA.NoteOn (fVelocityLevel);
 }
 
-void CVoice::NoteOff (void)
+template <typename TSample>
+void CVoiceT<TSample>::NoteOff (void)
 {
 	m_EG_VCF.NoteOff ();
 	m_EG_VCA.NoteOff ();
 }
 
-TVoiceState CVoice::GetState (void) const
+template <typename TSample>
+TVoiceState CVoiceT<TSample>::GetState (void) const
 {
 	switch (m_EG_VCA.GetState ())
 	{
@@ -116,31 +100,50 @@ TVoiceState CVoice::GetState (void) const
 	}
 }
 
-u8 CVoice::GetKeyNumber (void) const
+template <typename TSample>
+u8 CVoiceT<TSample>::GetKeyNumber (void) const
 {
 	return m_EG_VCA.GetState () != EnvelopeStateIdle ? m_ucKeyNumber : KEY_NUMBER_NONE;
 }
 
-void CVoice::NextSample (void)
+template <typename TSample>
+void CVoiceT<TSample>::NextSample (void)
 {
+	PROFILE_BEGIN (ProfileUnitVoiceSample);
+
 	// VCO
 	m_LFO_VCO.NextSample ();
+	PROFILE_STAGE (ProfileStageLFOs);
 	m_VCO.NextSample ();
 	m_VCO2.NextSample ();
+	PROFILE_STAGE (ProfileStageVCOs);
 	m_VCO_Mixer.NextSample ();
+	PROFILE_STAGE (ProfileStageMixer);
 
 	// VCF
 	m_LFO_VCF.NextSample ();
+	PROFILE_STAGE (ProfileStageLFOs);
 	m_EG_VCF.NextSample ();
+	PROFILE_STAGE (ProfileStageEGs);
 	m_VCF.NextSample ();
+	PROFILE_STAGE (ProfileStageVCF);
 
 	// VCA
 	m_LFO_VCA.NextSample ();
+	PROFILE_STAGE (ProfileStageLFOs);
 	m_EG_VCA.NextSample ();
+	PROFILE_STAGE (ProfileStageEGs);
 	m_VCA.NextSample ();
+	PROFILE_STAGE (ProfileStageVCA);
 }
 
-float CVoice::GetOutputLevel (void) const
+template <typename TSample>
+float CVoiceT<TSample>::GetOutputLevel (void) const
 {
-	return m_VCA.GetOutputLevel ();
+	return SampleToFloat<TSample> (m_VCA.GetOutputLevel ());
 }
+
+template class CVoiceT<float>;
+#ifdef FIXED_POINT_DSP
+template class CVoiceT<TQ15>;
+#endif
@@ -27,7 +27,7 @@
 #include "envelopegenerator.h"
 #include "filter.h"
 #include "amplifier.h"
-#include "patch.h"
+#include "patchsnapshot.h"
 #include <circle/types.h>
 
 enum TVoiceState
@@ -38,13 +38,17 @@ enum TVoiceState
 	VoiceStateUnknown
 };
 
-class CVoice
+// The voice is instantiated with the sample type of its modules (see sample.h).
+// The output level is always returned as float for the mix of the voices.
+
+template <typename TSample>
+class CVoiceT
 {
 public:
-	CVoice (void);
-	~CVoice (void);
+	CVoiceT (void);
+	~CVoiceT (void);
 
-	void SetPatch (CPatch *pPatch);
+	void SetPatch (const CPatchSnapshot *pSnapshot);	// references the snapshot
 
 	void NoteOn (u8 ucKeyNumber, u8 ucVelocity);	// MIDI key number and velocity
 	void NoteOff (void);
@@ -58,22 +62,24 @@ public:
 
 private:
 	// VCO
-	COscillator m_LFO_VCO;
-	COscillator m_VCO;
-	COscillator m_VCO2;
-	CMixer m_VCO_Mixer;
+	COscillatorT<TSample> m_LFO_VCO;
+	COscillatorT<TSample> m_VCO;
+	COscillatorT<TSample> m_VCO2;
+	CMixerT<TSample> m_VCO_Mixer;
 
 	// VCF
-	COscillator m_LFO_VCF;
-	CEnvelopeGenerator m_EG_VCF;
-	CFilter m_VCF;
+	COscillatorT<TSample> m_LFO_VCF;
+	CEnvelopeGeneratorT<TSample> m_EG_VCF;
+	CFilterT<TSample> m_VCF;
 
 	// VCA
-	COscillator m_LFO_VCA;
-	CEnvelopeGenerator m_EG_VCA;
-	CAmplifier m_VCA;
+	COscillatorT<TSample> m_LFO_VCA;
+	CEnvelopeGeneratorT<TSample> m_EG_VCA;
+	CAmplifierT<TSample> m_VCA;
 
 	u8 m_ucKeyNumber;
 };
 
+typedef CVoiceT<TVoiceSample> CVoice;
+
 #endif
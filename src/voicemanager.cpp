@@ -18,27 +18,69 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include "voicemanager.h"
+#include "profiler.h"
+#include "samplerate.h"
+#include <circle/timer.h>
 #include <assert.h>
 
+#ifdef ARM_ALLOW_MULTI_CORE
+
+// sleep until an event is signaled by another core (or spuriously)
+static inline void WaitForEvent (void)
+{
+	asm volatile ("wfe");
+}
+
+// wake up all cores, which are sleeping in WaitForEvent()
+static inline void SendEvent (void)
+{
+	DataSyncBarrier ();		// make status updates visible before
+
+	asm volatile ("sev");
+}
+
+#endif
+
 CVoiceManager::CVoiceManager (CMemorySystem *pMemorySystem)
 :
 #ifdef ARM_ALLOW_MULTI_CORE
 	CMultiCoreSupport (pMemorySystem),
 #endif
-	m_nLastNoteOnVoice (VOICES)
+	m_nVoiceLimit (VOICES),
+	m_nLastNoteOnVoice (VOICES),
+	m_nActiveSnapshots (0),
+	m_nControlCounter (0),
+	m_nControlRateDivider (CSampleRate::Get () / ControlRate)
+#ifdef SHOW_STATUS
+	, m_nVoiceSteals (0)
+#endif
+#ifdef TRACE_EVENTS
+	, m_bTraceCores (FALSE)
+#endif
 {
 	for (unsigned i = 0; i < VOICES; i++)
 	{
 		m_pVoice[i] = new CVoice ();
 		assert (m_pVoice[i] != 0);
+
+		m_ucVoicePart[i] = 0;
+	}
+
+	for (unsigned nPart = 0; nPart < VOICE_PARTS; nPart++)
+	{
+		m_pSnapshot[nPart] = 0;
+		m_pNextSnapshot[nPart] = 0;
 	}
 
 #ifdef ARM_ALLOW_MULTI_CORE
 	for (unsigned nCore = 0; nCore < CORES; nCore++)
 	{
-		m_CoreStatus[nCore] = CoreStatusInit;
+		m_Mailbox[nCore].Status = CoreStatusInit;
 
-		m_fOutputLevel[nCore] = 0.0;
+		m_Mailbox[nCore].fOutputLevel = 0.0;
+#ifdef SHOW_STATUS
+		m_Mailbox[nCore].nBusyTicks = 0;
+#endif
 	}
 #endif
 }
@@ -48,12 +90,13 @@ CVoiceManager::~CVoiceManager (void)
 #ifdef ARM_ALLOW_MULTI_CORE
 	for (unsigned nCore = 1; nCore < CORES; nCore++)
 	{
-		assert (m_CoreStatus[nCore] == CoreStatusIdle);
-		m_CoreStatus[nCore] = CoreStatusExit;
+		assert (m_Mailbox[nCore].Status == CoreStatusIdle);
+		m_Mailbox[nCore].Status = CoreStatusExit;
+		SendEvent ();
 
-		while (m_CoreStatus[nCore] == CoreStatusExit)
+		while (m_Mailbox[nCore].Status == CoreStatusExit)
 		{
-			// just wait
+			WaitForEvent ();
 		}
 	}
 #endif
@@ -76,9 +119,9 @@ boolean CVoiceManager::Initialize (void)
 	// wait for secondary cores to be ready
 	for (unsigned nCore = 1; nCore < CORES; nCore++)
 	{
-		while (m_CoreStatus[nCore] != CoreStatusIdle)
+		while (m_Mailbox[nCore].Status != CoreStatusIdle)
 		{
-			// just wait
+			WaitForEvent ();
 		}
 	}
 #endif
@@ -94,51 +137,87 @@ void CVoiceManager::Run (unsigned nCore)	// runs on secondary cores
 	unsigned nFirstVoice = nCore * VOICES_PER_CORE;
 	unsigned nLastVoice  = nFirstVoice + VOICES_PER_CORE-1;
 
+	TCoreMailbox *pMailbox = &m_Mailbox[nCore];
+
+#ifdef PROFILE_STAGES
+	CProfiler::EnableCycleCounter ();
+#endif
+
 	while (1)
 	{
-		m_CoreStatus[nCore] = CoreStatusIdle;			// ready to be kicked
-		while (m_CoreStatus[nCore] == CoreStatusIdle)
+		pMailbox->Status = CoreStatusIdle;			// ready to be kicked
+		SendEvent ();
+
+		while (pMailbox->Status == CoreStatusIdle)
 		{
-			// just wait
+			WaitForEvent ();
 		}
 
-		if (m_CoreStatus[nCore] == CoreStatusExit)
+		if (pMailbox->Status == CoreStatusExit)
 		{
-			m_CoreStatus[nCore] = CoreStatusUnknown;
+			pMailbox->Status = CoreStatusUnknown;
+			SendEvent ();
 
 			return;
 		}
 
-		assert (m_CoreStatus[nCore] == CoreStatusBusy);
+		assert (pMailbox->Status == CoreStatusBusy);
+
+#ifdef SHOW_STATUS
+		unsigned nStartTicks = CTimer::GetClockTicks ();
+#endif
+
+		pMailbox->fOutputLevel = ProcessVoices (nFirstVoice, nLastVoice);
 
-		m_fOutputLevel[nCore] = ProcessVoices (nFirstVoice, nLastVoice);
+#ifdef SHOW_STATUS
+		pMailbox->nBusyTicks += CTimer::GetClockTicks () - nStartTicks;
+#endif
+
+#ifdef TRACE_EVENTS
+		if (m_bTraceCores)
+		{
+			TRACE (TraceCoreComplete, nCore, 0);
+		}
+#endif
+
+		DataMemBarrier ();		// output level must be valid, before we go idle
 	}
 }
 
 #endif
 
-void CVoiceManager::SetPatch (CPatch *pPatch)
+void CVoiceManager::SetPatch (CPatchSnapshot *pSnapshot, unsigned nPart)
 {
-	assert (pPatch != 0);
-
-	for (unsigned i = 0; i < VOICES; i++)
-	{
-		assert (m_pVoice[i] != 0);
-		m_pVoice[i]->SetPatch (pPatch);
-	}
+	assert (pSnapshot != 0);
+	assert (nPart < VOICE_PARTS);
+	m_pNextSnapshot[nPart] = pSnapshot;
+}
 
-	m_ReverbModule.SetDecay (pPatch->GetParameter (ReverbDecay) / 100.0f);
-	m_ReverbModule.SetWetDryRatio (pPatch->GetParameter (ReverbVolume) / 100.0f);
+void CVoiceManager::SetVoiceLimit (unsigned nVoices)
+{
+	assert (1 <= nVoices && nVoices <= VOICES);
+#ifdef ARM_ALLOW_MULTI_CORE
+	assert (nVoices == VOICES);		// would load core 0 only
+#endif
+	m_nVoiceLimit = nVoices;
 }
 
-void CVoiceManager::NoteOn (u8 ucKeyNumber, u8 ucVelocity)
+unsigned CVoiceManager::NoteOn (u8 ucKeyNumber, u8 ucVelocity, unsigned nPart)
 {
-	// find the voice which is currently playing this key
+	assert (nPart < VOICE_PARTS);
+	CPatchSnapshot *pSnapshot = m_pSnapshot[nPart];
+	if (pSnapshot == 0)		// part not set up yet
+	{
+		return VOICES;
+	}
+
+	// find the voice which is currently playing this key on this part
 	unsigned i;
 	for (i = 0; i < VOICES; i++)
 	{
 		assert (m_pVoice[i] != 0);
-		if (m_pVoice[i]->GetKeyNumber () == ucKeyNumber)
+		if (   m_pVoice[i]->GetKeyNumber () == ucKeyNumber
+		    && m_ucVoicePart[i] == nPart)
 		{
 			break;
 		}
@@ -147,7 +226,7 @@ void CVoiceManager::NoteOn (u8 ucKeyNumber, u8 ucVelocity)
 	if (i >= VOICES)
 	{
 		// otherwise find a free voice
-		for (i = 0; i < VOICES; i++)
+		for (i = 0; i < m_nVoiceLimit; i++)
 		{
 			assert (m_pVoice[i] != 0);
 			if (m_pVoice[i]->GetState () == VoiceStateIdle)
@@ -157,31 +236,49 @@ void CVoiceManager::NoteOn (u8 ucKeyNumber, u8 ucVelocity)
 		}
 	}
 
-	if (i < VOICES)
+	if (i >= m_nVoiceLimit)
 	{
-		assert (m_pVoice[i] != 0);
-		m_pVoice[i]->NoteOn (ucKeyNumber, ucVelocity);
+#ifdef LAST_NOTE_PRIORITY
+		i = m_nLastNoteOnVoice;
+		assert (i < VOICES);
 
-		m_nLastNoteOnVoice = i;
+		TRACE (TraceVoiceSteal, i, ucKeyNumber | nPart << 8);
+#ifdef SHOW_STATUS
+		m_nVoiceSteals++;
+#endif
+#else
+		return VOICES;
+#endif
 	}
-#ifdef LAST_NOTE_PRIORITY
 	else
 	{
-		assert (m_nLastNoteOnVoice < VOICES);
-		assert (m_pVoice[m_nLastNoteOnVoice] != 0);
-		m_pVoice[m_nLastNoteOnVoice]->NoteOn (ucKeyNumber, ucVelocity);
+		TRACE (TraceVoiceAllocate, i, ucKeyNumber | nPart << 8);
 	}
-#endif
+
+	assert (m_pVoice[i] != 0);
+	if (m_ucVoicePart[i] != nPart)
+	{
+		// only references the compiled parameters of the part
+		m_pVoice[i]->SetPatch (pSnapshot);
+		m_ucVoicePart[i] = (u8) nPart;
+	}
+
+	m_pVoice[i]->NoteOn (ucKeyNumber, ucVelocity);
+
+	m_nLastNoteOnVoice = i;
+
+	return i;
 }
 
-void CVoiceManager::NoteOff (u8 ucKeyNumber)
+void CVoiceManager::NoteOff (u8 ucKeyNumber, unsigned nPart)
 {
-	// find the voice used for this key
+	// find the voice used for this key on this part
 	unsigned i;
 	for (i = 0; i < VOICES; i++)
 	{
 		assert (m_pVoice[i] != 0);
-		if (m_pVoice[i]->GetKeyNumber () == ucKeyNumber)
+		if (   m_pVoice[i]->GetKeyNumber () == ucKeyNumber
+		    && m_ucVoicePart[i] == nPart)
 		{
 			break;
 		}
@@ -194,36 +291,212 @@ void CVoiceManager::NoteOff (u8 ucKeyNumber)
 	}
 }
 
+boolean CVoiceManager::IsSilent (void) const
+{
+	for (unsigned i = 0; i < VOICES; i++)
+	{
+		assert (m_pVoice[i] != 0);
+		if (m_pVoice[i]->GetState () != VoiceStateIdle)
+		{
+			return FALSE;
+		}
+	}
+
+	return m_ReverbModule.IsSilent ();
+}
+
+void CVoiceManager::BeginChunk (void)
+{
+#if defined (SHOW_STATUS) && defined (ARM_ALLOW_MULTI_CORE)
+	// the secondary cores are idle now
+	for (unsigned nCore = 1; nCore < CORES; nCore++)
+	{
+		m_Mailbox[nCore].nBusyTicks = 0;
+	}
+#endif
+
+	boolean bChanged = FALSE;
+
+	for (unsigned nPart = 0; nPart < VOICE_PARTS; nPart++)
+	{
+		CPatchSnapshot *pSnapshot = m_pNextSnapshot[nPart];
+		if (pSnapshot == m_pSnapshot[nPart])
+		{
+			continue;
+		}
+
+		m_pSnapshot[nPart] = pSnapshot;
+
+		TRACE (TracePatchChange, nPart, 0);
+
+		for (unsigned i = 0; i < VOICES; i++)
+		{
+			assert (m_pVoice[i] != 0);
+			if (m_ucVoicePart[i] == nPart)
+			{
+				m_pVoice[i]->SetPatch (pSnapshot);
+			}
+		}
+
+		bChanged = TRUE;
+	}
+
+	if (bChanged)
+	{
+		CPatchSnapshot *pPreviousSnapshot[VOICE_PARTS];
+		unsigned nPreviousSnapshots = m_nActiveSnapshots;
+		for (unsigned i = 0; i < nPreviousSnapshots; i++)
+		{
+			pPreviousSnapshot[i] = m_pActiveSnapshot[i];
+		}
+
+		// collect the different snapshots, so that each one is ramped only once
+		m_nActiveSnapshots = 0;
+		for (unsigned nPart = 0; nPart < VOICE_PARTS; nPart++)
+		{
+			CPatchSnapshot *pSnapshot = m_pSnapshot[nPart];
+			if (   pSnapshot != 0
+			    && !IsActiveSnapshot (pSnapshot))
+			{
+				m_pActiveSnapshot[m_nActiveSnapshots++] = pSnapshot;
+			}
+		}
+
+		// leave a snapshot consistent, which is not used any more, a snapshot,
+		// which is still shared with another part, continues ramping
+		for (unsigned i = 0; i < nPreviousSnapshots; i++)
+		{
+			if (!IsActiveSnapshot (pPreviousSnapshot[i]))
+			{
+				pPreviousSnapshot[i]->FinishRamps ();
+			}
+		}
+	}
+
+	// parameters, which have been modified in the main loop, are applied here only,
+	// because the voices on the other cores read the snapshots during the chunk
+	for (unsigned i = 0; i < m_nActiveSnapshots; i++)
+	{
+		assert (m_pActiveSnapshot[i] != 0);
+		if (m_pActiveSnapshot[i]->IsPosted ())
+		{
+			m_pActiveSnapshot[i]->ApplyPosted ();
+		}
+	}
+
+	// the ramps are advanced in NextSample(), which is not called, while nothing
+	// is playing, so that they would stall then
+	if (IsSilent ())
+	{
+		for (unsigned i = 0; i < m_nActiveSnapshots; i++)
+		{
+			assert (m_pActiveSnapshot[i] != 0);
+			m_pActiveSnapshot[i]->FinishRamps ();
+		}
+	}
+
+	if (m_pSnapshot[0] == 0)
+	{
+		return;
+	}
+
+	// the reverb keeps a copy of its parameters, which may have been modified
+	m_ReverbModule.SetParameters (&m_pSnapshot[0]->Reverb);
+
+#ifdef TRACE_EVENTS
+	m_bTraceCores = TRUE;
+#endif
+}
+
 void CVoiceManager::NextSample (void)		// runs on core 0
 {
+	if (++m_nControlCounter >= m_nControlRateDivider)
+	{
+		m_nControlCounter = 0;
+
+		assert (m_pSnapshot[0] != 0);
+		boolean bUpdateReverb = m_pSnapshot[0]->IsRamping ();
+
+		for (unsigned i = 0; i < m_nActiveSnapshots; i++)
+		{
+			assert (m_pActiveSnapshot[i] != 0);
+			if (m_pActiveSnapshot[i]->IsRamping ())
+			{
+				m_pActiveSnapshot[i]->NextRampStep ();
+			}
+		}
+
+		if (bUpdateReverb)
+		{
+			m_ReverbModule.SetParameters (&m_pSnapshot[0]->Reverb);
+		}
+	}
+
 #ifdef ARM_ALLOW_MULTI_CORE
+#ifdef TRACE_EVENTS
+	if (m_bTraceCores)
+	{
+		TRACE (TraceCoreKick, CORES-1, 0);
+	}
+#endif
+
 	// kick secondary cores
 	for (unsigned nCore = 1; nCore < CORES; nCore++)
 	{
-		assert (m_CoreStatus[nCore] == CoreStatusIdle);
-		m_CoreStatus[nCore] = CoreStatusBusy;
+		assert (m_Mailbox[nCore].Status == CoreStatusIdle);
+		m_Mailbox[nCore].Status = CoreStatusBusy;
 	}
+	SendEvent ();
+
+	m_Mailbox[0].fOutputLevel = ProcessVoices (0, VOICES_PER_CORE-1);
 
-	m_fOutputLevel[0] = ProcessVoices (0, VOICES_PER_CORE-1);
+#ifdef TRACE_EVENTS
+	if (m_bTraceCores)
+	{
+		TRACE (TraceCoreComplete, 0, 0);
+	}
+#endif
 
-	// wait for secondary cores to complete their work
+	// sleep until the secondary cores have completed their work
 	for (unsigned nCore = 1; nCore < CORES; nCore++)
 	{
-		while (m_CoreStatus[nCore] != CoreStatusIdle)
+		while (m_Mailbox[nCore].Status != CoreStatusIdle)
 		{
-			// just wait
+			WaitForEvent ();
 		}
 	}
 
+	DataMemBarrier ();
+
+#ifdef TRACE_EVENTS
+	m_bTraceCores = FALSE;
+#endif
+
 	float fLevel = 0.0;
 	for (unsigned nCore = 0; nCore < CORES; nCore++)
 	{
-		fLevel += m_fOutputLevel[nCore];
+		fLevel += m_Mailbox[nCore].fOutputLevel;
 	}
 
 	m_ReverbModule.NextSample (fLevel);
 #else
+#ifdef TRACE_EVENTS
+	if (m_bTraceCores)
+	{
+		TRACE (TraceCoreKick, 0, 0);
+	}
+#endif
+
 	m_ReverbModule.NextSample (ProcessVoices (0, VOICES-1));
+
+#ifdef TRACE_EVENTS
+	if (m_bTraceCores)
+	{
+		TRACE (TraceCoreComplete, 0, 0);
+
+		m_bTraceCores = FALSE;
+	}
+#endif
 #endif
 }
 
@@ -237,6 +510,54 @@ float CVoiceManager::GetOutputLevelRight (void) const
 	return m_ReverbModule.GetOutputLevelRight ();
 }
 
+#ifdef SHOW_STATUS
+
+unsigned CVoiceManager::GetActiveVoices (void) const
+{
+	unsigned nVoices = 0;
+	for (unsigned i = 0; i < VOICES; i++)
+	{
+		assert (m_pVoice[i] != 0);
+		if (m_pVoice[i]->GetState () != VoiceStateIdle)
+		{
+			nVoices++;
+		}
+	}
+
+	return nVoices;
+}
+
+TVoiceState CVoiceManager::GetVoiceState (unsigned nVoice) const
+{
+	assert (nVoice < VOICES);
+	assert (m_pVoice[nVoice] != 0);
+	return m_pVoice[nVoice]->GetState ();
+}
+
+float CVoiceManager::GetVoiceOutputLevel (unsigned nVoice) const
+{
+	assert (nVoice < VOICES);
+	assert (m_pVoice[nVoice] != 0);
+	return m_pVoice[nVoice]->GetOutputLevel ();
+}
+
+unsigned CVoiceManager::GetVoiceSteals (void) const
+{
+	return m_nVoiceSteals;
+}
+
+#ifdef ARM_ALLOW_MULTI_CORE
+
+unsigned CVoiceManager::GetBusyTicks (unsigned nCore) const
+{
+	assert (1 <= nCore && nCore < CORES);
+	return m_Mailbox[nCore].nBusyTicks;
+}
+
+#endif
+
+#endif
+
 float CVoiceManager::ProcessVoices (unsigned nFirst, unsigned nLast)
 {
 	float fLevel = 0.0;
@@ -247,9 +568,31 @@ float CVoiceManager::ProcessVoices (unsigned nFirst, unsigned nLast)
 		{
 			m_pVoice[i]->NextSample ();
 
-			fLevel += m_pVoice[i]->GetOutputLevel ();
+#ifdef TRACE_EVENTS
+			if (m_pVoice[i]->GetState () == VoiceStateIdle)
+			{
+				TRACE (TraceVoiceRetire, i, 0);
+			}
+#endif
+
+			assert (m_pSnapshot[m_ucVoicePart[i]] != 0);
+			fLevel +=   m_pVoice[i]->GetOutputLevel ()
+				  * m_pSnapshot[m_ucVoicePart[i]]->fVolume;
 		}
 	}
 
 	return fLevel;
 }
+
+boolean CVoiceManager::IsActiveSnapshot (const CPatchSnapshot *pSnapshot) const
+{
+	for (unsigned i = 0; i < m_nActiveSnapshots; i++)
+	{
+		if (m_pActiveSnapshot[i] == pSnapshot)
+		{
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
@@ -24,10 +24,12 @@
 
 #include <circle/multicore.h>
 #include <circle/memory.h>
+#include <circle/synchronize.h>
 #include <circle/types.h>
-#include "patch.h"
+#include "patchsnapshot.h"
 #include "voice.h"
 #include "reverbmodule.h"
+#include "trace.h"
 #include "config.h"
 
 #ifdef ARM_ALLOW_MULTI_CORE
@@ -36,6 +38,10 @@
 	#define VOICES		VOICES_PER_CORE
 #endif
 
+// the zones of part 0 (see zonemap.h) are played like additional parts
+#define ZONE_PART(zone)		(PARTS + (zone))
+#define VOICE_PARTS		(PARTS + ZONES)
+
 #ifdef ARM_ALLOW_MULTI_CORE
 
 enum TCoreStatus
@@ -50,14 +56,17 @@ enum TCoreStatus
 #endif
 
 // Except Run() and ProcessVoices() everything herein runs on core 0.
-// m_CoreStatus[] is used to synchronize the secondary cores from core 0. Normally
-// m_CoreStatus[] is CoreStatusIdle for all secondary cores and they are spinning
-// to wait until this status changes to CoreStatusBusy. This is triggered in
-// NextSample(), where the major workload is done. Each core processes the same
-// number of voices by calling ProcessVoices() and sums up their current output level
-// to m_fOutputLevel[]. These levels are mixed together when GetOutputLevel() gets
-// called from CMiniSynthesizer::GetChunk(). When the secondary cores have done
-// their work they go back to CoreStatusIdle to be triggered again.
+// m_Mailbox[] is used to synchronize the secondary cores from core 0. Each core
+// owns one mailbox, which occupies a whole cache line, so that the cores do not
+// disturb each other, when they update their status. Normally the status is
+// CoreStatusIdle for all secondary cores and they are sleeping (WFE) to wait until
+// this status changes to CoreStatusBusy. This is triggered in NextSample(), where
+// the major workload is done, and signaled to the secondary cores with SEV. Each
+// core processes the same number of voices by calling ProcessVoices() and sums up
+// their current output level to its mailbox. These levels are mixed together when
+// GetOutputLevel() gets called from CMiniSynthesizer::GetChunk(). When the
+// secondary cores have done their work they go back to CoreStatusIdle and signal
+// this to core 0, which sleeps in the meantime too, to be triggered again.
 
 class CVoiceManager
 #ifdef ARM_ALLOW_MULTI_CORE
@@ -74,27 +83,82 @@ public:
 	void Run (unsigned nCore);			// secondary core entry
 #endif
 
-	void SetPatch (CPatch *pPatch);
+	// the snapshot gets applied to the part (or ZONE_PART()) at the beginning of the
+	// next chunk
+	void SetPatch (CPatchSnapshot *pSnapshot, unsigned nPart = 0);
+
+	// limits the voices, which are allocated by NoteOn(), single core only
+	void SetVoiceLimit (unsigned nVoices);
 
-	void NoteOn (u8 ucKeyNumber, u8 ucVelocity);	// MIDI key number and velocity
-	void NoteOff (u8 ucKeyNumber);
+	// MIDI key number and velocity, played with the patch of the part,
+	// returns the started voice or VOICES, if no voice is available
+	unsigned NoteOn (u8 ucKeyNumber, u8 ucVelocity, unsigned nPart = 0);
+	void NoteOff (u8 ucKeyNumber, unsigned nPart = 0);
 
+	// returns TRUE, if all voices are idle and the reverb tail has decayed,
+	// NextSample() need not be called then, the output level would be 0.0
+	boolean IsSilent (void) const;
+
+	void BeginChunk (void);				// call before the first NextSample() of a chunk
 	void NextSample (void);
-	float GetOutputLevelLeft (void) const;
+	float GetOutputLevelLeft (void) const;		// includes the volume of the parts
 	float GetOutputLevelRight (void) const;
 
+#ifdef SHOW_STATUS
+	unsigned GetActiveVoices (void) const;
+	TVoiceState GetVoiceState (unsigned nVoice) const;
+	float GetVoiceOutputLevel (unsigned nVoice) const;	// without part volume
+	unsigned GetVoiceSteals (void) const;		// since start
+#ifdef ARM_ALLOW_MULTI_CORE
+	unsigned GetBusyTicks (unsigned nCore) const;	// of a secondary core in this chunk
+#endif
+#endif
+
 private:
 	float ProcessVoices (unsigned nFirst, unsigned nLast);
 
+	boolean IsActiveSnapshot (const CPatchSnapshot *pSnapshot) const;
+
 private:
 	CVoice *m_pVoice[VOICES];
+	u8 m_ucVoicePart[VOICES];			// part, which the voice is playing
 
+	unsigned m_nVoiceLimit;
 	unsigned m_nLastNoteOnVoice;
 
+	// Each voice references the snapshot of the part, it has been started for.
+	// Parts, which play the same patch, share its snapshot. The reverb takes its
+	// parameters from the snapshot of part 0.
+	CPatchSnapshot *m_pSnapshot[VOICE_PARTS];		// used by the voices
+	CPatchSnapshot * volatile m_pNextSnapshot[VOICE_PARTS];	// set by SetPatch()
+
+	CPatchSnapshot *m_pActiveSnapshot[VOICE_PARTS];	// different snapshots in use
+	unsigned m_nActiveSnapshots;			// for ramping them once per step
+
+	unsigned m_nControlCounter;			// counts samples to next control step
+	unsigned m_nControlRateDivider;			// samples per control step
+	static const unsigned ControlRate = 3000;	// control steps per second
+
+#ifdef SHOW_STATUS
+	unsigned m_nVoiceSteals;
+#endif
+
+#ifdef TRACE_EVENTS
+	volatile boolean m_bTraceCores;			// trace the first sample of a chunk only
+#endif
+
 #ifdef ARM_ALLOW_MULTI_CORE
-	volatile TCoreStatus m_CoreStatus[CORES];
+	struct TCoreMailbox
+	{
+		volatile TCoreStatus Status;
+		volatile float fOutputLevel;
+#ifdef SHOW_STATUS
+		volatile unsigned nBusyTicks;
+#endif
+	}
+	__attribute__ ((aligned (DATA_CACHE_LINE_SIZE_MAX)));
 
-	volatile float m_fOutputLevel[CORES];
+	TCoreMailbox m_Mailbox[CORES];
 #endif
 
 	CReverbModule m_ReverbModule;
@@ -0,0 +1,104 @@
+//
+// zonemap.cpp
+//
+// MiniSynth Pi - A virtual analogue synthesizer for Raspberry Pi
+// Copyright (C) 2017-2023  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "zonemap.h"
+#include <circle/string.h>
+#include <circle/util.h>
+#include <assert.h>
+
+CZoneMap::CZoneMap (FATFS *pFileSystem)
+:	m_Properties (DRIVE "/zones.txt", pFileSystem),
+	m_ucEnabledZones (0)
+{
+	memset (m_ucZones, 0, sizeof m_ucZones);
+}
+
+CZoneMap::~CZoneMap (void)
+{
+}
+
+boolean CZoneMap::Load (void)
+{
+	boolean bResult = m_Properties.Load ();
+	if (!bResult)
+	{
+		m_Properties.RemoveAll ();
+	}
+
+	assert (ZONES <= 8);
+	for (unsigned nZone = 0; nZone < ZONES; nZone++)
+	{
+		TZone *pZone = &m_Zone[nZone];
+		CString Name;
+
+		Name.Format ("Zone%uPatch", nZone+1);
+		pZone->nPatch = m_Properties.GetNumber (Name, PATCHES);
+
+		Name.Format ("Zone%uKeyLow", nZone+1);
+		unsigned nKeyLow = m_Properties.GetNumber (Name, 0);
+		Name.Format ("Zone%uKeyHigh", nZone+1);
+		unsigned nKeyHigh = m_Properties.GetNumber (Name, 127);
+
+		Name.Format ("Zone%uVelocityLow", nZone+1);
+		unsigned nVelocityLow = m_Properties.GetNumber (Name, 1);
+		Name.Format ("Zone%uVelocityHigh", nZone+1);
+		unsigned nVelocityHigh = m_Properties.GetNumber (Name, 127);
+
+		Name.Format ("Zone%uTranspose", nZone+1);
+		pZone->nTranspose = m_Properties.GetSignedNumber (Name, 0);
+
+		if (   pZone->nPatch >= PATCHES
+		    || nKeyLow > nKeyHigh || nKeyHigh > 127
+		    || nVelocityLow > nVelocityHigh || nVelocityHigh > 127
+		    || pZone->nTranspose < -127 || pZone->nTranspose > 127)
+		{
+			continue;
+		}
+
+		pZone->ucKeyLow = (u8) nKeyLow;
+		pZone->ucKeyHigh = (u8) nKeyHigh;
+		pZone->ucVelocityLow = (u8) nVelocityLow;
+		pZone->ucVelocityHigh = (u8) nVelocityHigh;
+
+		m_ucEnabledZones |= 1 << nZone;
+
+		// compile the zone into the lookup table
+		for (unsigned nKey = nKeyLow; nKey <= nKeyHigh; nKey++)
+		{
+			for (unsigned nVelocity = nVelocityLow; nVelocity <= nVelocityHigh; nVelocity++)
+			{
+				m_ucZones[nKey][nVelocity] |= 1 << nZone;
+			}
+		}
+	}
+
+	return bResult;
+}
+
+u8 CZoneMap::GetEnabledZones (void) const
+{
+	return m_ucEnabledZones;
+}
+
+const TZone *CZoneMap::GetZone (unsigned nZone) const
+{
+	assert (nZone < ZONES);
+	assert (m_ucEnabledZones & (1 << nZone));
+	return &m_Zone[nZone];
+}
@@ -0,0 +1,74 @@
+//
+// zonemap.h
+//
+// Keyboard split and layer zones, compiled into a key/velocity lookup table
+//
+// MiniSynth Pi - A virtual analogue synthesizer for Raspberry Pi
+// Copyright (C) 2017-2023  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _zonemap_h
+#define _zonemap_h
+
+#include <fatfs/ff.h>
+#include <circle/types.h>
+#include <Properties/propertiesfatfsfile.h>
+#include "config.h"
+
+// Zones split the keyboard of part 0 or layer several patches on one key. They are
+// defined in the file zones.txt (e.g. "Zone1KeyLow=0", "Zone1KeyHigh=59",
+// "Zone1Patch=3", "Zone1Transpose=12", optionally "Zone1VelocityLow=1" and
+// "Zone1VelocityHigh=127"). A zone is enabled by assigning a patch. Load() compiles
+// the zones into a lookup table, which returns the zones for a key and velocity.
+// Keys, which are not covered by a zone, are played by part 0 as usual.
+
+struct TZone
+{
+	u8 ucKeyLow;
+	u8 ucKeyHigh;
+	u8 ucVelocityLow;
+	u8 ucVelocityHigh;
+	unsigned nPatch;
+	int nTranspose;				// semitones
+};
+
+class CZoneMap
+{
+public:
+	CZoneMap (FATFS *pFileSystem);
+	~CZoneMap (void);
+
+	boolean Load (void);
+
+	u8 GetEnabledZones (void) const;		// bit mask
+
+	// returns a bit mask of the zones, which play this key with this velocity
+	u8 GetZones (u8 ucKeyNumber, u8 ucVelocity) const
+	{
+		return m_ucZones[ucKeyNumber & 0x7F][ucVelocity & 0x7F];
+	}
+
+	const TZone *GetZone (unsigned nZone) const;	// for enabled zones only
+
+private:
+	CPropertiesFatFsFile m_Properties;
+
+	TZone m_Zone[ZONES];
+	u8 m_ucEnabledZones;
+
+	u8 m_ucZones[128][128];				// [key number][velocity]
+};
+
+#endif
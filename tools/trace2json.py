@@ -0,0 +1,124 @@
+#!/usr/bin/env python3
+#
+# trace2json.py
+#
+# Converts the file trace.bin, written by MiniSynth Pi with TRACE_EVENTS defined
+# in src/config.h, into a JSON trace, which can be loaded in chrome://tracing or
+# https://ui.perfetto.dev
+#
+# Usage: trace2json.py trace.bin [trace.json]
+#
+# MiniSynth Pi - A virtual analogue synthesizer for Raspberry Pi
+# Copyright (C) 2017-2023  R. Stange <rsta2@o2online.de>
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+
+import json
+import struct
+import sys
+
+# must match TTraceEvent in src/trace.h
+(TraceChunkStart, TraceChunkEnd, TraceNoteOn, TraceNoteOff, TraceVoiceAllocate,
+ TraceVoiceSteal, TraceVoiceRetire, TraceCoreKick, TraceCoreComplete,
+ TracePatchChange, TraceEventsDropped) = range(11)
+
+VOICE_TID = 100		# voices are shown as threads VOICE_TID+voice
+
+def main():
+	if len(sys.argv) < 2:
+		sys.exit("Usage: trace2json.py trace.bin [trace.json]")
+
+	with open(sys.argv[1], "rb") as f:
+		data = f.read()
+
+	magic, version, record_size, ticks_per_second, _ = struct.unpack_from("<4sHHII", data)
+	if magic != b"MSTR" or version != 1 or record_size != 8:
+		sys.exit("Invalid trace file")
+
+	records = [struct.unpack_from("<IBBH", data, offset)
+		   for offset in range(16, len(data) - record_size + 1, record_size)]
+	if not records:
+		sys.exit("No events")
+
+	# the records of the different cores are not sorted, the 32-bit tick
+	# counter may wrap around, therefore sort relative to the first record
+	base = records[0][0]
+
+	def relative(ticks):
+		delta = (ticks - base) & 0xFFFFFFFF
+		return delta - 0x100000000 if delta >= 0x80000000 else delta
+
+	records.sort(key=lambda record: relative(record[0]))
+	first = records[0][0]
+
+	events = []
+	cores = set()
+	voices = {}		# active voice -> note name
+
+	def add(ph, name, ticks, tid, **args):
+		event = {"ph": ph, "name": name, "pid": 0, "tid": tid,
+			 "ts": ((ticks - first) & 0xFFFFFFFF) * 1e6 / ticks_per_second}
+		if ph == "i":
+			event["s"] = "t"
+		if args:
+			event["args"] = args
+		events.append(event)
+
+	for ticks, event, param, arg in records:
+		core = event >> 4
+		event &= 0x0F
+		cores.add(core)
+
+		if event == TraceChunkStart:
+			add("B", "chunk", ticks, core, samples=arg)
+		elif event == TraceChunkEnd:
+			add("E", "chunk", ticks, core, silent=param)
+		elif event == TraceNoteOn:
+			add("i", "note on", ticks, core, part=param, key=arg & 0xFF,
+			    velocity=arg >> 8)
+		elif event == TraceNoteOff:
+			add("i", "note off", ticks, core, part=param, key=arg)
+		elif event in (TraceVoiceAllocate, TraceVoiceSteal):
+			if param in voices:
+				add("E", voices[param], ticks, VOICE_TID+param)
+			name = "key %u part %u" % (arg & 0xFF, arg >> 8)
+			voices[param] = name
+			add("B", name, ticks, VOICE_TID+param,
+			    stolen=int(event == TraceVoiceSteal))
+		elif event == TraceVoiceRetire:
+			if param in voices:
+				add("E", voices.pop(param), ticks, VOICE_TID+param)
+		elif event == TraceCoreKick:
+			for kicked in range(param+1):
+				add("B", "voices", ticks, kicked)
+		elif event == TraceCoreComplete:
+			add("E", "voices", ticks, param)
+		elif event == TracePatchChange:
+			add("i", "patch change", ticks, core, part=param)
+		elif event == TraceEventsDropped:
+			add("i", "events dropped", ticks, param, count=arg)
+
+	for core in sorted(cores):
+		events.append({"ph": "M", "name": "thread_name", "pid": 0, "tid": core,
+			       "args": {"name": "core %u" % core}})
+	for tid in sorted(set(e["tid"] for e in events if e["tid"] >= VOICE_TID)):
+		events.append({"ph": "M", "name": "thread_name", "pid": 0, "tid": tid,
+			       "args": {"name": "voice %u" % (tid - VOICE_TID)}})
+
+	output = open(sys.argv[2], "w") if len(sys.argv) > 2 else sys.stdout
+	json.dump({"traceEvents": events, "displayTimeUnit": "ms"}, output)
+
+if __name__ == "__main__":
+	main()